@@ -544,6 +544,10 @@ WhisperContextInitResult hostInitWhisperContext(
     params.use_gpu = false;
     params.flash_attn = options.useFlashAttn;
     params.use_coreml = false;
+    params.kv_cross_cache_size = options.kvCrossCacheSize;
+    params.type_k = options.kvCacheType;
+    params.type_v = options.kvCacheType;
+    params.use_extra_bufts = options.useCpuRepack;
 
     if (options.useGpu) {
         result.reasonNoGPU = "Currently not supported";
@@ -146,6 +146,9 @@ extern "C" {
     WSP_GGML_BACKEND_API void wsp_ggml_cpu_fp32_to_bf16(const float *, wsp_ggml_bf16_t *, int64_t);
     WSP_GGML_BACKEND_API void wsp_ggml_cpu_bf16_to_fp32(const wsp_ggml_bf16_t *, float *, int64_t);
 
+    // y = exp(x - max), returns the sum of y - the vectorized exp of the soft_max op, for callers outside of the graphs
+    WSP_GGML_BACKEND_API double wsp_ggml_cpu_soft_max_f32(int n, float * y, const float * x, float max);
+
 #ifdef __cplusplus
 }
 #endif
@@ -54,6 +54,8 @@
 #define wsp_ggml_gemv_mxfp4_8x8_q8_0_generic wsp_ggml_gemv_mxfp4_8x8_q8_0
 #define wsp_ggml_gemv_q8_0_4x4_q8_0_generic wsp_ggml_gemv_q8_0_4x4_q8_0
 #define wsp_ggml_gemv_q8_0_4x8_q8_0_generic wsp_ggml_gemv_q8_0_4x8_q8_0
+#define wsp_ggml_gemv_q5_0_8x8_q8_0_generic wsp_ggml_gemv_q5_0_8x8_q8_0
+#define wsp_ggml_gemv_q5_1_8x8_q8_0_generic wsp_ggml_gemv_q5_1_8x8_q8_0
 #define wsp_ggml_gemm_q4_0_4x4_q8_0_generic wsp_ggml_gemm_q4_0_4x4_q8_0
 #define wsp_ggml_gemm_q4_0_4x8_q8_0_generic wsp_ggml_gemm_q4_0_4x8_q8_0
 #define wsp_ggml_gemm_q4_0_8x8_q8_0_generic wsp_ggml_gemm_q4_0_8x8_q8_0
@@ -70,6 +72,8 @@
 #define wsp_ggml_gemm_mxfp4_8x8_q8_0_generic wsp_ggml_gemm_mxfp4_8x8_q8_0
 #define wsp_ggml_gemm_q8_0_4x4_q8_0_generic wsp_ggml_gemm_q8_0_4x4_q8_0
 #define wsp_ggml_gemm_q8_0_4x8_q8_0_generic wsp_ggml_gemm_q8_0_4x8_q8_0
+#define wsp_ggml_gemm_q5_0_8x8_q8_0_generic wsp_ggml_gemm_q5_0_8x8_q8_0
+#define wsp_ggml_gemm_q5_1_8x8_q8_0_generic wsp_ggml_gemm_q5_1_8x8_q8_0
 #elif defined(__aarch64__) || defined(__arm__) || defined(_M_ARM) || defined(_M_ARM64)
 // repack.cpp
 #define wsp_ggml_wsp_quantize_mat_q8_K_4x4_generic wsp_ggml_wsp_quantize_mat_q8_K_4x4
@@ -80,6 +84,10 @@
 #define wsp_ggml_gemm_iq4_nl_8x8_q8_0_generic wsp_ggml_gemm_iq4_nl_8x8_q8_0
 #define wsp_ggml_gemm_mxfp4_8x8_q8_0_generic wsp_ggml_gemm_mxfp4_8x8_q8_0
 #define wsp_ggml_gemm_q2_K_8x8_q8_K_generic wsp_ggml_gemm_q2_K_8x8_q8_K
+#define wsp_ggml_gemv_q5_0_8x8_q8_0_generic wsp_ggml_gemv_q5_0_8x8_q8_0
+#define wsp_ggml_gemv_q5_1_8x8_q8_0_generic wsp_ggml_gemv_q5_1_8x8_q8_0
+#define wsp_ggml_gemm_q5_0_8x8_q8_0_generic wsp_ggml_gemm_q5_0_8x8_q8_0
+#define wsp_ggml_gemm_q5_1_8x8_q8_0_generic wsp_ggml_gemm_q5_1_8x8_q8_0
 #elif defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
 // quants.c
 #define wsp_ggml_vec_dot_nvfp4_q8_0_generic wsp_ggml_vec_dot_nvfp4_q8_0
@@ -138,6 +146,8 @@
 #define wsp_ggml_gemv_mxfp4_8x8_q8_0_generic wsp_ggml_gemv_mxfp4_8x8_q8_0
 #define wsp_ggml_gemv_q8_0_4x4_q8_0_generic wsp_ggml_gemv_q8_0_4x4_q8_0
 #define wsp_ggml_gemv_q8_0_4x8_q8_0_generic wsp_ggml_gemv_q8_0_4x8_q8_0
+#define wsp_ggml_gemv_q5_0_8x8_q8_0_generic wsp_ggml_gemv_q5_0_8x8_q8_0
+#define wsp_ggml_gemv_q5_1_8x8_q8_0_generic wsp_ggml_gemv_q5_1_8x8_q8_0
 #define wsp_ggml_gemm_q4_0_4x4_q8_0_generic wsp_ggml_gemm_q4_0_4x4_q8_0
 #define wsp_ggml_gemm_q4_0_4x8_q8_0_generic wsp_ggml_gemm_q4_0_4x8_q8_0
 #define wsp_ggml_gemm_q4_0_8x8_q8_0_generic wsp_ggml_gemm_q4_0_8x8_q8_0
@@ -154,6 +164,8 @@
 #define wsp_ggml_gemm_mxfp4_8x8_q8_0_generic wsp_ggml_gemm_mxfp4_8x8_q8_0
 #define wsp_ggml_gemm_q8_0_4x4_q8_0_generic wsp_ggml_gemm_q8_0_4x4_q8_0
 #define wsp_ggml_gemm_q8_0_4x8_q8_0_generic wsp_ggml_gemm_q8_0_4x8_q8_0
+#define wsp_ggml_gemm_q5_0_8x8_q8_0_generic wsp_ggml_gemm_q5_0_8x8_q8_0
+#define wsp_ggml_gemm_q5_1_8x8_q8_0_generic wsp_ggml_gemm_q5_1_8x8_q8_0
 #elif defined(__loongarch64)
 // quants.c
 #define wsp_quantize_row_q8_K_generic wsp_quantize_row_q8_K
@@ -184,6 +196,8 @@
 #define wsp_ggml_gemv_mxfp4_8x8_q8_0_generic wsp_ggml_gemv_mxfp4_8x8_q8_0
 #define wsp_ggml_gemv_q8_0_4x4_q8_0_generic wsp_ggml_gemv_q8_0_4x4_q8_0
 #define wsp_ggml_gemv_q8_0_4x8_q8_0_generic wsp_ggml_gemv_q8_0_4x8_q8_0
+#define wsp_ggml_gemv_q5_0_8x8_q8_0_generic wsp_ggml_gemv_q5_0_8x8_q8_0
+#define wsp_ggml_gemv_q5_1_8x8_q8_0_generic wsp_ggml_gemv_q5_1_8x8_q8_0
 #define wsp_ggml_gemm_q4_0_4x4_q8_0_generic wsp_ggml_gemm_q4_0_4x4_q8_0
 #define wsp_ggml_gemm_q4_0_4x8_q8_0_generic wsp_ggml_gemm_q4_0_4x8_q8_0
 #define wsp_ggml_gemm_q4_0_8x8_q8_0_generic wsp_ggml_gemm_q4_0_8x8_q8_0
@@ -200,6 +214,8 @@
 #define wsp_ggml_gemm_mxfp4_8x8_q8_0_generic wsp_ggml_gemm_mxfp4_8x8_q8_0
 #define wsp_ggml_gemm_q8_0_4x4_q8_0_generic wsp_ggml_gemm_q8_0_4x4_q8_0
 #define wsp_ggml_gemm_q8_0_4x8_q8_0_generic wsp_ggml_gemm_q8_0_4x8_q8_0
+#define wsp_ggml_gemm_q5_0_8x8_q8_0_generic wsp_ggml_gemm_q5_0_8x8_q8_0
+#define wsp_ggml_gemm_q5_1_8x8_q8_0_generic wsp_ggml_gemm_q5_1_8x8_q8_0
 #elif defined(__riscv)
 // quants.c
 #define wsp_ggml_vec_dot_nvfp4_q8_0_generic wsp_ggml_vec_dot_nvfp4_q8_0
@@ -224,6 +240,8 @@
 #define wsp_ggml_gemv_mxfp4_8x8_q8_0_generic wsp_ggml_gemv_mxfp4_8x8_q8_0
 #define wsp_ggml_gemv_q8_0_4x4_q8_0_generic wsp_ggml_gemv_q8_0_4x4_q8_0
 #define wsp_ggml_gemv_q8_0_4x8_q8_0_generic wsp_ggml_gemv_q8_0_4x8_q8_0
+#define wsp_ggml_gemv_q5_0_8x8_q8_0_generic wsp_ggml_gemv_q5_0_8x8_q8_0
+#define wsp_ggml_gemv_q5_1_8x8_q8_0_generic wsp_ggml_gemv_q5_1_8x8_q8_0
 #define wsp_ggml_gemm_q4_0_4x4_q8_0_generic wsp_ggml_gemm_q4_0_4x4_q8_0
 #define wsp_ggml_gemm_q4_0_4x8_q8_0_generic wsp_ggml_gemm_q4_0_4x8_q8_0
 #define wsp_ggml_gemm_q2_K_8x8_q8_K_generic wsp_ggml_gemm_q2_K_8x8_q8_K
@@ -239,6 +257,8 @@
 #define wsp_ggml_gemm_mxfp4_8x8_q8_0_generic wsp_ggml_gemm_mxfp4_8x8_q8_0
 #define wsp_ggml_gemm_q8_0_4x4_q8_0_generic wsp_ggml_gemm_q8_0_4x4_q8_0
 #define wsp_ggml_gemm_q8_0_4x8_q8_0_generic wsp_ggml_gemm_q8_0_4x8_q8_0
+#define wsp_ggml_gemm_q5_0_8x8_q8_0_generic wsp_ggml_gemm_q5_0_8x8_q8_0
+#define wsp_ggml_gemm_q5_1_8x8_q8_0_generic wsp_ggml_gemm_q5_1_8x8_q8_0
 #elif defined(__s390x__)
 // quants.c
 #define wsp_quantize_row_q8_K_generic wsp_quantize_row_q8_K
@@ -275,6 +295,8 @@
 #define wsp_ggml_gemv_mxfp4_8x8_q8_0_generic wsp_ggml_gemv_mxfp4_8x8_q8_0
 #define wsp_ggml_gemv_q8_0_4x4_q8_0_generic wsp_ggml_gemv_q8_0_4x4_q8_0
 #define wsp_ggml_gemv_q8_0_4x8_q8_0_generic wsp_ggml_gemv_q8_0_4x8_q8_0
+#define wsp_ggml_gemv_q5_0_8x8_q8_0_generic wsp_ggml_gemv_q5_0_8x8_q8_0
+#define wsp_ggml_gemv_q5_1_8x8_q8_0_generic wsp_ggml_gemv_q5_1_8x8_q8_0
 #define wsp_ggml_gemm_q4_0_4x4_q8_0_generic wsp_ggml_gemm_q4_0_4x4_q8_0
 #define wsp_ggml_gemm_q4_0_4x8_q8_0_generic wsp_ggml_gemm_q4_0_4x8_q8_0
 #define wsp_ggml_gemm_q4_0_8x8_q8_0_generic wsp_ggml_gemm_q4_0_8x8_q8_0
@@ -291,6 +313,8 @@
 #define wsp_ggml_gemm_mxfp4_8x8_q8_0_generic wsp_ggml_gemm_mxfp4_8x8_q8_0
 #define wsp_ggml_gemm_q8_0_4x4_q8_0_generic wsp_ggml_gemm_q8_0_4x4_q8_0
 #define wsp_ggml_gemm_q8_0_4x8_q8_0_generic wsp_ggml_gemm_q8_0_4x8_q8_0
+#define wsp_ggml_gemm_q5_0_8x8_q8_0_generic wsp_ggml_gemm_q5_0_8x8_q8_0
+#define wsp_ggml_gemm_q5_1_8x8_q8_0_generic wsp_ggml_gemm_q5_1_8x8_q8_0
 #elif defined(__wasm__)
 // quants.c
 #define wsp_ggml_vec_dot_q4_1_q8_1_generic wsp_ggml_vec_dot_q4_1_q8_1
@@ -329,6 +353,8 @@
 #define wsp_ggml_gemv_mxfp4_8x8_q8_0_generic wsp_ggml_gemv_mxfp4_8x8_q8_0
 #define wsp_ggml_gemv_q8_0_4x4_q8_0_generic wsp_ggml_gemv_q8_0_4x4_q8_0
 #define wsp_ggml_gemv_q8_0_4x8_q8_0_generic wsp_ggml_gemv_q8_0_4x8_q8_0
+#define wsp_ggml_gemv_q5_0_8x8_q8_0_generic wsp_ggml_gemv_q5_0_8x8_q8_0
+#define wsp_ggml_gemv_q5_1_8x8_q8_0_generic wsp_ggml_gemv_q5_1_8x8_q8_0
 #define wsp_ggml_gemm_q4_0_4x4_q8_0_generic wsp_ggml_gemm_q4_0_4x4_q8_0
 #define wsp_ggml_gemm_q4_0_4x8_q8_0_generic wsp_ggml_gemm_q4_0_4x8_q8_0
 #define wsp_ggml_gemm_q4_0_8x8_q8_0_generic wsp_ggml_gemm_q4_0_8x8_q8_0
@@ -345,4 +371,6 @@
 #define wsp_ggml_gemm_mxfp4_8x8_q8_0_generic wsp_ggml_gemm_mxfp4_8x8_q8_0
 #define wsp_ggml_gemm_q8_0_4x4_q8_0_generic wsp_ggml_gemm_q8_0_4x4_q8_0
 #define wsp_ggml_gemm_q8_0_4x8_q8_0_generic wsp_ggml_gemm_q8_0_4x8_q8_0
+#define wsp_ggml_gemm_q5_0_8x8_q8_0_generic wsp_ggml_gemm_q5_0_8x8_q8_0
+#define wsp_ggml_gemm_q5_1_8x8_q8_0_generic wsp_ggml_gemm_q5_1_8x8_q8_0
 #endif
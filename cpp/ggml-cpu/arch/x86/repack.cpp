@@ -1445,6 +1445,207 @@ static void gemm_q4_b32_8x8_q8_0_lut_avx(int n, float * WSP_GGML_RESTRICT s, siz
 
 #endif // defined(__AVX2__) || defined(__AVX512F__)
 
+#if defined(__AVX2__)
+
+// Expands 32 fifth bits of block_q5_0xN / block_q5_1xN to 0x10 in the matching byte
+static inline __m256i q5_xN_hbits_avx2(const uint8_t * qh) {
+    uint32_t x32;
+    memcpy(&x32, qh, sizeof(uint32_t));
+    const __m256i shuf_mask = _mm256_set_epi64x(0x0303030303030303, 0x0202020202020202, 0x0101010101010101, 0x0000000000000000);
+    const __m256i bytes     = _mm256_or_si256(_mm256_shuffle_epi8(_mm256_set1_epi32(x32), shuf_mask), _mm256_set1_epi64x(0x7fbfdfeff7fbfdfe));
+    return _mm256_and_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi64x(-1)), _mm256_set1_epi8(0x10));
+}
+
+// Sum of the 8 lanes, broadcast to all lanes
+static inline __m256i q5_xN_hsum_i32x8_avx2(const __m256i v) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm256_broadcastd_epi32(s);
+}
+
+static inline __m256i q5_xN_load_broadcast_8(const int8_t * x) {
+    int64_t v;
+    memcpy(&v, x, sizeof(int64_t));
+    return _mm256_set1_epi64x(v);
+}
+
+// GEMV / GEMM for 8x blocks of 32 5-bit quants. The quants are multiplied unsigned (0..31),
+// the offset of Q5_0 (-16) and the min of Q5_1 are applied with the sum of the activations.
+// Each 256 bit vector holds 4 columns of 8 quants, the dot products come out in the
+// column order 0 1 4 5 2 3 6 7 and are permuted back when stored.
+template <typename block_tx8>
+static void gemv_q5_8x8_q8_0_avx2(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+    static_assert(std::is_same_v<block_tx8, block_q5_0x8> || std::is_same_v<block_tx8, block_q5_1x8>, "Unsupported block type");
+    constexpr bool has_min = std::is_same_v<block_tx8, block_q5_1x8>;
+
+    const int nb = n / QK8_0;
+
+    UNUSED(bs);
+    UNUSED(nr);
+
+    const __m256i m4b     = _mm256_set1_epi8(0x0F);
+    const __m256i ones_8  = _mm256_set1_epi8(1);
+    const __m256i ones_16 = _mm256_set1_epi16(1);
+
+    const __m256i finalpermutemask = _mm256_set_epi32(7, 6, 3, 2, 5, 4, 1, 0);
+    const __m128i changemask       = _mm_set_epi8(15, 14, 13, 12, 7, 6, 5, 4, 11, 10, 9, 8, 3, 2, 1, 0);
+
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+
+    for (int x = 0; x < nc / 8; x++) {
+        const block_tx8 * b_ptr = (const block_tx8 *) vx + (x * nb);
+
+        __m256 acc_row = _mm256_setzero_ps();
+
+        for (int b = 0; b < nb; b++) {
+            const __m256i rhs_raw_0123_0 = _mm256_loadu_si256((const __m256i *) b_ptr[b].qs);
+            const __m256i rhs_raw_4567_0 = _mm256_loadu_si256((const __m256i *) b_ptr[b].qs + 1);
+            const __m256i rhs_raw_0123_1 = _mm256_loadu_si256((const __m256i *) b_ptr[b].qs + 2);
+            const __m256i rhs_raw_4567_1 = _mm256_loadu_si256((const __m256i *) b_ptr[b].qs + 3);
+
+            // B0(0-7) B1(0-7) B2(0-7) B3(0-7) and so on, values 0..31
+            const __m256i rhs_0123_0 = _mm256_or_si256(_mm256_and_si256(rhs_raw_0123_0, m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 0));
+            const __m256i rhs_0123_2 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rhs_raw_0123_0, 4), m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 4));
+            const __m256i rhs_4567_0 = _mm256_or_si256(_mm256_and_si256(rhs_raw_4567_0, m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 8));
+            const __m256i rhs_4567_2 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rhs_raw_4567_0, 4), m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 12));
+            const __m256i rhs_0123_1 = _mm256_or_si256(_mm256_and_si256(rhs_raw_0123_1, m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 16));
+            const __m256i rhs_0123_3 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rhs_raw_0123_1, 4), m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 20));
+            const __m256i rhs_4567_1 = _mm256_or_si256(_mm256_and_si256(rhs_raw_4567_1, m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 24));
+            const __m256i rhs_4567_3 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rhs_raw_4567_1, 4), m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 28));
+
+            // A0(0-7), A0(8-15), A0(16-23), A0(24-31) repeated for the 4 columns
+            const __m256i lhs_0 = q5_xN_load_broadcast_8(a_ptr[b].qs);
+            const __m256i lhs_1 = q5_xN_load_broadcast_8(a_ptr[b].qs + 8);
+            const __m256i lhs_2 = q5_xN_load_broadcast_8(a_ptr[b].qs + 16);
+            const __m256i lhs_3 = q5_xN_load_broadcast_8(a_ptr[b].qs + 24);
+
+            // at most 4 * 2 * 31 * 127 per 16 bit lane
+            const __m256i dot_0123 = _mm256_add_epi16(
+                _mm256_add_epi16(_mm256_maddubs_epi16(rhs_0123_0, lhs_0), _mm256_maddubs_epi16(rhs_0123_1, lhs_1)),
+                _mm256_add_epi16(_mm256_maddubs_epi16(rhs_0123_2, lhs_2), _mm256_maddubs_epi16(rhs_0123_3, lhs_3)));
+            const __m256i dot_4567 = _mm256_add_epi16(
+                _mm256_add_epi16(_mm256_maddubs_epi16(rhs_4567_0, lhs_0), _mm256_maddubs_epi16(rhs_4567_1, lhs_1)),
+                _mm256_add_epi16(_mm256_maddubs_epi16(rhs_4567_2, lhs_2), _mm256_maddubs_epi16(rhs_4567_3, lhs_3)));
+
+            // B0 B1 B4 B5 B2 B3 B6 B7
+            __m256i iacc = _mm256_hadd_epi32(_mm256_madd_epi16(dot_0123, ones_16), _mm256_madd_epi16(dot_4567, ones_16));
+
+            const __m256i lhs_sum = q5_xN_hsum_i32x8_avx2(_mm256_madd_epi16(_mm256_maddubs_epi16(ones_8, _mm256_loadu_si256((const __m256i *) a_ptr[b].qs)), ones_16));
+
+            const __m256 row_scale_f32 = _mm256_set1_ps(WSP_GGML_CPU_FP16_TO_FP32(a_ptr[b].d));
+            const __m256 col_scale_f32 = WSP_GGML_F32Cx8_REARRANGE_LOAD(b_ptr[b].d, changemask);
+
+            if constexpr (has_min) {
+                const __m256 col_min_f32 = WSP_GGML_F32Cx8_REARRANGE_LOAD(b_ptr[b].m, changemask);
+                acc_row = _mm256_fmadd_ps(_mm256_cvtepi32_ps(iacc), _mm256_mul_ps(col_scale_f32, row_scale_f32), acc_row);
+                acc_row = _mm256_fmadd_ps(col_min_f32, _mm256_mul_ps(_mm256_cvtepi32_ps(lhs_sum), row_scale_f32), acc_row);
+            } else {
+                iacc = _mm256_sub_epi32(iacc, _mm256_slli_epi32(lhs_sum, 4));
+                acc_row = _mm256_fmadd_ps(_mm256_cvtepi32_ps(iacc), _mm256_mul_ps(col_scale_f32, row_scale_f32), acc_row);
+            }
+        }
+
+        _mm256_storeu_ps(s + x * 8, _mm256_permutevar8x32_ps(acc_row, finalpermutemask));
+    }
+}
+
+template <typename block_tx8>
+static void gemm_q5_8x8_q8_0_avx2(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+    static_assert(std::is_same_v<block_tx8, block_q5_0x8> || std::is_same_v<block_tx8, block_q5_1x8>, "Unsupported block type");
+    constexpr bool has_min = std::is_same_v<block_tx8, block_q5_1x8>;
+
+    const int nb = n / QK8_0;
+
+    const __m256i m4b     = _mm256_set1_epi8(0x0F);
+    const __m256i ones_8  = _mm256_set1_epi8(1);
+    const __m256i ones_16 = _mm256_set1_epi16(1);
+
+    const __m256i finalpermutemask = _mm256_set_epi32(7, 6, 3, 2, 5, 4, 1, 0);
+    const __m128i changemask       = _mm_set_epi8(15, 14, 13, 12, 7, 6, 5, 4, 11, 10, 9, 8, 3, 2, 1, 0);
+
+    // lanes of the per row sums of the activations, see below
+    const __m256i row_sum_lane[4] = { _mm256_set1_epi32(0), _mm256_set1_epi32(1), _mm256_set1_epi32(4), _mm256_set1_epi32(5) };
+
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+
+        for (int x = 0; x < nc / 8; x++) {
+            const block_tx8 * b_ptr = (const block_tx8 *) vx + (x * nb);
+
+            __m256 acc_rows[4];
+            for (int i = 0; i < 4; i++) {
+                acc_rows[i] = _mm256_setzero_ps();
+            }
+
+            for (int b = 0; b < nb; b++) {
+                const __m256i rhs_raw_0123_0 = _mm256_loadu_si256((const __m256i *) b_ptr[b].qs);
+                const __m256i rhs_raw_4567_0 = _mm256_loadu_si256((const __m256i *) b_ptr[b].qs + 1);
+                const __m256i rhs_raw_0123_1 = _mm256_loadu_si256((const __m256i *) b_ptr[b].qs + 2);
+                const __m256i rhs_raw_4567_1 = _mm256_loadu_si256((const __m256i *) b_ptr[b].qs + 3);
+
+                const __m256i rhs_0123_0 = _mm256_or_si256(_mm256_and_si256(rhs_raw_0123_0, m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 0));
+                const __m256i rhs_0123_2 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rhs_raw_0123_0, 4), m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 4));
+                const __m256i rhs_4567_0 = _mm256_or_si256(_mm256_and_si256(rhs_raw_4567_0, m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 8));
+                const __m256i rhs_4567_2 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rhs_raw_4567_0, 4), m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 12));
+                const __m256i rhs_0123_1 = _mm256_or_si256(_mm256_and_si256(rhs_raw_0123_1, m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 16));
+                const __m256i rhs_0123_3 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rhs_raw_0123_1, 4), m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 20));
+                const __m256i rhs_4567_1 = _mm256_or_si256(_mm256_and_si256(rhs_raw_4567_1, m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 24));
+                const __m256i rhs_4567_3 = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(rhs_raw_4567_1, 4), m4b), q5_xN_hbits_avx2(b_ptr[b].qh + 28));
+
+                const __m256 col_scale_f32 = WSP_GGML_F32Cx8_REARRANGE_LOAD(b_ptr[b].d, changemask);
+                __m256 col_min_f32 = _mm256_setzero_ps();
+                if constexpr (has_min) {
+                    col_min_f32 = WSP_GGML_F32Cx8_REARRANGE_LOAD(b_ptr[b].m, changemask);
+                }
+
+                // Sums of the 32 activations of each row: the block_q8_0x4 holds 4 groups of 8 values for
+                // each of the 4 rows, after the pairwise add row 0 is in lane 0, row 1 in lane 1, rows 2 and 3 in lanes 4 and 5
+                const __m256i lhs_sum_16 = _mm256_add_epi16(
+                    _mm256_add_epi16(_mm256_maddubs_epi16(ones_8, _mm256_loadu_si256((const __m256i *) a_ptr[b].qs)),
+                                     _mm256_maddubs_epi16(ones_8, _mm256_loadu_si256((const __m256i *) a_ptr[b].qs + 1))),
+                    _mm256_add_epi16(_mm256_maddubs_epi16(ones_8, _mm256_loadu_si256((const __m256i *) a_ptr[b].qs + 2)),
+                                     _mm256_maddubs_epi16(ones_8, _mm256_loadu_si256((const __m256i *) a_ptr[b].qs + 3))));
+                const __m256i lhs_sum_32 = _mm256_madd_epi16(lhs_sum_16, ones_16);
+                const __m256i lhs_sums   = _mm256_hadd_epi32(lhs_sum_32, lhs_sum_32);
+
+                for (int i = 0; i < 4; i++) {
+                    const __m256i lhs_0 = q5_xN_load_broadcast_8(a_ptr[b].qs + i * 8);
+                    const __m256i lhs_1 = q5_xN_load_broadcast_8(a_ptr[b].qs + i * 8 + 32);
+                    const __m256i lhs_2 = q5_xN_load_broadcast_8(a_ptr[b].qs + i * 8 + 64);
+                    const __m256i lhs_3 = q5_xN_load_broadcast_8(a_ptr[b].qs + i * 8 + 96);
+
+                    const __m256i dot_0123 = _mm256_add_epi16(
+                        _mm256_add_epi16(_mm256_maddubs_epi16(rhs_0123_0, lhs_0), _mm256_maddubs_epi16(rhs_0123_1, lhs_1)),
+                        _mm256_add_epi16(_mm256_maddubs_epi16(rhs_0123_2, lhs_2), _mm256_maddubs_epi16(rhs_0123_3, lhs_3)));
+                    const __m256i dot_4567 = _mm256_add_epi16(
+                        _mm256_add_epi16(_mm256_maddubs_epi16(rhs_4567_0, lhs_0), _mm256_maddubs_epi16(rhs_4567_1, lhs_1)),
+                        _mm256_add_epi16(_mm256_maddubs_epi16(rhs_4567_2, lhs_2), _mm256_maddubs_epi16(rhs_4567_3, lhs_3)));
+
+                    __m256i iacc = _mm256_hadd_epi32(_mm256_madd_epi16(dot_0123, ones_16), _mm256_madd_epi16(dot_4567, ones_16));
+
+                    const __m256i lhs_sum       = _mm256_permutevar8x32_epi32(lhs_sums, row_sum_lane[i]);
+                    const __m256  row_scale_f32 = _mm256_set1_ps(WSP_GGML_CPU_FP16_TO_FP32(a_ptr[b].d[i]));
+
+                    if constexpr (has_min) {
+                        acc_rows[i] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(iacc), _mm256_mul_ps(col_scale_f32, row_scale_f32), acc_rows[i]);
+                        acc_rows[i] = _mm256_fmadd_ps(col_min_f32, _mm256_mul_ps(_mm256_cvtepi32_ps(lhs_sum), row_scale_f32), acc_rows[i]);
+                    } else {
+                        iacc = _mm256_sub_epi32(iacc, _mm256_slli_epi32(lhs_sum, 4));
+                        acc_rows[i] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(iacc), _mm256_mul_ps(col_scale_f32, row_scale_f32), acc_rows[i]);
+                    }
+                }
+            }
+
+            for (int i = 0; i < 4; i++) {
+                _mm256_storeu_ps(s + (y * 4 + i) * bs + x * 8, _mm256_permutevar8x32_ps(acc_rows[i], finalpermutemask));
+            }
+        }
+    }
+}
+
+#endif // defined(__AVX2__)
+
 void wsp_ggml_gemv_q4_0_8x8_q8_0(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
 #if defined(__AVX2__) || defined(__AVX512F__)
     {
@@ -1710,6 +1911,24 @@ void wsp_ggml_gemv_mxfp4_8x8_q8_0(int n, float * WSP_GGML_RESTRICT s, size_t bs,
     wsp_ggml_gemv_mxfp4_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
 }
 
+void wsp_ggml_gemv_q5_0_8x8_q8_0(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    gemv_q5_8x8_q8_0_avx2<block_q5_0x8>(n, s, bs, vx, vy, nr, nc);
+    return;
+#endif
+
+    wsp_ggml_gemv_q5_0_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
+}
+
+void wsp_ggml_gemv_q5_1_8x8_q8_0(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    gemv_q5_8x8_q8_0_avx2<block_q5_1x8>(n, s, bs, vx, vy, nr, nc);
+    return;
+#endif
+
+    wsp_ggml_gemv_q5_1_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
+}
+
 void wsp_ggml_gemv_q2_K_8x8_q8_K(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
     const int qk = QK_K;
     const int nb = n / qk;
@@ -3523,6 +3742,24 @@ void wsp_ggml_gemm_mxfp4_8x8_q8_0(int n, float * WSP_GGML_RESTRICT s, size_t bs,
     wsp_ggml_gemm_mxfp4_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
 }
 
+void wsp_ggml_gemm_q5_0_8x8_q8_0(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    gemm_q5_8x8_q8_0_avx2<block_q5_0x8>(n, s, bs, vx, vy, nr, nc);
+    return;
+#endif
+
+    wsp_ggml_gemm_q5_0_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
+}
+
+void wsp_ggml_gemm_q5_1_8x8_q8_0(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    gemm_q5_8x8_q8_0_avx2<block_q5_1x8>(n, s, bs, vx, vy, nr, nc);
+    return;
+#endif
+
+    wsp_ggml_gemm_q5_1_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
+}
+
 void wsp_ggml_gemm_q2_K_8x8_q8_K(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
     const int qk = QK_K;
     const int nb = n / qk;
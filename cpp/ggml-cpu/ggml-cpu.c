@@ -3385,6 +3385,10 @@ enum wsp_ggml_status wsp_ggml_graph_compute_with_ctx(struct wsp_ggml_context * c
     return wsp_ggml_graph_compute(cgraph, &cplan);
 }
 
+double wsp_ggml_cpu_soft_max_f32(int n, float * y, const float * x, float max) {
+    return wsp_ggml_vec_soft_max_f32(n, y, x, max);
+}
+
 void wsp_ggml_cpu_fp32_to_fp32(const float * x, float * y, int64_t n) {
     memcpy(y, x, n * sizeof(float));
 }
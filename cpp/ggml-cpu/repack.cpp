@@ -749,6 +749,141 @@ static void wsp_ggml_gemm_q5_K_NxM_q8_K_generic_impl(int
     }
 }
 
+// the 5-bit quant (0..31) stored in the low (hi == 0) or high (hi == 1) nibble of qs[i]
+static inline int q5_xN_get(const uint8_t * qs, const uint8_t * qh, int i, int hi) {
+    const int h = (qh[(i / 32) * 8 + hi * 4 + (i % 32) / 8] >> (i % 8)) & 1;
+    return ((hi ? qs[i] >> 4 : qs[i] & 0xF) | (h << 4));
+}
+
+template <typename block_tx, int M, int N>
+static void wsp_ggml_gemv_q5_NxM_q8_0_generic_impl(int                        n,
+                                               float * WSP_GGML_RESTRICT      s,
+                                               size_t                     bs,
+                                               const void * WSP_GGML_RESTRICT vx,
+                                               const void * WSP_GGML_RESTRICT vy,
+                                               int                        nr,
+                                               int                        nc) {
+    constexpr int  blocklen          = M;
+    constexpr int  ncols_interleaved = N;
+    constexpr bool has_min           = std::is_same_v<block_tx, block_q5_1xN<N>>;
+    const int      qk                = QK8_0;
+    const int      nb                = n / qk;
+
+    assert(nr == 1);
+    assert(n % qk == 0);
+    assert(nc % ncols_interleaved == 0);
+
+    UNUSED(bs);
+    UNUSED(nr);
+
+    float sumf[ncols_interleaved];
+    int   sumi;
+    int   suma;
+
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+    for (int x = 0; x < nc / ncols_interleaved; x++) {
+        const block_tx * b_ptr = (const block_tx *) vx + (x * nb);
+
+        for (int j = 0; j < ncols_interleaved; j++) {
+            sumf[j] = 0.0;
+        }
+        for (int l = 0; l < nb; l++) {
+            suma = 0;
+            for (int i = 0; i < qk; i++) {
+                suma += a_ptr[l].qs[i];
+            }
+            const float da = WSP_GGML_CPU_FP16_TO_FP32(a_ptr[l].d);
+            for (int j = 0; j < ncols_interleaved; j++) {
+                sumi = 0;
+                for (int k = 0; k < (qk / (2 * blocklen)); k++) {
+                    for (int i = 0; i < blocklen; ++i) {
+                        const int b_offset = k * ncols_interleaved * blocklen + j * blocklen + i;
+                        const int v0 = q5_xN_get(b_ptr[l].qs, b_ptr[l].qh, b_offset, 0);
+                        const int v1 = q5_xN_get(b_ptr[l].qs, b_ptr[l].qh, b_offset, 1);
+                        sumi += v0 * a_ptr[l].qs[k * blocklen + i] + v1 * a_ptr[l].qs[k * blocklen + i + qk / 2];
+                    }
+                }
+                if constexpr (has_min) {
+                    sumf[j] += (sumi * WSP_GGML_CPU_FP16_TO_FP32(b_ptr[l].d[j]) + suma * WSP_GGML_CPU_FP16_TO_FP32(b_ptr[l].m[j])) * da;
+                } else {
+                    sumf[j] += (sumi - 16 * suma) * WSP_GGML_CPU_FP16_TO_FP32(b_ptr[l].d[j]) * da;
+                }
+            }
+        }
+        for (int j = 0; j < ncols_interleaved; j++) {
+            s[x * ncols_interleaved + j] = sumf[j];
+        }
+    }
+}
+
+template <typename block_tx, int M, int N>
+static void wsp_ggml_gemm_q5_NxM_q8_0_generic_impl(int                        n,
+                                               float * WSP_GGML_RESTRICT      s,
+                                               size_t                     bs,
+                                               const void * WSP_GGML_RESTRICT vx,
+                                               const void * WSP_GGML_RESTRICT vy,
+                                               int                        nr,
+                                               int                        nc) {
+    constexpr int  blocklen          = M;
+    constexpr int  ncols_interleaved = N;
+    constexpr bool has_min           = std::is_same_v<block_tx, block_q5_1xN<N>>;
+    const int      qk                = QK8_0;
+    const int      nb                = n / qk;
+
+    assert(n % qk == 0);
+    assert(nr % 4 == 0);
+    assert(nc % ncols_interleaved == 0);
+
+    float sumf[4][ncols_interleaved];
+    int   sumi;
+    int   suma[4];
+
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+        for (int x = 0; x < nc / ncols_interleaved; x++) {
+            const block_tx * b_ptr = (const block_tx *) vx + (x * nb);
+            for (int m = 0; m < 4; m++) {
+                for (int j = 0; j < ncols_interleaved; j++) {
+                    sumf[m][j] = 0.0;
+                }
+            }
+            for (int l = 0; l < nb; l++) {
+                for (int m = 0; m < 4; m++) {
+                    suma[m] = 0;
+                    for (int i = 0; i < qk; i++) {
+                        suma[m] += a_ptr[l].qs[(i / blocklen) * 4 * blocklen + m * blocklen + i % blocklen];
+                    }
+                }
+                for (int m = 0; m < 4; m++) {
+                    const float da = WSP_GGML_CPU_FP16_TO_FP32(a_ptr[l].d[m]);
+                    for (int j = 0; j < ncols_interleaved; j++) {
+                        sumi = 0;
+                        for (int k = 0; k < (qk / (2 * blocklen)); k++) {
+                            for (int i = 0; i < blocklen; ++i) {
+                                const int b_offset = k * ncols_interleaved * blocklen + j * blocklen + i;
+                                const int v0 = q5_xN_get(b_ptr[l].qs, b_ptr[l].qh, b_offset, 0);
+                                const int v1 = q5_xN_get(b_ptr[l].qs, b_ptr[l].qh, b_offset, 1);
+                                sumi += v0 * a_ptr[l].qs[k * 4 * blocklen + m * blocklen + i] +
+                                        v1 * a_ptr[l].qs[k * 4 * blocklen + m * blocklen + i + qk / 2 * 4];
+                            }
+                        }
+                        if constexpr (has_min) {
+                            sumf[m][j] += (sumi * WSP_GGML_CPU_FP16_TO_FP32(b_ptr[l].d[j]) + suma[m] * WSP_GGML_CPU_FP16_TO_FP32(b_ptr[l].m[j])) * da;
+                        } else {
+                            sumf[m][j] += (sumi - 16 * suma[m]) * WSP_GGML_CPU_FP16_TO_FP32(b_ptr[l].d[j]) * da;
+                        }
+                    }
+                }
+            }
+            for (int m = 0; m < 4; m++) {
+                for (int j = 0; j < ncols_interleaved; j++) {
+                    s[(y * 4 + m) * bs + x * ncols_interleaved + j] = sumf[m][j];
+                }
+            }
+        }
+    }
+}
+
 extern "C" {
 
 void wsp_ggml_gemv_q4_0_4x4_q8_0_generic(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
@@ -1365,6 +1500,14 @@ void wsp_ggml_gemv_q8_0_4x8_q8_0_generic(int                        n,
     }
 }
 
+void wsp_ggml_gemv_q5_0_8x8_q8_0_generic(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+    wsp_ggml_gemv_q5_NxM_q8_0_generic_impl<block_q5_0x8, 8, 8>(n, s, bs, vx, vy, nr, nc);
+}
+
+void wsp_ggml_gemv_q5_1_8x8_q8_0_generic(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+    wsp_ggml_gemv_q5_NxM_q8_0_generic_impl<block_q5_1x8, 8, 8>(n, s, bs, vx, vy, nr, nc);
+}
+
 // Only enable these for RISC-V.
 #if defined __riscv_zvfh
 void wsp_ggml_gemv_q4_0_16x1_q8_0_generic(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
@@ -2383,6 +2526,14 @@ void wsp_ggml_gemm_q8_0_4x8_q8_0_generic(int                        n,
     }
 }
 
+void wsp_ggml_gemm_q5_0_8x8_q8_0_generic(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+    wsp_ggml_gemm_q5_NxM_q8_0_generic_impl<block_q5_0x8, 8, 8>(n, s, bs, vx, vy, nr, nc);
+}
+
+void wsp_ggml_gemm_q5_1_8x8_q8_0_generic(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
+    wsp_ggml_gemm_q5_NxM_q8_0_generic_impl<block_q5_1x8, 8, 8>(n, s, bs, vx, vy, nr, nc);
+}
+
 // Only enable these for RISC-V.
 #if defined __riscv_zvfh
 void wsp_ggml_gemm_q4_0_16x1_q8_0_generic(int n, float * WSP_GGML_RESTRICT s, size_t bs, const void * WSP_GGML_RESTRICT vx, const void * WSP_GGML_RESTRICT vy, int nr, int nc) {
@@ -3509,6 +3660,77 @@ static int repack_q8_0_to_q8_0_4_bl(struct wsp_ggml_tensor *       t,
     return 0;
 }
 
+// interleave N block_q5_0 / block_q5_1 in blocks of 8 quant bytes, the fifth bits follow the
+// position of their nibble (see block_q5_0xN)
+template <typename block_tx, typename block_t, int N>
+static block_tx make_block_q5_xN(const block_t * in, unsigned int blck_size_interleave) {
+    block_tx out;
+
+    for (int i = 0; i < N; i++) {
+        if constexpr (std::is_same_v<block_t, block_q5_1>) {
+            out.d[i] = in[i].WSP_GGML_COMMON_AGGR_U.WSP_GGML_COMMON_AGGR_S.d;
+            out.m[i] = in[i].WSP_GGML_COMMON_AGGR_U.WSP_GGML_COMMON_AGGR_S.m;
+        } else {
+            out.d[i] = in[i].d;
+        }
+    }
+
+    memset(out.qh, 0, sizeof(out.qh));
+
+    const int end = QK5_0 / 2 * N / blck_size_interleave;
+    for (int i = 0; i < end; ++i) {
+        int src_id     = i % N;
+        int src_offset = (i / N) * blck_size_interleave;
+        int dst_offset = i * blck_size_interleave;
+
+        memcpy(&out.qs[dst_offset], &in[src_id].qs[src_offset], blck_size_interleave);
+
+        uint32_t qh;
+        memcpy(&qh, in[src_id].qh, sizeof(qh));
+
+        for (unsigned int k = 0; k < blck_size_interleave; k++) {
+            const int j   = src_offset + k;      // quant j in the low nibble, j + 16 in the high nibble
+            const int dst = dst_offset + k;
+            const int h   = (dst / 32) * 8 + (dst % 32) / 8;
+            out.qh[h]     |= ((qh >> j) & 1) << (dst % 8);
+            out.qh[h + 4] |= ((qh >> (j + 16)) & 1) << (dst % 8);
+        }
+    }
+    return out;
+}
+
+template <typename block_tx, typename block_t, int nrows_interleaved>
+static int repack_q5_to_q5_xN_bl(struct wsp_ggml_tensor *       t,
+                                 int                        interleave_block,
+                                 const void * WSP_GGML_RESTRICT data,
+                                 size_t                     data_size) {
+    WSP_GGML_ASSERT(t->type == (std::is_same_v<block_t, block_q5_1> ? WSP_GGML_TYPE_Q5_1 : WSP_GGML_TYPE_Q5_0));
+    WSP_GGML_ASSERT(interleave_block == 8);
+
+    block_tx *      dst = (block_tx *) t->data;
+    const block_t * src = (const block_t *) data;
+    block_t         dst_tmp[nrows_interleaved];
+    int             nrow    = wsp_ggml_nrows(t);
+    int             nblocks = t->ne[0] / QK5_0;
+
+    WSP_GGML_ASSERT(data_size == nrow * nblocks * sizeof(block_t));
+
+    if (t->ne[1] % nrows_interleaved != 0 || t->ne[0] % 8 != 0) {
+        return -1;
+    }
+
+    for (int b = 0; b < nrow; b += nrows_interleaved) {
+        for (int64_t x = 0; x < nblocks; x++) {
+            for (int i = 0; i < nrows_interleaved; i++) {
+                dst_tmp[i] = src[x + i * nblocks];
+            }
+            *dst++ = make_block_q5_xN<block_tx, block_t, nrows_interleaved>(dst_tmp, interleave_block);
+        }
+        src += nrows_interleaved * nblocks;
+    }
+    return 0;
+}
+
 static block_q8_0x16 make_block_q8_0x16(block_q8_0 * in, unsigned int blck_size_interleave) {
     block_q8_0x16 out;
 
@@ -3934,6 +4156,14 @@ template <> int repack<block_q8_0, 8, 4>(struct wsp_ggml_tensor * t, const void
     return repack_q8_0_to_q8_0_4_bl(t, 8, data, data_size);
 }
 
+template <> int repack<block_q5_0, 8, 8>(struct wsp_ggml_tensor * t, const void * data, size_t data_size) {
+    return repack_q5_to_q5_xN_bl<block_q5_0x8, block_q5_0, 8>(t, 8, data, data_size);
+}
+
+template <> int repack<block_q5_1, 8, 8>(struct wsp_ggml_tensor * t, const void * data, size_t data_size) {
+    return repack_q5_to_q5_xN_bl<block_q5_1x8, block_q5_1, 8>(t, 8, data, data_size);
+}
+
 #if defined __riscv_zvfh
 template <> int repack<block_q4_0, 1, 16>(struct wsp_ggml_tensor * t, const void * data, size_t data_size) {
     return repack_q4_0_to_q4_0_16_bl(t, 1, data, data_size);
@@ -4031,6 +4261,14 @@ template <> void gemv<block_q8_0, 8, 4, WSP_GGML_TYPE_Q8_0>(int n, float * s, si
     wsp_ggml_gemv_q8_0_4x8_q8_0(n, s, bs, vx, vy, nr, nc);
 }
 
+template <> void gemv<block_q5_0, 8, 8, WSP_GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
+    wsp_ggml_gemv_q5_0_8x8_q8_0(n, s, bs, vx, vy, nr, nc);
+}
+
+template <> void gemv<block_q5_1, 8, 8, WSP_GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
+    wsp_ggml_gemv_q5_1_8x8_q8_0(n, s, bs, vx, vy, nr, nc);
+}
+
 #if defined __riscv_zvfh
 template <> void gemv<block_q4_0, 1, 16, WSP_GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
     wsp_ggml_gemv_q4_0_16x1_q8_0(n, s, bs, vx, vy, nr, nc);
@@ -4128,6 +4366,14 @@ template <> void gemm<block_q8_0, 8, 4, WSP_GGML_TYPE_Q8_0>(int n, float * s, si
     wsp_ggml_gemm_q8_0_4x8_q8_0(n, s, bs, vx, vy, nr, nc);
 }
 
+template <> void gemm<block_q5_0, 8, 8, WSP_GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
+    wsp_ggml_gemm_q5_0_8x8_q8_0(n, s, bs, vx, vy, nr, nc);
+}
+
+template <> void gemm<block_q5_1, 8, 8, WSP_GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
+    wsp_ggml_gemm_q5_1_8x8_q8_0(n, s, bs, vx, vy, nr, nc);
+}
+
 #if defined __riscv_zvfh
 template <> void gemm<block_q4_0, 1, 16, WSP_GGML_TYPE_Q8_0>(int n, float * s, size_t bs, const void * vx, const void * vy, int nr, int nc) {
     wsp_ggml_gemm_q4_0_16x1_q8_0(n, s, bs, vx, vy, nr, nc);
@@ -4558,6 +4804,10 @@ static const ggml::cpu::tensor_traits * wsp_ggml_repack_get_optimal_repack_type(
     static const ggml::cpu::repack::tensor_traits<block_q8_0, 4, 4, WSP_GGML_TYPE_Q8_0> q8_0_4x4_q8_0;
     static const ggml::cpu::repack::tensor_traits<block_q8_0, 8, 4, WSP_GGML_TYPE_Q8_0> q8_0_4x8_q8_0;
 
+    // instance for Q5_0 / Q5_1
+    static const ggml::cpu::repack::tensor_traits<block_q5_0, 8, 8, WSP_GGML_TYPE_Q8_0> q5_0_8x8_q8_0;
+    static const ggml::cpu::repack::tensor_traits<block_q5_1, 8, 8, WSP_GGML_TYPE_Q8_0> q5_1_8x8_q8_0;
+
     // instances for RISC-V
     //
     // These implement outer-product style matrix multiplication kernels with
@@ -4696,6 +4946,19 @@ static const ggml::cpu::tensor_traits * wsp_ggml_repack_get_optimal_repack_type(
                 return &mxfp4_4x4_q8_0;
             }
         }
+    } else if (cur->type == WSP_GGML_TYPE_Q5_0) {
+        // Q5 only has AVX2 kernels, without them the weights stay in the plain CPU buffer
+        if (wsp_ggml_cpu_has_avx2()) {
+            if (cur->ne[1] % 8 == 0) {
+                return &q5_0_8x8_q8_0;
+            }
+        }
+    } else if (cur->type == WSP_GGML_TYPE_Q5_1) {
+        if (wsp_ggml_cpu_has_avx2()) {
+            if (cur->ne[1] % 8 == 0) {
+                return &q5_1_8x8_q8_0;
+            }
+        }
     } else if (cur->type == WSP_GGML_TYPE_Q8_0) {
         if (wsp_ggml_cpu_has_neon() && wsp_ggml_cpu_has_matmul_int8()) {
             if (cur->ne[1] % 4 == 0) {
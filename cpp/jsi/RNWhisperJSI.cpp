@@ -11,6 +11,7 @@
 #include <cstdio>
 #include <cstring>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
@@ -265,6 +266,16 @@ struct VadResultData {
     std::vector<VadSegmentData> segments;
 };
 
+struct VadStreamEventData {
+    bool start = false;
+    float t = 0;
+};
+
+struct VadStreamResultData {
+    bool isSpeech = false;
+    std::vector<VadStreamEventData> events;
+};
+
 struct ContextLifecycle {
     void retainTask() {
         std::lock_guard<std::mutex> lock(mutex);
@@ -334,6 +345,9 @@ struct WhisperContextHolder : public ContextLifecycle {
     std::mutex operationMutex;
     bool busy = false;
     int activeJobId = -1;
+
+    // int16 audio is converted here, reused across transcriptions (guarded by the exclusive operation)
+    std::vector<float> pcmf32;
 };
 
 struct WhisperVadContextHolder : public ContextLifecycle {
@@ -350,6 +364,19 @@ struct WhisperVadContextHolder : public ContextLifecycle {
 ContextManager<WhisperContextHolder> g_whisperContexts;
 ContextManager<WhisperVadContextHolder> g_vadContexts;
 
+// Contexts loaded from the same model file with the same weight options share the model weights:
+// the first one loads the model, the next ones are created from a live one with whisper_init_from_context_with_params()
+// and only allocate their state, with their own flash attention and KV cache options.
+// The weights are refcounted by whisper.cpp and freed with the last context.
+struct SharedModelContext {
+    whisper_context *context = nullptr;
+    bool gpu = false;
+    std::string reasonNoGPU;
+};
+
+std::mutex g_sharedModelsMutex;
+std::map<std::string, std::vector<SharedModelContext>> g_sharedModels;
+
 using PromiseResultGenerator = std::function<jsi::Value(jsi::Runtime &)>;
 using PromiseTask = std::function<PromiseResultGenerator()>;
 using JsiFunctionPtr = std::shared_ptr<jsi::Function>;
@@ -395,18 +422,14 @@ private:
     bool active_ = true;
 };
 
-JsiFunctionPtr makeJsiFunction(
-    jsi::Runtime &runtime,
-    const jsi::Value &value,
+// jsi values must be released on the JS thread, the last reference may be dropped by a worker task
+template <typename T>
+std::shared_ptr<T> makeJsThreadShared(
+    T *value,
     const std::shared_ptr<react::CallInvoker> &callInvoker) {
-    if (!value.isObject() || !value.asObject(runtime).isFunction(runtime)) {
-        return nullptr;
-    }
-
-    auto *fn = new jsi::Function(value.asObject(runtime).asFunction(runtime));
     std::weak_ptr<react::CallInvoker> weakInvoker = callInvoker;
 
-    return JsiFunctionPtr(fn, [weakInvoker](jsi::Function *ptr) {
+    return std::shared_ptr<T>(value, [weakInvoker](T *ptr) {
         if (!ptr || g_isShuttingDown.load(std::memory_order_relaxed)) {
             return;
         }
@@ -426,6 +449,19 @@ JsiFunctionPtr makeJsiFunction(
     });
 }
 
+JsiFunctionPtr makeJsiFunction(
+    jsi::Runtime &runtime,
+    const jsi::Value &value,
+    const std::shared_ptr<react::CallInvoker> &callInvoker) {
+    if (!value.isObject() || !value.asObject(runtime).isFunction(runtime)) {
+        return nullptr;
+    }
+
+    return makeJsThreadShared(
+        new jsi::Function(value.asObject(runtime).asFunction(runtime)),
+        callInvoker);
+}
+
 jsi::Object createErrorObject(
     jsi::Runtime &runtime,
     const std::string &message,
@@ -687,6 +723,18 @@ float getFloatProperty(
     return value.isNumber() ? static_cast<float>(value.asNumber()) : fallback;
 }
 
+double getNumberProperty(
+    jsi::Runtime &runtime,
+    const jsi::Object &object,
+    const char *name,
+    double fallback) {
+    if (!object.hasProperty(runtime, name)) {
+        return fallback;
+    }
+    auto value = object.getProperty(runtime, name);
+    return value.isNumber() ? value.asNumber() : fallback;
+}
+
 std::string getStringProperty(
     jsi::Runtime &runtime,
     const jsi::Object &object,
@@ -737,6 +785,8 @@ TranscribeConfig createTranscribeConfig(
         getIntProperty(runtime, options, "offset", config.params.offset_ms);
     config.params.duration_ms =
         getIntProperty(runtime, options, "duration", config.params.duration_ms);
+    config.params.dynamic_audio_ctx =
+        getBoolProperty(runtime, options, "dynamicAudioCtx", false);
     config.params.thold_pt =
         getFloatProperty(runtime, options, "wordThold", config.params.thold_pt);
     config.params.temperature =
@@ -1199,6 +1249,37 @@ TranscribeResultData buildTranscribeResult(
     return result;
 }
 
+// one result per clip of whisper_full_batch(), the segments are stored in clip order
+std::vector<TranscribeResultData> buildBatchTranscribeResults(
+    whisper_context *context,
+    int nClips,
+    bool tdrzEnable,
+    bool isAborted) {
+    std::vector<TranscribeResultData> results(static_cast<size_t>(nClips));
+    for (int clip = 0; clip < nClips; ++clip) {
+        results[clip].isAborted = isAborted;
+        const char *language = whisper_lang_str(whisper_full_clip_lang_id(context, clip));
+        results[clip].language = language ? language : "";
+    }
+
+    int count = whisper_full_n_segments(context);
+    for (int index = 0; index < count; ++index) {
+        auto &result = results[whisper_full_get_segment_clip(context, index)];
+        std::string text = whisper_full_get_segment_text(context, index);
+        if (tdrzEnable && whisper_full_get_segment_speaker_turn_next(context, index)) {
+            text += " [SPEAKER_TURN]";
+        }
+        result.result.append(text);
+        result.segments.push_back({
+            text,
+            static_cast<int>(whisper_full_get_segment_t0(context, index)),
+            static_cast<int>(whisper_full_get_segment_t1(context, index)),
+        });
+    }
+
+    return results;
+}
+
 jsi::Array createSegmentsArray(
     jsi::Runtime &runtime,
     const std::vector<SegmentData> &segments) {
@@ -1234,6 +1315,16 @@ jsi::Value createTranscribeResultValue(
     return result;
 }
 
+jsi::Value createBatchTranscribeResultValue(
+    jsi::Runtime &runtime,
+    const std::vector<TranscribeResultData> &results) {
+    jsi::Array array(runtime, results.size());
+    for (size_t index = 0; index < results.size(); ++index) {
+        array.setValueAtIndex(runtime, index, createTranscribeResultValue(runtime, results[index]));
+    }
+    return jsi::Value(std::move(array));
+}
+
 jsi::Value createNewSegmentsValue(
     jsi::Runtime &runtime,
     const NewSegmentsData &data) {
@@ -1264,6 +1355,25 @@ jsi::Value createVadResultValue(
     return result;
 }
 
+jsi::Value createVadStreamResultValue(
+    jsi::Runtime &runtime,
+    const VadStreamResultData &data) {
+    jsi::Object result(runtime);
+    result.setProperty(runtime, "isSpeech", jsi::Value(data.isSpeech));
+    jsi::Array events(runtime, data.events.size());
+    for (size_t index = 0; index < data.events.size(); ++index) {
+        jsi::Object item(runtime);
+        item.setProperty(
+            runtime,
+            "type",
+            jsi::String::createFromAscii(runtime, data.events[index].start ? "start" : "end"));
+        item.setProperty(runtime, "t", jsi::Value(data.events[index].t));
+        events.setValueAtIndex(runtime, index, item);
+    }
+    result.setProperty(runtime, "events", events);
+    return result;
+}
+
 jsi::Value createContextValue(
     jsi::Runtime &runtime,
     const std::shared_ptr<WhisperContextHolder> &holder) {
@@ -1358,6 +1468,79 @@ void forwardLogToJs(enum wsp_ggml_log_level level, const char *text, void *) {
 
 constexpr auto kCleanupWaitTimeout = std::chrono::milliseconds(250);
 
+std::string createModelKey(const WhisperContextInitOptions &options) {
+    std::string path = options.filePath;
+    if (!options.isBundleAsset) {
+        if (char *resolved = realpath(path.c_str(), nullptr)) {
+            path = resolved;
+            free(resolved);
+        }
+    }
+    // only the options that decide how the weights are loaded, the others are applied to the state of each context
+    return path + "|" +
+        (options.isBundleAsset ? "1" : "0") +
+        (options.useGpu ? "1" : "0") +
+        (options.useCoreMLIos ? "1" : "0") +
+        (options.useCpuRepack ? "1" : "0");
+}
+
+whisper_context_params createStateParams(const WhisperContextInitOptions &options) {
+    auto params = whisper_context_default_params();
+    params.dtw_token_timestamps = false;
+    params.flash_attn = options.useFlashAttn;
+    params.kv_cross_cache_size = options.kvCrossCacheSize;
+    params.type_k = options.kvCacheType;
+    params.type_v = options.kvCacheType;
+    return params;
+}
+
+WhisperContextInitResult initSharedWhisperContext(const WhisperContextInitOptions &options) {
+    const std::string key = createModelKey(options);
+
+    WhisperContextInitResult result;
+    {
+        std::lock_guard<std::mutex> lock(g_sharedModelsMutex);
+        auto it = g_sharedModels.find(key);
+        if (it != g_sharedModels.end() && !it->second.empty()) {
+            const SharedModelContext &source = it->second.front();
+            result.context = whisper_init_from_context_with_params(source.context, createStateParams(options));
+            if (result.context != nullptr) {
+                result.gpu = source.gpu;
+                result.reasonNoGPU = source.reasonNoGPU;
+                it->second.push_back({result.context, result.gpu, result.reasonNoGPU});
+                return result;
+            }
+        }
+    }
+
+    result = hostInitWhisperContext(options);
+    if (result.context != nullptr) {
+        std::lock_guard<std::mutex> lock(g_sharedModelsMutex);
+        g_sharedModels[key].push_back({result.context, result.gpu, result.reasonNoGPU});
+    }
+    return result;
+}
+
+void freeSharedWhisperContext(whisper_context *context) {
+    {
+        std::lock_guard<std::mutex> lock(g_sharedModelsMutex);
+        for (auto it = g_sharedModels.begin(); it != g_sharedModels.end(); ++it) {
+            auto &contexts = it->second;
+            auto found = std::find_if(contexts.begin(), contexts.end(), [context](const SharedModelContext &item) {
+                return item.context == context;
+            });
+            if (found != contexts.end()) {
+                contexts.erase(found);
+                if (contexts.empty()) {
+                    g_sharedModels.erase(it);
+                }
+                break;
+            }
+        }
+    }
+    whisper_free(context);
+}
+
 bool releaseWhisperHolder(
     const std::shared_ptr<WhisperContextHolder> &holder,
     bool allowBlocking = true) {
@@ -1374,7 +1557,7 @@ bool releaseWhisperHolder(
         return false;
     }
     if (holder->context != nullptr) {
-        whisper_free(holder->context);
+        freeSharedWhisperContext(holder->context);
         holder->context = nullptr;
     }
     return true;
@@ -1436,6 +1619,31 @@ std::string requireStringArgument(
     return arguments[index].asString(runtime).utf8(runtime);
 }
 
+std::vector<std::string> requireStringArrayArgument(
+    jsi::Runtime &runtime,
+    const jsi::Value *arguments,
+    size_t count,
+    size_t index,
+    const char *message) {
+    if (count <= index || !arguments[index].isObject()) {
+        throw jsi::JSError(runtime, message);
+    }
+    auto object = arguments[index].asObject(runtime);
+    if (!object.isArray(runtime)) {
+        throw jsi::JSError(runtime, message);
+    }
+    auto array = object.asArray(runtime);
+    std::vector<std::string> values(array.size(runtime));
+    for (size_t i = 0; i < values.size(); ++i) {
+        auto value = array.getValueAtIndex(runtime, i);
+        if (!value.isString()) {
+            throw jsi::JSError(runtime, message);
+        }
+        values[i] = value.asString(runtime).utf8(runtime);
+    }
+    return values;
+}
+
 std::vector<float> requireAudioBufferArgument(
     jsi::Runtime &runtime,
     const jsi::Value *arguments,
@@ -1452,6 +1660,44 @@ std::vector<float> requireAudioBufferArgument(
     return decodePcm16(arrayBuffer.data(runtime), arrayBuffer.size(runtime));
 }
 
+// Keeps the JS ArrayBuffer alive until the task is done so the samples are read in place
+struct PinnedAudioBuffer {
+    std::shared_ptr<jsi::ArrayBuffer> buffer;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    bool isFloat = false;
+};
+
+PinnedAudioBuffer requirePinnedAudioBufferArgument(
+    jsi::Runtime &runtime,
+    const jsi::Value *arguments,
+    size_t count,
+    size_t index,
+    bool isFloat,
+    const std::shared_ptr<react::CallInvoker> &callInvoker) {
+    if (count <= index || !arguments[index].isObject()) {
+        throw jsi::JSError(runtime, "Audio argument must be an ArrayBuffer");
+    }
+    auto object = arguments[index].asObject(runtime);
+    if (!object.isArrayBuffer(runtime)) {
+        throw jsi::JSError(runtime, "Audio argument must be an ArrayBuffer");
+    }
+
+    PinnedAudioBuffer pinned;
+    pinned.buffer = makeJsThreadShared(
+        new jsi::ArrayBuffer(object.getArrayBuffer(runtime)),
+        callInvoker);
+    pinned.data = pinned.buffer->data(runtime);
+    pinned.size = pinned.buffer->size(runtime);
+    pinned.isFloat = isFloat;
+
+    size_t sampleSize = isFloat ? sizeof(float) : sizeof(int16_t);
+    if (pinned.size < sampleSize) {
+        throw jsi::JSError(runtime, "Invalid audio data");
+    }
+    return pinned;
+}
+
 } // namespace
 
 namespace rnwhisper_jsi {
@@ -1518,16 +1764,23 @@ void installJSIBindings(
                 getBoolProperty(runtime, options, "useCoreMLIos", true);
             hostOptions.downloadCoreMLAssets =
                 getBoolProperty(runtime, options, "downloadCoreMLAssets", false);
+            hostOptions.kvCrossCacheSize = static_cast<size_t>(std::max(
+                0.0, getNumberProperty(runtime, options, "kvCrossCacheSize", 0)));
+            const std::string kvCacheType = getStringProperty(runtime, options, "kvCacheType", "f16");
+            hostOptions.kvCacheType = kvCacheType == "q8_0" ? WSP_GGML_TYPE_Q8_0 :
+                kvCacheType == "q4_0" ? WSP_GGML_TYPE_Q4_0 : WSP_GGML_TYPE_F16;
+            hostOptions.useCpuRepack =
+                getBoolProperty(runtime, options, "useCpuRepack", true);
             hostOptions.coreMLAssets = parseCoreMLAssets(runtime, options);
 
             return createPromiseTask(runtime, callInvoker, [contextId, hostOptions]() -> PromiseResultGenerator {
-                auto result = hostInitWhisperContext(hostOptions);
+                auto result = initSharedWhisperContext(hostOptions);
                 if (result.context == nullptr) {
                     LOG_ERROR("whisperInitContext failed to load model contextId=%d", contextId);
                     throw JsiError("Failed to load the model");
                 }
                 if (g_isShuttingDown.load(std::memory_order_relaxed)) {
-                    whisper_free(result.context);
+                    freeSharedWhisperContext(result.context);
                     return [](jsi::Runtime &) {
                         return jsi::Value::undefined();
                     };
@@ -1709,6 +1962,11 @@ void installJSIBindings(
                         throw JsiError("Failed to create transcription job");
                     }
 
+                    if (config.nProcessors > 1) {
+                        // keep the extra processor states warm across transcriptions
+                        whisper_state_pool_reserve(holder->context, config.nProcessors - 1);
+                    }
+
                     int code = whisper_full_parallel(
                         holder->context,
                         job->params,
@@ -1753,7 +2011,9 @@ void installJSIBindings(
                 count,
                 1,
                 "Transcription options must be an object");
-            auto audio = requireAudioBufferArgument(runtime, arguments, count, 2);
+            // 'f32' audio is used in place, 's16' is converted into a buffer reused by the context
+            bool isFloat = getStringProperty(runtime, options, "audioFormat", "s16") == "f32";
+            auto audio = requirePinnedAudioBufferArgument(runtime, arguments, count, 2, isFloat, callInvoker);
 
             auto holder = g_whisperContexts.get(contextId);
             if (!holder) {
@@ -1820,19 +2080,44 @@ void installJSIBindings(
                         config.params.new_segment_callback_user_data = &segmentsState;
                     }
 
+                    const float *samples = nullptr;
+                    size_t nSamples = 0;
+                    if (audio.isFloat) {
+                        nSamples = audio.size / sizeof(float);
+                        if (reinterpret_cast<uintptr_t>(audio.data) % alignof(float) == 0) {
+                            samples = reinterpret_cast<const float *>(audio.data);
+                        } else {
+                            holder->pcmf32.resize(nSamples);
+                            std::memcpy(holder->pcmf32.data(), audio.data, nSamples * sizeof(float));
+                            samples = holder->pcmf32.data();
+                        }
+                    } else {
+                        nSamples = audio.size / sizeof(int16_t);
+                        holder->pcmf32.resize(nSamples);
+                        rnwhisper::pcm16_to_f32(audio.data, nSamples, holder->pcmf32.data());
+                        samples = holder->pcmf32.data();
+                    }
+
                     rnwhisper::job *job = rnwhisper::job_new(config.jobId, config.params);
                     if (job == nullptr) {
                         throw JsiError("Failed to create transcription job");
                     }
 
+                    if (config.nProcessors > 1) {
+                        // keep the extra processor states warm across transcriptions
+                        whisper_state_pool_reserve(holder->context, config.nProcessors - 1);
+                    }
+
                     int code = whisper_full_parallel(
                         holder->context,
                         job->params,
-                        audio.data(),
-                        static_cast<int>(audio.size()),
+                        samples,
+                        static_cast<int>(nSamples),
                         config.nProcessors);
                     bool isAborted = job->is_aborted();
                     rnwhisper::job_remove(config.jobId);
+                    // unpin here, the JS side may reuse the buffer as soon as the promise settles
+                    audio.buffer.reset();
 
                     if (code != 0 && !isAborted) {
                         throw JsiError("Transcription failed", code);
@@ -1853,6 +2138,109 @@ void installJSIBindings(
             }
         });
 
+    auto transcribeBatch = jsi::Function::createFromHostFunction(
+        runtime,
+        jsi::PropNameID::forAscii(runtime, "whisperTranscribeBatch"),
+        3,
+        [callInvoker](
+            jsi::Runtime &runtime,
+            const jsi::Value &,
+            const jsi::Value *arguments,
+            size_t count) -> jsi::Value {
+            int contextId = requireContextId(runtime, arguments, count);
+            auto inputs = requireStringArrayArgument(
+                runtime,
+                arguments,
+                count,
+                1,
+                "Transcription inputs must be an array of strings");
+            auto options = requireObjectArgument(
+                runtime,
+                arguments,
+                count,
+                2,
+                "Transcription options must be an object");
+
+            auto holder = g_whisperContexts.get(contextId);
+            if (!holder) {
+                throw jsi::JSError(runtime, "Context not found");
+            }
+            auto runtimePtr = std::shared_ptr<jsi::Runtime>(&runtime, [](jsi::Runtime *) {});
+
+            auto config = createTranscribeConfig(runtime, options, callInvoker);
+            if (!holder->beginExclusiveOperation(config.jobId)) {
+                throw jsi::JSError(runtime, "Context is already transcribing");
+            }
+
+            holder->retainTask();
+            try {
+                return createPromiseTask(runtime, callInvoker, [holder, config, inputs, callInvoker, runtimePtr]() mutable -> PromiseResultGenerator {
+                    PromiseScopeGuard taskGuard([holder]() { holder->releaseTask(); });
+                    PromiseScopeGuard exclusiveGuard([holder]() { holder->endExclusiveOperation(); });
+
+                    std::vector<std::vector<float>> clips(inputs.size());
+                    std::vector<const float *> samples(inputs.size());
+                    std::vector<int> nSamples(inputs.size());
+                    for (size_t i = 0; i < inputs.size(); ++i) {
+                        clips[i] = readWaveAudio(inputs[i]);
+                        if (clips[i].empty()) {
+                            throw JsiError("Invalid file");
+                        }
+                        samples[i] = clips[i].data();
+                        nSamples[i] = static_cast<int>(clips[i].size());
+                    }
+
+                    auto progressState = std::make_shared<JsiCallbackState>();
+                    progressState->callInvoker = callInvoker;
+                    progressState->callback = config.onProgress;
+                    progressState->runtime = runtimePtr;
+                    progressState->contextId = holder->id;
+                    if (config.onProgress) {
+                        config.params.progress_callback =
+                            [](whisper_context *, whisper_state *, int progress, void *userData) {
+                                auto *state = static_cast<std::shared_ptr<JsiCallbackState> *>(userData);
+                                if (!state || !(*state)) {
+                                    return;
+                                }
+                                emitProgressCallback(*state, progress);
+                            };
+                        config.params.progress_callback_user_data = &progressState;
+                    }
+
+                    rnwhisper::job *job = rnwhisper::job_new(config.jobId, config.params);
+                    if (job == nullptr) {
+                        throw JsiError("Failed to create transcription job");
+                    }
+
+                    int code = whisper_full_batch(
+                        holder->context,
+                        job->params,
+                        samples.data(),
+                        nSamples.data(),
+                        static_cast<int>(inputs.size()));
+                    bool isAborted = job->is_aborted();
+                    rnwhisper::job_remove(config.jobId);
+
+                    if (code != 0 && !isAborted) {
+                        throw JsiError("Transcription failed", code);
+                    }
+
+                    auto results = buildBatchTranscribeResults(
+                        holder->context,
+                        static_cast<int>(inputs.size()),
+                        config.tdrzEnable,
+                        isAborted);
+                    return [results](jsi::Runtime &rt) {
+                        return createBatchTranscribeResultValue(rt, results);
+                    };
+                }, contextId);
+            } catch (...) {
+                holder->endExclusiveOperation();
+                holder->releaseTask();
+                throw;
+            }
+        });
+
     auto abortTranscribe = jsi::Function::createFromHostFunction(
         runtime,
         jsi::PropNameID::forAscii(runtime, "whisperAbortTranscribe"),
@@ -1882,10 +2270,37 @@ void installJSIBindings(
             }, contextId);
         });
 
+    auto trimMemory = jsi::Function::createFromHostFunction(
+        runtime,
+        jsi::PropNameID::forAscii(runtime, "whisperTrimMemory"),
+        1,
+        [callInvoker](
+            jsi::Runtime &runtime,
+            const jsi::Value &,
+            const jsi::Value *arguments,
+            size_t count) -> jsi::Value {
+            int contextId = requireContextId(runtime, arguments, count);
+            return createPromiseTask(runtime, callInvoker, [contextId]() -> PromiseResultGenerator {
+                auto holder = g_whisperContexts.get(contextId);
+                if (!holder) {
+                    throw JsiError("Context not found");
+                }
+                // frees the idle states kept for nProcessors > 1, they are recreated on the next transcription
+                whisper_state_pool_trim(holder->context, 0);
+                if (holder->beginExclusiveOperation(-1)) {
+                    std::vector<float>().swap(holder->pcmf32);
+                    holder->endExclusiveOperation();
+                }
+                return [](jsi::Runtime &) {
+                    return jsi::Value::undefined();
+                };
+            }, contextId);
+        });
+
     auto bench = jsi::Function::createFromHostFunction(
         runtime,
         jsi::PropNameID::forAscii(runtime, "whisperBench"),
-        2,
+        3,
         [callInvoker](
             jsi::Runtime &runtime,
             const jsi::Value &,
@@ -1896,6 +2311,10 @@ void installJSIBindings(
                 count > 1 && arguments[1].isNumber()
                     ? static_cast<int>(arguments[1].asNumber())
                     : 0;
+            bool dtw =
+                count > 2 && arguments[2].isObject()
+                    ? getBoolProperty(runtime, arguments[2].asObject(runtime), "dtw", false)
+                    : false;
 
             auto holder = g_whisperContexts.get(contextId);
             if (!holder) {
@@ -1908,11 +2327,11 @@ void installJSIBindings(
 
             holder->retainTask();
             try {
-                return createPromiseTask(runtime, callInvoker, [holder, maxThreads]() -> PromiseResultGenerator {
+                return createPromiseTask(runtime, callInvoker, [holder, maxThreads, dtw]() -> PromiseResultGenerator {
                     PromiseScopeGuard taskGuard([holder]() { holder->releaseTask(); });
                     PromiseScopeGuard exclusiveGuard([holder]() { holder->endExclusiveOperation(); });
 
-                    std::string result = rnwhisper::bench(holder->context, maxThreads);
+                    std::string result = rnwhisper::bench(holder->context, maxThreads, dtw);
                     return [result](jsi::Runtime &rt) {
                         return jsi::String::createFromUtf8(rt, result);
                     };
@@ -2161,6 +2580,97 @@ void installJSIBindings(
             }
         });
 
+    auto vadStreamPush = jsi::Function::createFromHostFunction(
+        runtime,
+        jsi::PropNameID::forAscii(runtime, "whisperVadStreamPush"),
+        3,
+        [callInvoker](
+            jsi::Runtime &runtime,
+            const jsi::Value &,
+            const jsi::Value *arguments,
+            size_t count) -> jsi::Value {
+            int contextId = requireContextId(runtime, arguments, count);
+            auto options = requireObjectArgument(
+                runtime,
+                arguments,
+                count,
+                1,
+                "VAD options must be an object");
+            auto audio = requireAudioBufferArgument(runtime, arguments, count, 2);
+
+            auto holder = g_vadContexts.get(contextId);
+            if (!holder) {
+                throw jsi::JSError(runtime, "VAD context not found");
+            }
+
+            auto vadOptions = createVadParams(runtime, options);
+            holder->retainTask();
+            try {
+                return createPromiseTask(runtime, callInvoker, [holder, audio, vadOptions]() -> PromiseResultGenerator {
+                    PromiseScopeGuard taskGuard([holder]() { holder->releaseTask(); });
+
+                    int nEvents = whisper_vad_stream_push(
+                        holder->context,
+                        vadOptions,
+                        audio.data(),
+                        static_cast<int>(audio.size()));
+                    if (nEvents < 0) {
+                        throw JsiError("Failed to process VAD stream");
+                    }
+
+                    VadStreamResultData result;
+                    result.isSpeech = whisper_vad_stream_is_speech(holder->context);
+                    result.events.reserve(static_cast<size_t>(nEvents));
+                    for (int index = 0; index < nEvents; ++index) {
+                        result.events.push_back({
+                            whisper_vad_stream_get_event_start(holder->context, index),
+                            whisper_vad_stream_get_event_t(holder->context, index),
+                        });
+                    }
+
+                    return [result](jsi::Runtime &rt) {
+                        return createVadStreamResultValue(rt, result);
+                    };
+                }, contextId);
+            } catch (...) {
+                holder->releaseTask();
+                throw;
+            }
+        });
+
+    auto vadStreamReset = jsi::Function::createFromHostFunction(
+        runtime,
+        jsi::PropNameID::forAscii(runtime, "whisperVadStreamReset"),
+        1,
+        [callInvoker](
+            jsi::Runtime &runtime,
+            const jsi::Value &,
+            const jsi::Value *arguments,
+            size_t count) -> jsi::Value {
+            int contextId = requireContextId(runtime, arguments, count);
+
+            auto holder = g_vadContexts.get(contextId);
+            if (!holder) {
+                throw jsi::JSError(runtime, "VAD context not found");
+            }
+
+            holder->retainTask();
+            try {
+                return createPromiseTask(runtime, callInvoker, [holder]() -> PromiseResultGenerator {
+                    PromiseScopeGuard taskGuard([holder]() { holder->releaseTask(); });
+
+                    whisper_vad_stream_reset(holder->context);
+
+                    return [](jsi::Runtime &) {
+                        return jsi::Value::undefined();
+                    };
+                }, contextId);
+            } catch (...) {
+                holder->releaseTask();
+                throw;
+            }
+        });
+
     auto toggleNativeLog = jsi::Function::createFromHostFunction(
         runtime,
         jsi::PropNameID::forAscii(runtime, "whisperToggleNativeLog"),
@@ -2200,13 +2710,17 @@ void installJSIBindings(
     runtime.global().setProperty(runtime, "whisperReleaseAllContexts", std::move(releaseAllContexts));
     runtime.global().setProperty(runtime, "whisperTranscribeFile", std::move(transcribeFile));
     runtime.global().setProperty(runtime, "whisperTranscribeData", std::move(transcribeData));
+    runtime.global().setProperty(runtime, "whisperTranscribeBatch", std::move(transcribeBatch));
     runtime.global().setProperty(runtime, "whisperAbortTranscribe", std::move(abortTranscribe));
+    runtime.global().setProperty(runtime, "whisperTrimMemory", std::move(trimMemory));
     runtime.global().setProperty(runtime, "whisperBench", std::move(bench));
     runtime.global().setProperty(runtime, "whisperInitVadContext", std::move(initVadContext));
     runtime.global().setProperty(runtime, "whisperReleaseVadContext", std::move(releaseVadContext));
     runtime.global().setProperty(runtime, "whisperReleaseAllVadContexts", std::move(releaseAllVadContexts));
     runtime.global().setProperty(runtime, "whisperVadDetectSpeech", std::move(vadDetectSpeech));
     runtime.global().setProperty(runtime, "whisperVadDetectSpeechFile", std::move(vadDetectSpeechFile));
+    runtime.global().setProperty(runtime, "whisperVadStreamPush", std::move(vadStreamPush));
+    runtime.global().setProperty(runtime, "whisperVadStreamReset", std::move(vadStreamReset));
     runtime.global().setProperty(runtime, "whisperToggleNativeLog", std::move(toggleNativeLog));
 }
 
@@ -35,6 +35,9 @@ struct WhisperContextInitOptions {
     bool useGpu = true;
     bool useCoreMLIos = true;
     bool downloadCoreMLAssets = false;
+    size_t kvCrossCacheSize = 0;
+    wsp_ggml_type kvCacheType = WSP_GGML_TYPE_F16;
+    bool useCpuRepack = true;
     std::vector<CoreMLAssetInfo> coreMLAssets;
 };
 
@@ -1,10 +1,19 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 #include "rn-whisper.h"
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define DEFAULT_MAX_AUDIO_SEC 30;
 
 namespace rnwhisper {
@@ -30,7 +39,20 @@ const char * system_info(void) {
   return s.c_str();
 }
 
-std::string bench(struct whisper_context * ctx, int n_threads) {
+static std::string json_escape(const std::string & s) {
+    std::string out;
+    for (const char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            default:   out += c;
+        }
+    }
+    return out;
+}
+
+std::string bench(struct whisper_context * ctx, int n_threads, bool dtw) {
     const int n_mels = whisper_model_n_mels(ctx);
 
     if (int ret = whisper_set_mel(ctx, nullptr, 0, n_mels)) {
@@ -84,13 +106,55 @@ std::string bench(struct whisper_context * ctx, int n_threads) {
 
     const struct whisper_timings * timings = whisper_get_timings(ctx);
 
-    return std::string("[") +
+    std::string result = std::string("[") +
         "\"" + system_info() + "\"," +
         std::to_string(n_threads) + "," +
         std::to_string(timings->encode_ms) + "," +
         std::to_string(timings->decode_ms) + "," +
         std::to_string(timings->batchd_ms) + "," +
-        std::to_string(timings->prompt_ms) + "]";
+        std::to_string(timings->prompt_ms);
+
+    if (dtw) {
+        const int n_threads_dtw = n_threads > 0 ? n_threads : std::min(4, (int) std::thread::hardware_concurrency());
+        result += ",\"" + json_escape(whisper_bench_dtw_str(ctx, n_threads_dtw)) + "\"";
+    }
+
+    return result + "]";
+}
+
+void pcm16_to_f32(const void * src, size_t n_samples, float * dst) {
+    const uint8_t * bytes = static_cast<const uint8_t *>(src);
+    size_t i = 0;
+
+    // division (not a multiplication by the reciprocal) keeps the result identical to the scalar path
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t scale = vdupq_n_f32(32767.0f);
+    const float32x4_t lower = vdupq_n_f32(-1.0f);
+    for (; i + 8 <= n_samples; i += 8) {
+        const int16x8_t s = vreinterpretq_s16_u8(vld1q_u8(bytes + i * sizeof(int16_t)));
+        const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+        const float32x4_t hi = vcvtq_f32_s32(vmovl_high_s16(s));
+        vst1q_f32(dst + i,     vmaxq_f32(vdivq_f32(lo, scale), lower));
+        vst1q_f32(dst + i + 4, vmaxq_f32(vdivq_f32(hi, scale), lower));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    const __m128 lower = _mm_set1_ps(-1.0f);
+    for (; i + 8 <= n_samples; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i * sizeof(int16_t)));
+        // sign-extend by placing each sample in the upper half of a 32-bit lane
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(dst + i,     _mm_max_ps(_mm_div_ps(_mm_cvtepi32_ps(lo), scale), lower));
+        _mm_storeu_ps(dst + i + 4, _mm_max_ps(_mm_div_ps(_mm_cvtepi32_ps(hi), scale), lower));
+    }
+#endif
+
+    for (; i < n_samples; ++i) {
+        int16_t sample = 0;
+        std::memcpy(&sample, bytes + i * sizeof(int16_t), sizeof(int16_t));
+        dst[i] = std::max(-1.0f, std::min(1.0f, static_cast<float>(sample) / 32767.0f));
+    }
 }
 
 bool job::is_aborted() {
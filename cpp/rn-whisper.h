@@ -8,7 +8,11 @@
 
 namespace rnwhisper {
 
-std::string bench(whisper_context * ctx, int n_threads);
+// with dtw, the report of whisper_bench_dtw_str() is appended to the result
+std::string bench(whisper_context * ctx, int n_threads, bool dtw = false);
+
+// convert little-endian 16-bit PCM to float samples in [-1, 1], src does not need to be aligned
+void pcm16_to_f32(const void * src, size_t n_samples, float * dst);
 
 struct vad_params {
     bool use_vad = false;
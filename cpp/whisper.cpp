@@ -5,6 +5,7 @@
 #include "ggml-cpp.h"
 #include "ggml-alloc.h"
 #include "ggml-backend.h"
+#include "ggml-cpu.h"
 
 #ifdef WHISPER_USE_COREML
 #include "coreml/whisper-encoder.h"
@@ -21,12 +22,16 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 #include <climits>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <functional>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <regex>
 #include <set>
@@ -34,10 +39,30 @@
 #include <thread>
 #include <vector>
 
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #ifdef _MSC_VER
 #include <codecvt>
 #endif
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(WHISPER_BIG_ENDIAN)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(_POSIX_MAPPED_FILES)
+#define WHISPER_USE_MMAP
+#endif
+#endif
+
 #if defined(WHISPER_BIG_ENDIAN)
 template<typename T>
 static T byteswap(T value) {
@@ -146,6 +171,9 @@ static constexpr float WHISPER_HISTORY_CONDITIONING_TEMP_CUTOFF = 0.5f;
 
 #define WHISPER_MAX_NODES 4096
 
+// number of VAD windows evaluated per graph, the LSTM steps of the batch are unrolled in the graph
+#define WHISPER_VAD_MAX_BATCH 64
+
 static std::string format(const char * fmt, ...) {
     va_list ap;
     va_list ap2;
@@ -187,12 +215,183 @@ static bool wsp_ggml_graph_compute_helper(
     return wsp_ggml_backend_graph_compute(backend.get(), graph) == WSP_GGML_STATUS_SUCCESS;
 }
 
+// persistent CPU threadpool for the graph evaluations of a state
+// without it, the CPU backend creates and joins n_threads - 1 threads for every graph it computes
+struct whisper_cpu_threadpool {
+    wsp_ggml_threadpool_t tp = nullptr;
+    int n_threads = 0;
+
+    whisper_cpu_threadpool() = default;
+    whisper_cpu_threadpool(const whisper_cpu_threadpool &) = delete;
+    whisper_cpu_threadpool & operator=(const whisper_cpu_threadpool &) = delete;
+
+    ~whisper_cpu_threadpool() {
+        if (tp) {
+            wsp_ggml_threadpool_free(tp);
+        }
+    }
+};
+
+// set the threadpool of the CPU backends, (re)creating it if it has less than n_threads threads
+static void whisper_cpu_threadpool_attach(whisper_cpu_threadpool & pool, wsp_ggml_backend_t * backends, int n_backends, int n_threads) {
+    if (pool.tp == nullptr || pool.n_threads < n_threads) {
+        for (int i = 0; i < n_backends; ++i) {
+            if (wsp_ggml_backend_is_cpu(backends[i])) {
+                wsp_ggml_backend_cpu_set_threadpool(backends[i], nullptr);
+            }
+        }
+
+        if (pool.tp) {
+            wsp_ggml_threadpool_free(pool.tp);
+        }
+
+        struct wsp_ggml_threadpool_params tpp = wsp_ggml_threadpool_params_default(n_threads);
+
+        pool.tp        = wsp_ggml_threadpool_new(&tpp);
+        pool.n_threads = n_threads;
+    }
+
+    for (int i = 0; i < n_backends; ++i) {
+        if (wsp_ggml_backend_is_cpu(backends[i])) {
+            wsp_ggml_backend_cpu_set_threadpool(backends[i], pool.tp);
+        }
+    }
+}
+
+// persistent worker threads for the work done outside of ggml graphs (mel spectrogram, parallel processors, sampling)
+// the calling thread always takes part as worker 0
+// during decoding the runs come every few hundred microseconds, so the threads spin for a short while before parking
+struct whisper_worker_pool {
+    std::mutex mutex_run; // one run() at a time
+
+    std::mutex              mutex;
+    std::condition_variable cv_work;
+    std::condition_variable cv_done;
+
+    std::vector<std::thread> threads;
+
+    const std::function<void(int, int)> * work = nullptr;
+
+    // written under mutex, read without it while spinning
+    int                   n_work    = 0; // number of workers taking part in the current run, including the caller
+    std::atomic<int>      n_pending { 0 }; // number of pool threads that have not finished the current run yet
+    std::atomic<uint64_t> n_runs    { 0 };
+    std::atomic<bool>     stop      { false };
+
+    // no spinning on a single core, the thread we wait for would not be able to run
+    const int n_spin = std::thread::hardware_concurrency() > 1 ? 1024 : 0;
+
+    whisper_worker_pool() = default;
+    whisper_worker_pool(const whisper_worker_pool &) = delete;
+    whisper_worker_pool & operator=(const whisper_worker_pool &) = delete;
+
+    ~whisper_worker_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv_work.notify_all();
+
+        for (auto & t : threads) {
+            t.join();
+        }
+    }
+
+    // spin until pred() is true or n_spin yields have passed
+    template <typename Pred>
+    void spin(Pred pred) const {
+        for (int i = 0; i < n_spin && !pred(); ++i) {
+            std::this_thread::yield();
+        }
+    }
+
+    void worker(int ith) {
+        uint64_t n_seen = 0;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (!stop && n_runs == n_seen) {
+                lock.unlock();
+                spin([&] { return stop || n_runs != n_seen; });
+                lock.lock();
+            }
+            cv_work.wait(lock, [&] { return stop || n_runs != n_seen; });
+            if (stop) {
+                return;
+            }
+            n_seen = n_runs;
+
+            if (ith >= n_work) {
+                continue;
+            }
+
+            const auto * fn  = work;
+            const int    nth = n_work;
+
+            lock.unlock();
+            (*fn)(ith, nth);
+            lock.lock();
+
+            if (--n_pending == 0) {
+                cv_done.notify_one();
+            }
+        }
+    }
+
+    // call fn(ith, n_threads) for ith in [0, n_threads) in parallel and wait for all of them to finish
+    void run(int n_threads, const std::function<void(int, int)> & fn) {
+        if (n_threads <= 1) {
+            fn(0, 1);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock_run(mutex_run, std::try_to_lock);
+        if (!lock_run.owns_lock()) {
+            // the pool is busy with another caller - fall back to temporary threads
+            std::vector<std::thread> workers(n_threads - 1);
+            for (int iw = 0; iw < n_threads - 1; ++iw) {
+                workers[iw] = std::thread(fn, iw + 1, n_threads);
+            }
+            fn(0, n_threads);
+            for (int iw = 0; iw < n_threads - 1; ++iw) {
+                workers[iw].join();
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            while ((int) threads.size() < n_threads - 1) {
+                threads.emplace_back(&whisper_worker_pool::worker, this, (int) threads.size() + 1);
+            }
+
+            work      = &fn;
+            n_work    = n_threads;
+            n_pending = n_threads - 1;
+            n_runs++;
+        }
+        cv_work.notify_all();
+
+        fn(0, n_threads);
+
+        spin([&] { return n_pending == 0; });
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cv_done.wait(lock, [&] { return n_pending == 0; });
+        work = nullptr;
+    }
+};
+
 static bool wsp_ggml_graph_compute_helper(
       wsp_ggml_backend_sched_t   sched,
         struct wsp_ggml_cgraph * graph,
                        int   n_threads,
+    whisper_cpu_threadpool & threadpool,
                       bool   sched_reset = true) {
-    for (int i = 0; i < wsp_ggml_backend_sched_get_n_backends(sched); ++i) {
+    std::vector<wsp_ggml_backend_t> backends(wsp_ggml_backend_sched_get_n_backends(sched));
+
+    for (int i = 0; i < (int) backends.size(); ++i) {
         wsp_ggml_backend_t backend = wsp_ggml_backend_sched_get_backend(sched, i);
         wsp_ggml_backend_dev_t dev = wsp_ggml_backend_get_device(backend);
         wsp_ggml_backend_reg_t reg = dev ? wsp_ggml_backend_dev_backend_reg(dev) : nullptr;
@@ -201,8 +400,12 @@ static bool wsp_ggml_graph_compute_helper(
         if (fn_set_n_threads) {
             fn_set_n_threads(backend, n_threads);
         }
+
+        backends[i] = backend;
     }
 
+    whisper_cpu_threadpool_attach(threadpool, backends.data(), (int) backends.size(), n_threads);
+
     const bool t = (wsp_ggml_backend_sched_graph_compute(sched, graph) == WSP_GGML_STATUS_SUCCESS);
 
     if (!t || sched_reset) {
@@ -214,50 +417,12 @@ static bool wsp_ggml_graph_compute_helper(
 
 // TODO: move these functions to ggml-base with support for ggml-backend?
 
-static wsp_ggml_tensor * whisper_set_f32(struct wsp_ggml_tensor * t, float v) {
-    WSP_GGML_ASSERT(t->type == WSP_GGML_TYPE_F32);
-    WSP_GGML_ASSERT(wsp_ggml_is_contiguous(t));
-    size_t nels = wsp_ggml_nelements(t);
-    for (size_t i = 0; i < nels; ++i) {
-        ((float *) t->data)[i] = v;
-    }
-    return t;
-}
-
-static wsp_ggml_tensor * whisper_set_i32(struct wsp_ggml_tensor * t, int32_t v) {
-    WSP_GGML_ASSERT(t->type == WSP_GGML_TYPE_I32);
-    WSP_GGML_ASSERT(wsp_ggml_is_contiguous(t));
-    size_t nels = wsp_ggml_nelements(t);
-    for (size_t i = 0; i < nels; ++i) {
-        ((int32_t *) t->data)[i] = v;
-    }
-    return t;
-}
-
-static float whisper_get_f32_nd(const struct wsp_ggml_tensor * t, int64_t i0, int64_t i1, int64_t i2, int64_t i3) {
-    WSP_GGML_ASSERT(t->type == WSP_GGML_TYPE_F32);
-    void * data = (char *) t->data + i0*t->nb[0] + i1*t->nb[1] + i2*t->nb[2] + i3*t->nb[3];
-    return *(float *) data;
-}
-
-static void whisper_set_f32_nd(struct wsp_ggml_tensor * t, int64_t i0, int64_t i1, int64_t i2, int64_t i3, float v) {
-    WSP_GGML_ASSERT(t->type == WSP_GGML_TYPE_F32);
-    void * data = (char *) t->data + i0*t->nb[0] + i1*t->nb[1] + i2*t->nb[2] + i3*t->nb[3];
-    *(float *) data = v;
-}
-
 static int32_t whisper_get_i32_nd(const struct wsp_ggml_tensor * t, int64_t i0, int64_t i1, int64_t i2, int64_t i3) {
     WSP_GGML_ASSERT(t->type == WSP_GGML_TYPE_I32);
     void * data = (char *) t->data + i0*t->nb[0] + i1*t->nb[1] + i2*t->nb[2] + i3*t->nb[3];
     return *(int32_t *) data;
 }
 
-static void whisper_set_i32_nd(struct wsp_ggml_tensor * t, int64_t i0, int64_t i1, int64_t i2, int64_t i3, int32_t v) {
-    WSP_GGML_ASSERT(t->type == WSP_GGML_TYPE_I32);
-    void * data = (char *) t->data + i0*t->nb[0] + i1*t->nb[1] + i2*t->nb[2] + i3*t->nb[3];
-    *(int32_t *) data = v;
-}
-
 // available whisper models
 enum e_model {
     MODEL_UNKNOWN,
@@ -419,6 +584,31 @@ struct whisper_mel {
     std::vector<float> data;
 };
 
+// incrementally computed log mel spectrogram, see whisper_mel_stream_push_with_state()
+// frames are kept un-normalized and frame-major so that new audio only appends to them
+// the clamping and normalization is applied per encoder window in whisper_encode_internal()
+struct whisper_mel_stream {
+    bool active = false;
+
+    int64_t n_samples = 0; // number of samples pushed so far
+
+    // reflect-padded signal, starting at position pcm_offset of the padded audio
+    // only the part that is still needed by the frames that are not complete yet is kept
+    // until the first WHISPER_N_FFT/2 + 1 samples arrive, the raw samples are stored instead
+    std::vector<float> pcm;
+    int64_t pcm_offset = 0;
+
+    // [n_frames - n_dropped][n_mel] frames that will not change anymore
+    // only the last encoder window of them is kept, the frames before n_dropped have been discarded
+    std::vector<float> frames;
+    int n_frames  = 0;
+    int n_dropped = 0;
+
+    // [n_tail][n_mel] frames that overlap the end of the audio, computed as if the audio was followed by silence
+    std::vector<float> tail;
+    int n_tail = 0;
+};
+
 struct whisper_filters {
     int32_t n_mel;
     int32_t n_fft;
@@ -467,6 +657,8 @@ struct whisper_segment {
     std::vector<whisper_token_data> tokens;
 
     bool speaker_turn_next;
+
+    int clip = 0; // index of the clip in whisper_full_batch()
 };
 
 struct whisper_batch {
@@ -534,13 +726,82 @@ struct whisper_pair {
     whisper_pair() : first(A()), second(B()) {}
 };
 
+// the shape parameters of a graph
+// a graph built for the same key can be evaluated again by only setting its inputs
+struct whisper_graph_key {
+    int32_t n_tokens    = 0;
+    int32_t n_kv        = 0;
+    int32_t n_audio_ctx = 0;
+    int32_t n_clips     = 1;
+    bool    aheads      = false;
+
+    bool operator==(const whisper_graph_key & other) const {
+        return n_tokens    == other.n_tokens    &&
+               n_kv        == other.n_kv        &&
+               n_audio_ctx == other.n_audio_ctx &&
+               n_clips     == other.n_clips     &&
+               aheads      == other.aheads;
+    }
+};
+
 // wsp_ggml_backend_sched wrapper for whisper usage
 struct whisper_sched {
     wsp_ggml_backend_sched_t sched = nullptr;
 
     std::vector<uint8_t> meta;
+
+    // the last graph built in meta, it stays allocated in sched until the shape changes
+    wsp_ggml_cgraph * gf = nullptr;
+    whisper_graph_key gf_key;
 };
 
+// drop the cached graph, e.g. when a tensor it references is recreated
+static void whisper_sched_reset(struct whisper_sched & allocr) {
+    wsp_ggml_backend_sched_reset(allocr.sched);
+    allocr.gf = nullptr;
+}
+
+// the graph for the given shape - it is built and allocated only if the shape differs from the one of the cached graph
+// built is set to true if a new graph was built, the graphs that reference its tensors must then be rebuilt too
+template <typename F>
+static wsp_ggml_cgraph * whisper_sched_graph(struct whisper_sched & allocr, const whisper_graph_key & key, F && build, bool * built = nullptr) {
+    if (built) {
+        *built = false;
+    }
+
+    if (allocr.gf != nullptr && allocr.gf_key == key) {
+        return allocr.gf;
+    }
+
+    whisper_sched_reset(allocr);
+
+    wsp_ggml_cgraph * gf = build();
+
+    if (!wsp_ggml_backend_sched_alloc_graph(allocr.sched, gf)) {
+        return nullptr;
+    }
+
+    allocr.gf     = gf;
+    allocr.gf_key = key;
+
+    if (built) {
+        *built = true;
+    }
+
+    return gf;
+}
+
+// evaluate the graph returned by whisper_sched_graph(), keeping it allocated for the next call
+static bool whisper_sched_compute(struct whisper_sched & allocr, wsp_ggml_cgraph * gf, int n_threads, whisper_cpu_threadpool & threadpool) {
+    if (!wsp_ggml_graph_compute_helper(allocr.sched, gf, n_threads, threadpool, false)) {
+        // the scheduler has been reset
+        allocr.gf = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
 static size_t whisper_sched_size(struct whisper_sched & allocr) {
     size_t size = allocr.meta.size();
     for (int i = 0; i < wsp_ggml_backend_sched_get_n_backends(allocr.sched); ++i) {
@@ -689,15 +950,14 @@ struct whisper_layer_decoder {
     struct wsp_ggml_tensor * mlp_1_b;
 };
 
-struct whisper_kv_cell {
-    whisper_pos pos = -1;
+// the sequence ids are below 2*WHISPER_MAX_DECODERS, so the sequences of a KV cell fit in a bit mask
+typedef uint32_t whisper_seq_mask;
 
-    std::set<whisper_seq_id> seq_id;
+static_assert(2*WHISPER_MAX_DECODERS <= 8*sizeof(whisper_seq_mask), "whisper_seq_mask is too small for 2*WHISPER_MAX_DECODERS sequences");
 
-    bool has_seq_id(const whisper_seq_id & id) const {
-        return seq_id.find(id) != seq_id.end();
-    }
-};
+static inline whisper_seq_mask whisper_seq_bit(whisper_seq_id seq_id) {
+    return whisper_seq_mask(1) << seq_id;
+}
 
 struct whisper_kv_cache {
     uint32_t head = 0;
@@ -706,7 +966,9 @@ struct whisper_kv_cache {
     // computed before each graph build
     uint32_t n = 0;
 
-    std::vector<whisper_kv_cell> cells;
+    // cell metadata, stored as separate arrays so that the per-sequence operations are simple loops over words
+    std::vector<whisper_pos>      cells_pos; // -1 if the cell is free
+    std::vector<whisper_seq_mask> cells_seq; // bit i is set if the cell belongs to sequence i
 
     struct wsp_ggml_tensor * k;
     struct wsp_ggml_tensor * v;
@@ -716,6 +978,102 @@ struct whisper_kv_cache {
     std::vector<uint8_t> ctx_buf;
 };
 
+// a cross-attention KV computed by the encoder, together with the mel window it was computed from
+struct whisper_kv_cross_entry {
+    uint64_t hash = 0;
+
+    std::vector<float>   mel; // compared on a hash match, so a collision can never return the wrong KV
+    std::vector<uint8_t> k;
+    std::vector<uint8_t> v;
+
+    size_t nbytes() const {
+        return mel.size()*sizeof(float) + k.size() + v.size();
+    }
+};
+
+// LRU cache of the cross-attention KV, keyed by a hash of the encoder input
+// the realtime transcription re-submits growing slices of the same audio, so the same 30 s windows are encoded over and over
+struct whisper_kv_cross_cache {
+    std::list<whisper_kv_cross_entry> entries; // most recently used first
+
+    size_t size = 0; // bytes used by the entries
+};
+
+// read-only mapping of a model file
+// the CPU weights point directly into the mapped pages, so the OS shares them between all the contexts
+// loaded from the same file and only reads them from storage when they are first used
+struct whisper_mmap {
+    void * addr = nullptr;
+    size_t size = 0;
+
+    // read position of the loader
+    size_t pos = 0;
+
+    // CPU buffer wrapping the mapping, owned by whisper_model::buffers
+    wsp_ggml_backend_buffer_t buffer = nullptr;
+
+    whisper_mmap() = default;
+    whisper_mmap(const whisper_mmap &) = delete;
+    whisper_mmap & operator=(const whisper_mmap &) = delete;
+
+    ~whisper_mmap() {
+#ifdef WHISPER_USE_MMAP
+        if (addr) {
+            munmap(addr, size);
+        }
+#endif
+    }
+};
+
+static std::shared_ptr<whisper_mmap> whisper_mmap_init(const char * path_model) {
+#ifdef WHISPER_USE_MMAP
+    const int fd = open(path_model, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    void * addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    auto mapping = std::make_shared<whisper_mmap>();
+    mapping->addr = addr;
+    mapping->size = st.st_size;
+
+    return mapping;
+#else
+    WSP_GGML_UNUSED(path_model);
+    return nullptr;
+#endif
+}
+
+// owns the backend data of a loaded model
+// it is shared by the contexts created with whisper_init_from_context() and freed with the last of them
+struct whisper_model_weights {
+    std::vector<wsp_ggml_context *>        ctxs;
+    std::vector<wsp_ggml_backend_buffer_t> buffers;
+    std::shared_ptr<whisper_mmap>          mapping;
+
+    ~whisper_model_weights() {
+        for (wsp_ggml_context * context : ctxs) {
+            wsp_ggml_free(context);
+        }
+
+        for (wsp_ggml_backend_buffer_t buf : buffers) {
+            wsp_ggml_backend_buffer_free(buf);
+        }
+    }
+};
+
 struct whisper_model {
     e_model type = MODEL_UNKNOWN;
 
@@ -759,6 +1117,12 @@ struct whisper_model {
     // tensors
     int n_loaded;
     std::map<std::string, struct wsp_ggml_tensor *> tensors;
+
+    // set when the model is loaded from a mapped file
+    std::shared_ptr<whisper_mmap> mapping;
+
+    // owns ctxs, buffers and mapping once the model is loaded
+    std::shared_ptr<whisper_model_weights> weights;
 };
 
 struct whisper_partial_utf8 {
@@ -767,8 +1131,9 @@ struct whisper_partial_utf8 {
 };
 
 struct whisper_grammar {
-    /*const*/ std::vector<std::vector<whisper_grammar_element>> rules;
-    std::vector<std::vector<const whisper_grammar_element *>>   stacks;
+    // the rules do not change once parsed, copies of the grammar (beam search) share them
+    std::shared_ptr<const std::vector<std::vector<whisper_grammar_element>>> rules;
+    std::vector<std::vector<const whisper_grammar_element *>>               stacks;
 
     // buffer for partially generated UTF-8 sequence from accepted tokens
     whisper_partial_utf8 partial_utf8;
@@ -791,6 +1156,10 @@ struct whisper_sequence {
     double avg_logprobs;     // the average log probability of the tokens
     double entropy;          // the entropy of the tokens
     double score;            // likelihood rank score
+
+    // [EXPERIMENTAL] Token-level timestamps with DTW
+    // for each sampled token, the row of the alignment heads buffer computed by the decode that produced its logits
+    std::vector<int32_t> aheads_rows;
 };
 
 // TAGS: WHISPER_DECODER_INIT
@@ -808,6 +1177,8 @@ struct whisper_decoder {
     bool completed; // has the decoder completed the current segment?
     bool has_ts;    // have we already sampled a non-beg timestamp token for the current segment?
 
+    int aheads_row; // [EXPERIMENTAL] the alignment heads row of the last decode, it produced the logits of the next token
+
     // new token probs, logits and logprobs after the last whisper_decode (1-dimensional array: [n_vocab])
     std::vector<float> probs;
     std::vector<float> logits;
@@ -816,6 +1187,9 @@ struct whisper_decoder {
     // work container used to avoid memory allocations
     std::vector<whisper_pair<double, whisper_vocab::id>> logits_id;
 
+    // cumulative probs for sampling at t > 0.0, built once per step and reused for all the draws
+    std::vector<double> probs_cdf;
+
     mutable std::mt19937 rng; // used for sampling at t > 0.0
 };
 
@@ -847,6 +1221,9 @@ struct whisper_state {
     int32_t n_fail_p = 0; // number of logprob threshold failures
     int32_t n_fail_h = 0; // number of entropy threshold failures
 
+    int32_t n_kv_cross_hit  = 0; // number of encoder calls served from kv_cross_cache
+    int32_t n_kv_cross_miss = 0; // number of encoder calls that were computed and stored in kv_cross_cache
+
     // number of decoders for which we have constructed the KV cache
     int32_t kv_self_n_dec = 0;
 
@@ -857,10 +1234,18 @@ struct whisper_state {
     // shared between all decoders
     whisper_kv_cache kv_cross;
 
+    // number of clips decoded together, each clip uses its own slot of kv_cross
+    // the tokens of a batch are grouped by clip, in slot order, with the same number of tokens per clip
+    int32_t n_clips = 1;
+
+    // recent kv_cross results, limited to whisper_context_params.kv_cross_cache_size bytes
+    whisper_kv_cross_cache kv_cross_cache;
+
     // padded buffer for flash-attention
     whisper_kv_cache kv_pad;
 
     whisper_mel mel;
+    whisper_mel_stream mel_stream;
 
     whisper_batch batch;
 
@@ -868,6 +1253,10 @@ struct whisper_state {
 
     std::vector<wsp_ggml_backend_t> backends;
 
+    // threads reused across calls, see whisper_cpu_threadpool and whisper_worker_pool
+    whisper_cpu_threadpool threadpool;
+    whisper_worker_pool    workers;
+
     // - stores meta info about the intermediate tensors into the `meta` buffers
     whisper_sched sched_conv;
     whisper_sched sched_encode;
@@ -880,13 +1269,23 @@ struct whisper_state {
 
     // helpers for GPU offloading
     std::vector<float> inp_mel;
+    std::vector<int32_t> inp_idxs;
     std::vector<float> inp_mask;
 
     // decode output (2-dimensional array: [n_tokens][n_vocab])
     std::vector<float> logits;
 
+    // token suppression masks built once per whisper_full_with_state() call, see whisper_suppress_init()
+    // +INFINITY keeps the logit, -INFINITY suppresses it
+    std::vector<float> suppress_special; // special tokens, applied before the logits filter callback
+    std::vector<float> suppress_text;    // suppress_regex and suppress_nst, applied after the callback
+    bool has_suppress_text = false;
+
     std::vector<whisper_segment> result_all;
 
+    // language id of each clip of the last whisper_full_batch() call
+    std::vector<int> clip_lang_ids;
+
     // prompt history split into static prefix (prompt_past0) and dynamic rolling context (prompt_past1)
     std::vector<whisper_token>   prompt_past0; // static carried initial prompt (if enabled)
     std::vector<whisper_token>   prompt_past1; // dynamic context from decoded output
@@ -914,8 +1313,14 @@ struct whisper_state {
 
     // [EXPERIMENTAL] Token-level timestamps with DTW
     whisper_aheads_masks aheads_masks;
-    wsp_ggml_tensor * aheads_cross_QKs = nullptr;
-    std::vector<float> aheads_cross_QKs_data;
+    wsp_ggml_tensor * aheads_cross_QKs = nullptr;       // [n_aheads, n_audio_ctx, n_tokens] of the last decode
+    std::vector<float> aheads_cross_QKs_data;          // the row slots of the current window, [n_audio][n_aheads] each
+    std::vector<int32_t> aheads_rows_free;             // slots no sequence refers to anymore, reused before adding new ones
+    std::vector<uint8_t> aheads_rows_used;             // work container of whisper_aheads_recycle_rows()
+    int32_t            aheads_n_rows  = 0;             // slots of the current window
+    int32_t            aheads_n_audio = 0;             // audio positions kept in a row
+    wsp_ggml_context *     dtw_ctx     = nullptr;          // scratch of the DTW, reset for every window
+    wsp_ggml_backend_t     dtw_backend = nullptr;          // CPU backend computing the DTW graph
 
     // [EXPERIMENTAL] speed-up techniques
     int32_t exp_n_audio_ctx = 0; // 0 - use default
@@ -948,6 +1353,13 @@ struct whisper_context {
 
     whisper_state * state = nullptr;
 
+    // runs the processors of whisper_full_parallel()
+    whisper_worker_pool workers;
+
+    // idle states kept alive for whisper_full_parallel(), see whisper_state_pool_reserve()
+    std::mutex                    state_pool_mutex;
+    std::vector<whisper_state *>  state_pool;
+
     std::string path_model; // populated by whisper_init_from_file_with_params()
 };
 
@@ -968,7 +1380,8 @@ static void read_safe(whisper_model_loader * loader, T & dest) {
 static bool whisper_kv_cache_init(
              struct whisper_kv_cache & cache,
                       wsp_ggml_backend_t   backend,
-                           wsp_ggml_type   wtype,
+                           wsp_ggml_type   type_k,
+                           wsp_ggml_type   type_v,
                              int64_t   n_text_state,
                              int64_t   n_text_layer,
                                  int   n_ctx) {
@@ -986,8 +1399,8 @@ static bool whisper_kv_cache_init(
     cache.head = 0;
     cache.size = n_ctx;
 
-    cache.cells.clear();
-    cache.cells.resize(n_ctx);
+    cache.cells_pos.assign(n_ctx, -1);
+    cache.cells_seq.assign(n_ctx, 0);
 
     struct wsp_ggml_context * ctx = wsp_ggml_init(params);
 
@@ -996,8 +1409,8 @@ static bool whisper_kv_cache_init(
         return false;
     }
 
-    cache.k = wsp_ggml_new_tensor_1d(ctx, wtype, n_elements);
-    cache.v = wsp_ggml_new_tensor_1d(ctx, wtype, n_elements);
+    cache.k = wsp_ggml_new_tensor_1d(ctx, type_k, n_elements);
+    cache.v = wsp_ggml_new_tensor_1d(ctx, type_v, n_elements);
 
     cache.buffer = wsp_ggml_backend_alloc_ctx_tensors(ctx, backend);
     if (!cache.buffer) {
@@ -1038,7 +1451,7 @@ static bool whisper_kv_cache_find_slot(
 
         bool found = true;
         for (uint32_t i = 0; i < n_tokens; i++) {
-            if (cache.cells[cache.head + i].pos >= 0) {
+            if (cache.cells_pos[cache.head + i] >= 0) {
                 found = false;
                 cache.head += i + 1;
                 n_tested   += i + 1;
@@ -1057,10 +1470,10 @@ static bool whisper_kv_cache_find_slot(
     }
 
     for (uint32_t i = 0; i < n_tokens; i++) {
-        cache.cells[cache.head + i].pos = batch.pos[i];
+        cache.cells_pos[cache.head + i] = batch.pos[i];
 
         for (int32_t j = 0; j < batch.n_seq_id[i]; j++) {
-            cache.cells[cache.head + i].seq_id.insert(batch.seq_id[i][j]);
+            cache.cells_seq[cache.head + i] |= whisper_seq_bit(batch.seq_id[i][j]);
         }
     }
 
@@ -1070,7 +1483,7 @@ static bool whisper_kv_cache_find_slot(
 // find how many cells are currently in use
 static int32_t whisper_kv_cache_cell_max(const struct whisper_kv_cache & cache) {
     for (uint32_t i = cache.size - 1; i > 0; --i) {
-        if (cache.cells[i].pos >= 0 && !cache.cells[i].seq_id.empty()) {
+        if (cache.cells_pos[i] >= 0 && cache.cells_seq[i] != 0) {
             return i + 1;
         }
     }
@@ -1079,10 +1492,8 @@ static int32_t whisper_kv_cache_cell_max(const struct whisper_kv_cache & cache)
 }
 
 static void whisper_kv_cache_clear(struct whisper_kv_cache & cache) {
-    for (int32_t i = 0; i < (int32_t) cache.size; ++i) {
-        cache.cells[i].pos = -1;
-        cache.cells[i].seq_id.clear();
-    }
+    std::fill(cache.cells_pos.begin(), cache.cells_pos.end(), -1);
+    std::fill(cache.cells_seq.begin(), cache.cells_seq.end(), 0);
     cache.head = 0;
 
     wsp_ggml_backend_buffer_clear(cache.buffer, 0);
@@ -1098,17 +1509,16 @@ static void whisper_kv_cache_seq_rm(
     if (p0 < 0) p0 = 0;
     if (p1 < 0) p1 = std::numeric_limits<whisper_pos>::max();
 
+    const whisper_seq_mask mask = seq_id < 0 ? ~whisper_seq_mask(0) : whisper_seq_bit(seq_id);
+
     for (uint32_t i = 0; i < cache.size; ++i) {
-        if (cache.cells[i].pos >= p0 && cache.cells[i].pos < p1) {
-            if (seq_id < 0) {
-                cache.cells[i].seq_id.clear();
-            } else if (cache.cells[i].has_seq_id(seq_id)) {
-                cache.cells[i].seq_id.erase(seq_id);
-            } else {
+        if (cache.cells_pos[i] >= p0 && cache.cells_pos[i] < p1) {
+            if (seq_id >= 0 && !(cache.cells_seq[i] & mask)) {
                 continue;
             }
-            if (cache.cells[i].seq_id.empty()) {
-                cache.cells[i].pos = -1;
+            cache.cells_seq[i] &= ~mask;
+            if (cache.cells_seq[i] == 0) {
+                cache.cells_pos[i] = -1;
                 if (new_head == cache.size) new_head = i;
             }
         }
@@ -1129,16 +1539,50 @@ static void whisper_kv_cache_seq_cp(
 
     cache.head = 0;
 
+    const whisper_seq_mask src = whisper_seq_bit(seq_id_src);
+    const whisper_seq_mask dst = whisper_seq_bit(seq_id_dst);
+
+    for (uint32_t i = 0; i < cache.size; ++i) {
+        if ((cache.cells_seq[i] & src) && cache.cells_pos[i] >= p0 && cache.cells_pos[i] < p1) {
+            cache.cells_seq[i] |= dst;
+        }
+    }
+}
+
+// reassign the sequences [0, n_seq) in one pass: sequence j becomes a copy of sequence seq_src[j]
+// equivalent to copying every source to a scratch sequence, removing the targets and copying back,
+// which is what the beam search needs after selecting the candidates
+static void whisper_kv_cache_seq_remap(
+        struct whisper_kv_cache & cache,
+           const whisper_seq_id * seq_src,
+                        int32_t   n_seq) {
+    const whisper_seq_mask keep = n_seq < (int32_t) (8*sizeof(whisper_seq_mask)) ? ~(whisper_seq_bit(n_seq) - 1) : 0;
+
+    cache.head = 0;
+
     for (uint32_t i = 0; i < cache.size; ++i) {
-        if (cache.cells[i].has_seq_id(seq_id_src) && cache.cells[i].pos >= p0 && cache.cells[i].pos < p1) {
-            cache.cells[i].seq_id.insert(seq_id_dst);
+        const whisper_seq_mask cur = cache.cells_seq[i];
+        if (cur == 0) {
+            continue;
+        }
+
+        whisper_seq_mask res = cur & keep;
+        for (int32_t j = 0; j < n_seq; ++j) {
+            res |= ((cur >> seq_src[j]) & 1u) << j;
+        }
+
+        cache.cells_seq[i] = res;
+        if (res == 0) {
+            cache.cells_pos[i] = -1;
         }
     }
 }
 
+// the number of KV cells attended by the decoder is a multiple of the padding
+// on the CPU it is only used to bucket the decoder graph shapes, so that a graph is reused for several tokens
 static uint32_t whisper_kv_cache_get_padding(const struct whisper_context & wctx) {
     if (!wctx.params.flash_attn || !wctx.params.use_gpu) {
-        return 1u;
+        return 32u;
     }
 
 #ifdef WSP_GGML_USE_METAL
@@ -1153,7 +1597,7 @@ static uint32_t whisper_kv_cache_get_padding(const struct whisper_context & wctx
     }
 #endif
 
-    return 1u;
+    return 32u;
 }
 
 // [EXPERIMENTAL] Token-level timestamps with DTW
@@ -1287,6 +1731,20 @@ static size_t aheads_masks_nbytes(struct whisper_aheads_masks & aheads_masks) {
     return size;
 }
 
+// the memory of whisper_exp_compute_token_level_timestamps_dtw() for n_tokens rows and n_audio audio positions
+static size_t whisper_dtw_mem_size(int n_tokens, int n_audio, int n_heads) {
+    const size_t n_w    = (size_t) n_tokens*n_audio*n_heads;
+    const size_t n_diag = (size_t) (n_tokens + 1)*(n_tokens + n_audio + 1);
+
+    return 2*n_w*sizeof(float)                             // the rows and the median filter output
+        + (size_t) n_tokens*n_audio*sizeof(float)           // the mean over the heads
+        + n_diag*(sizeof(float) + sizeof(int8_t))           // the skewed input and the trace of dtw_and_backtrace()
+        + 3*(n_tokens + 1)*sizeof(float)                    // the cost diagonals
+        + 4*(size_t) (n_tokens + n_audio)*sizeof(int32_t)   // the backtrace and the alignment
+        + 16*(wsp_ggml_tensor_overhead() + WSP_GGML_MEM_ALIGN)
+        + wsp_ggml_graph_overhead();
+}
+
 static wsp_ggml_backend_t whisper_backend_init_gpu(const whisper_context_params & params) {
     wsp_ggml_log_set(g_state.log_callback, g_state.log_callback_user_data);
 
@@ -1389,7 +1847,7 @@ static buft_list_t make_buft_list(whisper_context_params & params) {
     auto * cpu_reg = wsp_ggml_backend_dev_backend_reg(cpu_dev);
     auto get_extra_bufts_fn = (wsp_ggml_backend_dev_get_extra_bufts_t)
         wsp_ggml_backend_reg_get_proc_address(cpu_reg, "wsp_ggml_backend_dev_get_extra_bufts");
-    if (get_extra_bufts_fn) {
+    if (get_extra_bufts_fn && params.use_extra_bufts) {
         wsp_ggml_backend_buffer_type_t * extra_bufts = get_extra_bufts_fn(cpu_dev);
         while (extra_bufts && *extra_bufts) {
             buft_list.emplace_back(cpu_dev, *extra_bufts);
@@ -1845,6 +2303,89 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
         wsp_ggml_free(ctx);
     }
 
+    // point the CPU weights directly into the mapped model file instead of copying them
+    // the tensor data is not padded in the file, so only the tensors that are suitably aligned can be mapped
+    if (model.mapping) {
+        auto & mapping = *model.mapping;
+
+        std::set<wsp_ggml_tensor *> cpu_tensors;
+        for (auto & p : ctx_map) {
+            if (p.first != wsp_ggml_backend_cpu_buffer_type()) {
+                continue;
+            }
+            for (wsp_ggml_tensor * t = wsp_ggml_get_first_tensor(p.second); t != nullptr; t = wsp_ggml_get_next_tensor(p.second, t)) {
+                cpu_tensors.insert(t);
+            }
+        }
+
+        int    n_mapped    = 0;
+        size_t size_mapped = 0;
+
+        // walk the tensor headers without moving the read position of the loader
+        const char * data = (const char *) mapping.addr;
+        size_t offs = mapping.pos;
+
+        while (!cpu_tensors.empty() && offs + 3*sizeof(int32_t) <= mapping.size) {
+            int32_t hdr[3]; // n_dims, length, ttype
+            memcpy(hdr, data + offs, sizeof(hdr));
+            offs += sizeof(hdr);
+
+            const int32_t n_dims = hdr[0];
+            const int32_t length = hdr[1];
+            const int32_t ttype  = hdr[2];
+
+            if (n_dims < 0 || n_dims > 4 || length < 0 || ttype < 0 || ttype >= WSP_GGML_TYPE_COUNT ||
+                offs + n_dims*sizeof(int32_t) + length > mapping.size) {
+                break;
+            }
+
+            int64_t nelements = 1;
+            for (int i = 0; i < n_dims; ++i) {
+                int32_t ne;
+                memcpy(&ne, data + offs + i*sizeof(int32_t), sizeof(ne));
+                nelements *= ne;
+            }
+            offs += n_dims*sizeof(int32_t);
+
+            const std::string name(data + offs, length);
+            offs += length;
+
+            if (wsp_ggml_blck_size(wsp_ggml_type(ttype)) == 0 || nelements < 0) {
+                break;
+            }
+
+            const size_t nbytes = nelements*wsp_ggml_type_size(wsp_ggml_type(ttype))/wsp_ggml_blck_size(wsp_ggml_type(ttype));
+            if (offs + nbytes > mapping.size) {
+                break;
+            }
+
+            // F32 data needs 4-byte alignment, F16 and the quantized blocks (fp16 scales) 2-byte alignment
+            const size_t align = wsp_ggml_type_size(wsp_ggml_type(ttype)) % 4 == 0 ? 4 : 2;
+
+            auto it = model.tensors.find(name);
+            if (it != model.tensors.end() && offs % align == 0) {
+                wsp_ggml_tensor * tensor = it->second;
+                if (cpu_tensors.count(tensor) && tensor->type == ttype && wsp_ggml_nbytes(tensor) == nbytes) {
+                    if (!mapping.buffer) {
+                        mapping.buffer = wsp_ggml_backend_cpu_buffer_from_ptr(mapping.addr, mapping.size);
+                        model.buffers.emplace_back(mapping.buffer);
+                    }
+
+                    if (wsp_ggml_backend_tensor_alloc(mapping.buffer, tensor, (char *) mapping.addr + offs) == WSP_GGML_STATUS_SUCCESS) {
+                        n_mapped++;
+                        size_mapped += nbytes;
+                    }
+
+                    cpu_tensors.erase(tensor);
+                }
+            }
+
+            offs += nbytes;
+        }
+
+        WHISPER_LOG_INFO("%s: %12s mapped %d tensors (%.2f MB)\n", __func__, "CPU_Mapped", n_mapped, size_mapped / 1e6);
+    }
+
     // allocate tensors in the backend buffers
     for (auto & p : ctx_map) {
         wsp_ggml_backend_buffer_type_t buft = p.first;
@@ -1919,7 +2460,10 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
                 return false;
             }
 
-            if (wsp_ggml_backend_buffer_is_host(tensor->buffer)) {
+            if (model.mapping && model.mapping->buffer && tensor->buffer == model.mapping->buffer) {
+                // the tensor points into the mapped file, skip its data
+                model.mapping->pos += wsp_ggml_nbytes(tensor);
+            } else if (wsp_ggml_backend_buffer_is_host(tensor->buffer)) {
                 // for the CPU and Metal backend, we can read directly into the tensor
                 loader->read(loader->context, tensor->data, wsp_ggml_nbytes(tensor));
                 BYTESWAP_TENSOR(tensor);
@@ -1946,10 +2490,20 @@ static bool whisper_model_load(struct whisper_model_loader * loader, whisper_con
         }
     }
 
+    // nothing points into the mapping, no need to keep it
+    if (model.mapping && !model.mapping->buffer) {
+        model.mapping.reset();
+    }
+
     for (auto & buf : model.buffers) {
         wsp_ggml_backend_buffer_set_usage(buf, WSP_GGML_BACKEND_BUFFER_USAGE_WEIGHTS);
     }
 
+    model.weights = std::make_shared<whisper_model_weights>();
+    model.weights->ctxs    = model.ctxs;
+    model.weights->buffers = model.buffers;
+    model.weights->mapping = model.mapping;
+
     wctx.t_load_us = wsp_ggml_time_us() - t_start_us;
 
     return true;
@@ -2319,15 +2873,15 @@ static struct wsp_ggml_cgraph * whisper_build_graph_cross(
 
         if (wctx.params.flash_attn) {
             k = wsp_ggml_view_1d(ctx0, wstate.kv_cross.k, n_state*n_ctx,
-                    (wsp_ggml_element_size(wstate.kv_cross.k)*n_state)*(il*n_ctx_pad));
+                    wsp_ggml_row_size(wstate.kv_cross.k->type, n_state)*(il*n_ctx_pad));
 
             v = wsp_ggml_view_1d(ctx0, wstate.kv_cross.v, n_state*n_ctx,
-                    (wsp_ggml_element_size(wstate.kv_cross.v)*n_state)*(il*n_ctx_pad));
+                    wsp_ggml_row_size(wstate.kv_cross.v->type, n_state)*(il*n_ctx_pad));
         } else {
             Vcross = wsp_ggml_transpose(ctx0, wsp_ggml_reshape_2d(ctx0, Vcross, n_state, n_ctx));
 
             k = wsp_ggml_view_1d(ctx0, wstate.kv_cross.k, n_state*n_ctx,
-                    (wsp_ggml_element_size(wstate.kv_cross.k)*n_state)*(il*n_ctx));
+                    wsp_ggml_row_size(wstate.kv_cross.k->type, n_state)*(il*n_ctx));
 
             v = wsp_ggml_view_2d(ctx0, wstate.kv_cross.v, n_ctx, n_state,
                     (   n_ctx)*wsp_ggml_element_size(wstate.kv_cross.v),
@@ -2345,14 +2899,211 @@ static struct wsp_ggml_cgraph * whisper_build_graph_cross(
     return gf;
 }
 
-// evaluate the encoder with the given state
-//
-// given audio recording (more specifically, its log mel spectrogram), runs forward pass of the encoder
-// part of the transformer model and returns the encoded features
-//
-//   - wctx:      the model
-//   - wstate:     the state of the encoder
-//   - n_threads:  number of threads to use
+// copy the frames [i0, i1) of a streamed mel spectrogram into dst ([n_mel][n_dst]) and normalize them
+// the clamping uses the maximum of the window instead of the whole audio, which gives the same result as
+// log_mel_spectrogram() as long as the audio fits into a single window
+// the frames that have already been dropped from the stream are treated as silence
+static void whisper_mel_stream_window(const whisper_mel_stream & stream, int n_mel, int i0, int i1, float * dst, int n_dst) {
+    const float silence = log10(1e-10);
+
+    auto frame = [&](int i) -> const float * {
+        if (i < stream.n_dropped) {
+            return nullptr;
+        }
+        if (i < stream.n_frames) {
+            return stream.frames.data() + (size_t) (i - stream.n_dropped)*n_mel;
+        }
+        if (i < stream.n_frames + stream.n_tail) {
+            return stream.tail.data() + (size_t) (i - stream.n_frames)*n_mel;
+        }
+        return nullptr;
+    };
+
+    double mmax = i0 < stream.n_dropped ? silence : -1e20;
+    for (int i = std::max(i0, stream.n_dropped); i < i1; ++i) {
+        const float * src = frame(i);
+        if (src == nullptr) {
+            mmax = std::max(mmax, (double) silence);
+            break;
+        }
+        for (int j = 0; j < n_mel; ++j) {
+            if (src[j] > mmax) {
+                mmax = src[j];
+            }
+        }
+    }
+
+    mmax -= 8.0;
+
+    for (int i = i0; i < i1; ++i) {
+        const float * src = frame(i);
+        for (int j = 0; j < n_mel; ++j) {
+            float v = src ? src[j] : silence;
+            if (v < mmax) {
+                v = mmax;
+            }
+            dst[j*n_dst + (i - i0)] = (v + 4.0)/4.0;
+        }
+    }
+}
+
+// 64-bit FNV-1a over the 32-bit words of the data
+// only used to find the candidate entries of whisper_kv_cross_cache, the data itself is compared on a match
+static uint64_t whisper_hash_f32(const float * data, size_t n) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t x;
+        memcpy(&x, data + i, sizeof(x));
+
+        hash = (hash ^ x)*0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// bytes of kv_cross.k and kv_cross.v written by whisper_build_graph_cross() for the current n_audio_ctx
+// the layers are stored back to back, so this is a prefix of the tensors
+static size_t whisper_kv_cross_nbytes(const whisper_context & wctx, const whisper_state & wstate, const wsp_ggml_tensor * t) {
+    const auto & hparams = wctx.model.hparams;
+
+    const int n_ctx = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : hparams.n_audio_ctx;
+    const int n_kv  = wctx.params.flash_attn ? WSP_GGML_PAD(n_ctx, 256) : n_ctx;
+
+    return wsp_ggml_row_size(t->type, hparams.n_audio_state)*hparams.n_text_layer*n_kv;
+}
+
+// restore kv_cross from the cache if the current wstate.inp_mel was encoded before
+static bool whisper_kv_cross_cache_load(whisper_state & wstate, uint64_t hash) {
+    auto & cache = wstate.kv_cross_cache;
+
+    const auto & mel = wstate.inp_mel;
+
+    for (auto it = cache.entries.begin(); it != cache.entries.end(); ++it) {
+        if (it->hash != hash || it->mel.size() != mel.size() ||
+            memcmp(it->mel.data(), mel.data(), mel.size()*sizeof(float)) != 0) {
+            continue;
+        }
+
+        cache.entries.splice(cache.entries.begin(), cache.entries, it);
+
+        wsp_ggml_backend_tensor_set(wstate.kv_cross.k, it->k.data(), 0, it->k.size());
+        wsp_ggml_backend_tensor_set(wstate.kv_cross.v, it->v.data(), 0, it->v.size());
+
+        return true;
+    }
+
+    return false;
+}
+
+// store the kv_cross of the current wstate.inp_mel, evicting the least recently used entries to stay within max_size
+static void whisper_kv_cross_cache_store(const whisper_context & wctx, whisper_state & wstate, uint64_t hash, size_t max_size) {
+    auto & cache = wstate.kv_cross_cache;
+
+    const size_t nbytes_k = whisper_kv_cross_nbytes(wctx, wstate, wstate.kv_cross.k);
+    const size_t nbytes_v = whisper_kv_cross_nbytes(wctx, wstate, wstate.kv_cross.v);
+    const size_t nbytes   = wstate.inp_mel.size()*sizeof(float) + nbytes_k + nbytes_v;
+
+    if (nbytes > max_size) {
+        return;
+    }
+
+    // the buffers of the last evicted entry are reused for the new one
+    std::list<whisper_kv_cross_entry> evicted;
+
+    while (cache.size + nbytes > max_size) {
+        cache.size -= cache.entries.back().nbytes();
+        evicted.splice(evicted.begin(), cache.entries, std::prev(cache.entries.end()));
+    }
+
+    if (evicted.empty()) {
+        evicted.emplace_back();
+    }
+
+    cache.entries.splice(cache.entries.begin(), evicted, evicted.begin());
+
+    auto & entry = cache.entries.front();
+
+    entry.hash = hash;
+    entry.mel  = wstate.inp_mel;
+
+    entry.k.resize(nbytes_k);
+    entry.v.resize(nbytes_v);
+
+    wsp_ggml_backend_tensor_get(wstate.kv_cross.k, entry.k.data(), 0, nbytes_k);
+    wsp_ggml_backend_tensor_get(wstate.kv_cross.v, entry.v.data(), 0, nbytes_v);
+
+    cache.size += entry.nbytes();
+}
+
+// recreate kv_cross with the given number of cells
+static bool whisper_kv_cross_resize(whisper_context & wctx, whisper_state & wstate, int n_cells) {
+    WHISPER_LOG_DEBUG("%s: recreating cross-attention KV cache: n_cells = %d\n", __func__, n_cells);
+
+    whisper_kv_cache_free(wstate.kv_cross);
+
+    // the cached graphs reference the old cache tensors
+    whisper_sched_reset(wstate.sched_cross);
+    whisper_sched_reset(wstate.sched_decode);
+
+    if (!whisper_kv_cache_init(wstate.kv_cross, wstate.backends[0], wctx.params.type_k, wctx.params.type_v,
+                wctx.model.hparams.n_text_state,
+                wctx.model.hparams.n_text_layer,
+                n_cells)) {
+        WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for cross-attention cache\n", __func__);
+        return false;
+    }
+
+    return true;
+}
+
+// make room in kv_cross for n_clips slots of whisper_kv_cross_nbytes() each, see whisper_full_batch()
+// the slots are sized for the current audio context, so a group of short clips often fits into the single full size
+// window that kv_cross holds by default
+static bool whisper_kv_cross_reserve(whisper_context & wctx, whisper_state & wstate, int n_clips) {
+    const int n_ctx = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : wctx.model.hparams.n_audio_ctx;
+    const int n_kv  = wctx.params.flash_attn ? WSP_GGML_PAD(n_ctx, 256) : n_ctx;
+
+    const int n_cells = WSP_GGML_PAD(n_kv*n_clips, 256);
+
+    if ((int) wstate.kv_cross.size >= n_cells) {
+        return true;
+    }
+
+    return whisper_kv_cross_resize(wctx, wstate, n_cells);
+}
+
+// shrink kv_cross back to the single full size window that whisper_init_state() allocates
+static bool whisper_kv_cross_release(whisper_context & wctx, whisper_state & wstate) {
+    const int n_cells = WSP_GGML_PAD(wctx.model.hparams.n_audio_ctx, 256);
+
+    if ((int) wstate.kv_cross.size <= n_cells) {
+        return true;
+    }
+
+    return whisper_kv_cross_resize(wctx, wstate, n_cells);
+}
+
+// copy the cross-attention KV of slot src to slot dst, the encoder always writes to slot 0
+static void whisper_kv_cross_copy_slot(const whisper_context & wctx, whisper_state & wstate, int src, int dst, std::vector<uint8_t> & buf) {
+    for (auto * t : { wstate.kv_cross.k, wstate.kv_cross.v }) {
+        const size_t nbytes = whisper_kv_cross_nbytes(wctx, wstate, t);
+
+        buf.resize(nbytes);
+
+        wsp_ggml_backend_tensor_get(t, buf.data(), src*nbytes, nbytes);
+        wsp_ggml_backend_tensor_set(t, buf.data(), dst*nbytes, nbytes);
+    }
+}
+
+// evaluate the encoder with the given state
+//
+// given audio recording (more specifically, its log mel spectrogram), runs forward pass of the encoder
+// part of the transformer model and returns the encoded features
+//
+//   - wctx:      the model
+//   - wstate:     the state of the encoder
+//   - n_threads:  number of threads to use
 //   - mel_offset: offset in the mel spectrogram (i.e. audio offset)
 //
 static bool whisper_encode_internal(
@@ -2364,51 +3115,82 @@ static bool whisper_encode_internal(
                    void * abort_callback_data) {
     const int64_t t_start_us = wsp_ggml_time_us();
 
-    // conv
+    const size_t kv_cross_cache_size = wctx.params.kv_cross_cache_size;
+
+    // prepare the input mel window
     {
-        auto & sched = wstate.sched_conv.sched;
+        const auto & mel_inp = wstate.mel;
+        const int n_ctx      = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : wctx.model.hparams.n_audio_ctx;
+
+        assert(mel_inp.n_mel == wctx.model.hparams.n_mels);
 
-        wsp_ggml_cgraph * gf = whisper_build_graph_conv(wctx, wstate);
+        wstate.inp_mel.resize(2*n_ctx*mel_inp.n_mel);
 
-        if (!wsp_ggml_backend_sched_alloc_graph(sched, gf)) {
+        float * dst = wstate.inp_mel.data();
+        memset(dst, 0, wstate.inp_mel.size()*sizeof(float));
+
+        const int i0 = std::min(mel_offset,           mel_inp.n_len);
+        const int i1 = std::min(mel_offset + 2*n_ctx, mel_inp.n_len);
+
+        if (wstate.mel_stream.active) {
+            whisper_mel_stream_window(wstate.mel_stream, mel_inp.n_mel, i0, i1, dst, 2*n_ctx);
+        } else {
+            for (int j = 0; j < mel_inp.n_mel; ++j) {
+                for (int i = i0; i < i1; ++i) {
+                    dst[j*2*n_ctx + (i - i0)] = mel_inp.data[j*mel_inp.n_len + i];
+                }
+            }
+        }
+    }
+
+    uint64_t hash = 0;
+
+    if (kv_cross_cache_size > 0) {
+        hash = whisper_hash_f32(wstate.inp_mel.data(), wstate.inp_mel.size());
+
+        if (whisper_kv_cross_cache_load(wstate, hash)) {
+            wstate.n_kv_cross_hit++;
+
+            return !(abort_callback && abort_callback(abort_callback_data));
+        }
+    }
+
+    // the graphs only depend on the audio context, they are rebuilt when it changes
+    whisper_graph_key key;
+    key.n_audio_ctx = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : wctx.model.hparams.n_audio_ctx;
+
+    // conv
+    {
+        bool built = false;
+
+        wsp_ggml_cgraph * gf = whisper_sched_graph(wstate.sched_conv, key, [&]() { return whisper_build_graph_conv(wctx, wstate); }, &built);
+        if (!gf) {
             // should never happen as we pre-allocate the memory
             return false;
         }
 
+        if (built) {
+            // the encoder and cross graphs read the output of the conv graph
+            whisper_sched_reset(wstate.sched_encode);
+            whisper_sched_reset(wstate.sched_cross);
+        }
+
         struct wsp_ggml_tensor * mel = wsp_ggml_graph_get_tensor(gf, "mel");
 
         // set the input
         {
-            const auto & mel_inp = wstate.mel;
-            const int n_ctx      = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : wctx.model.hparams.n_audio_ctx;
-
             assert(mel->type == WSP_GGML_TYPE_F32);
-            assert(mel_inp.n_mel == wctx.model.hparams.n_mels);
-
-            wstate.inp_mel.resize(wsp_ggml_nelements(mel));
-
-            float * dst = wstate.inp_mel.data();
-            memset(dst, 0, wsp_ggml_nbytes(mel));
-
-            const int i0 = std::min(mel_offset,           mel_inp.n_len);
-            const int i1 = std::min(mel_offset + 2*n_ctx, mel_inp.n_len);
-
-            for (int j = 0; j < mel_inp.n_mel; ++j) {
-                for (int i = i0; i < i1; ++i) {
-                    dst[j*2*n_ctx + (i - i0)] = mel_inp.data[j*mel_inp.n_len + i];
-                }
-            }
+            assert(wsp_ggml_nelements(mel) == (int64_t) wstate.inp_mel.size());
 
             wsp_ggml_backend_tensor_set(mel, wstate.inp_mel.data(), 0, wsp_ggml_nelements(mel)*sizeof(float));
         }
 
         if (!whisper_encode_external(wstate)) {
-            if (!wsp_ggml_graph_compute_helper(sched, gf, n_threads)) {
+            if (!whisper_sched_compute(wstate.sched_conv, gf, n_threads, wstate.threadpool)) {
                 return false;
             }
         } else {
-            wsp_ggml_backend_sched_reset(sched);
-
+            // the graph is not evaluated, only its allocated mel and embd_enc tensors are used
 #if defined(WHISPER_USE_COREML)
             whisper_coreml_encode(wstate.ctx_coreml, mel->ne[0], mel->ne[1], (float *) mel->data, (float *) wstate.embd_enc->data);
 #elif defined(WHISPER_USE_OPENVINO)
@@ -2419,36 +3201,42 @@ static bool whisper_encode_internal(
 
     // encoder
     if (!whisper_encode_external(wstate)) {
-        auto & sched = wstate.sched_encode.sched;
+        bool built = false;
 
-        wsp_ggml_cgraph * gf = whisper_build_graph_encoder(wctx, wstate);
-
-        if (!wsp_ggml_backend_sched_alloc_graph(sched, gf)) {
+        wsp_ggml_cgraph * gf = whisper_sched_graph(wstate.sched_encode, key, [&]() { return whisper_build_graph_encoder(wctx, wstate); }, &built);
+        if (!gf) {
             // should never happen as we pre-allocate the memory
             return false;
         }
 
-        if (!wsp_ggml_graph_compute_helper(sched, gf, n_threads)) {
+        if (built) {
+            // the cross graph reads the output of the encoder graph
+            whisper_sched_reset(wstate.sched_cross);
+        }
+
+        if (!whisper_sched_compute(wstate.sched_encode, gf, n_threads, wstate.threadpool)) {
             return false;
         }
     }
 
     // cross
     {
-        auto & sched = wstate.sched_cross.sched;
-
-        wsp_ggml_cgraph * gf = whisper_build_graph_cross(wctx, wstate);
-
-        if (!wsp_ggml_backend_sched_alloc_graph(sched, gf)) {
+        wsp_ggml_cgraph * gf = whisper_sched_graph(wstate.sched_cross, key, [&]() { return whisper_build_graph_cross(wctx, wstate); });
+        if (!gf) {
             // should never happen as we pre-allocate the memory
             return false;
         }
 
-        if (!wsp_ggml_graph_compute_helper(sched, gf, n_threads)) {
+        if (!whisper_sched_compute(wstate.sched_cross, gf, n_threads, wstate.threadpool)) {
             return false;
         }
     }
 
+    if (kv_cross_cache_size > 0) {
+        whisper_kv_cross_cache_store(wctx, wstate, hash, kv_cross_cache_size);
+        wstate.n_kv_cross_miss++;
+    }
+
     wstate.t_encode_us += wsp_ggml_time_us() - t_start_us;
     wstate.n_encode++;
 
@@ -2480,8 +3268,17 @@ static struct wsp_ggml_cgraph * whisper_build_graph_decoder(
 
     const int n_audio_ctx_pad = WSP_GGML_PAD(n_audio_ctx, 256);
 
+    // the clips are stored one after another in kv_cross, each clip attends to its own slot
+    const int n_clips       = worst_case ? 1 : wstate.n_clips;
+    const int n_tokens_clip = n_tokens/n_clips;
+
+    WHISPER_ASSERT(n_tokens_clip*n_clips == n_tokens);
+
     const int32_t n_kv    = worst_case ? n_ctx            : kv_self.n;
-    const int32_t kv_head = worst_case ? n_ctx - n_tokens : kv_self.head;
+
+    // bytes of a cached token of a layer, the K and V caches can be quantized
+    const size_t nb_k_row = wsp_ggml_row_size(kv_self.k->type, n_state);
+    const size_t nb_v_row = wsp_ggml_row_size(kv_self.v->type, n_state);
 
     //WHISPER_LOG_DEBUG("%s: n_past = %d, n_tokens = %d, n_audio_ctx = %d, n_ctx = %d\n", __func__, n_past, n_tokens, n_audio_ctx, n_ctx);
 
@@ -2503,6 +3300,19 @@ static struct wsp_ggml_cgraph * whisper_build_graph_decoder(
     wsp_ggml_set_name(position, "position");
     wsp_ggml_set_input(position);
 
+    // the KV cells of the tokens are graph inputs, so that the graph can be reused when kv_self.head moves
+    struct wsp_ggml_tensor * k_idxs = wsp_ggml_new_tensor_1d(ctx0, WSP_GGML_TYPE_I32, n_tokens);
+    wsp_ggml_set_name(k_idxs, "k_idxs");
+    wsp_ggml_set_input(k_idxs);
+
+    // without flash attention the V cache is transposed and each element is stored as its own row
+    struct wsp_ggml_tensor * v_idxs = k_idxs;
+    if (!wctx.params.flash_attn) {
+        v_idxs = wsp_ggml_new_tensor_1d(ctx0, WSP_GGML_TYPE_I32, n_tokens*n_state);
+        wsp_ggml_set_name(v_idxs, "v_idxs");
+        wsp_ggml_set_input(v_idxs);
+    }
+
     const float KQscale = pow(float(n_state_head), -0.25);
 
     struct wsp_ggml_tensor * KQ_mask = wsp_ggml_new_tensor_3d(ctx0, WSP_GGML_TYPE_F32, n_kv, n_tokens, 1);
@@ -2566,28 +3376,26 @@ static struct wsp_ggml_cgraph * whisper_build_graph_decoder(
                             Vcur,
                             layer.attn_v_b);
 
-                struct wsp_ggml_tensor * k;
+                struct wsp_ggml_tensor * k = wsp_ggml_view_2d(ctx0, kv_self.k, n_state, n_ctx,
+                        nb_k_row,
+                        nb_k_row*n_ctx*il);
+
                 struct wsp_ggml_tensor * v;
 
                 if (wctx.params.flash_attn) {
-                    k = wsp_ggml_view_1d(ctx0, kv_self.k, n_tokens*n_state,
-                            (wsp_ggml_element_size(kv_self.k)*n_state)*(il*n_ctx + kv_head));
-
-                    v = wsp_ggml_view_1d(ctx0, kv_self.v, n_tokens*n_state,
-                            (wsp_ggml_element_size(kv_self.v)*n_state)*(il*n_ctx + kv_head));
+                    v = wsp_ggml_view_2d(ctx0, kv_self.v, n_state, n_ctx,
+                            nb_v_row,
+                            nb_v_row*n_ctx*il);
                 } else {
-                    Vcur = wsp_ggml_transpose(ctx0, wsp_ggml_reshape_2d(ctx0, Vcur, n_state, n_tokens));
-
-                    k = wsp_ggml_view_1d(ctx0, kv_self.k, n_tokens*n_state,
-                            (wsp_ggml_element_size(kv_self.k)*n_state)*(il*n_ctx + kv_head));
+                    Vcur = wsp_ggml_reshape_2d(ctx0, Vcur, 1, n_state*n_tokens);
 
-                    v = wsp_ggml_view_2d(ctx0, kv_self.v, n_tokens, n_state,
-                            (   n_ctx)*wsp_ggml_element_size(kv_self.v),
-                            (il*n_ctx)*wsp_ggml_element_size(kv_self.v)*n_state + kv_head*wsp_ggml_element_size(kv_self.v));
+                    v = wsp_ggml_view_2d(ctx0, kv_self.v, 1, n_state*n_ctx,
+                            wsp_ggml_element_size(kv_self.v),
+                            wsp_ggml_element_size(kv_self.v)*n_state*n_ctx*il);
                 }
 
-                wsp_ggml_build_forward_expand(gf, wsp_ggml_cpy(ctx0, Kcur, k));
-                wsp_ggml_build_forward_expand(gf, wsp_ggml_cpy(ctx0, Vcur, v));
+                wsp_ggml_build_forward_expand(gf, wsp_ggml_set_rows(ctx0, k, Kcur, k_idxs));
+                wsp_ggml_build_forward_expand(gf, wsp_ggml_set_rows(ctx0, v, Vcur, v_idxs));
             }
 
             // ------
@@ -2600,17 +3408,17 @@ static struct wsp_ggml_cgraph * whisper_build_graph_decoder(
             struct wsp_ggml_tensor * K =
                 wsp_ggml_view_3d(ctx0, kv_self.k,
                         n_state_head, n_kv, n_head,
-                        wsp_ggml_element_size(kv_self.k)*n_state,
-                        wsp_ggml_element_size(kv_self.k)*n_state_head,
-                        wsp_ggml_element_size(kv_self.k)*n_state*n_ctx*il);
+                        nb_k_row,
+                        wsp_ggml_row_size(kv_self.k->type, n_state_head),
+                        nb_k_row*n_ctx*il);
 
             if (wctx.params.flash_attn) {
                 struct wsp_ggml_tensor * V =
                     wsp_ggml_view_3d(ctx0, kv_self.v,
                             n_state_head, n_kv, n_head,
-                            wsp_ggml_element_size(kv_self.v)*n_state,
-                            wsp_ggml_element_size(kv_self.v)*n_state_head,
-                            wsp_ggml_element_size(kv_self.v)*n_state*n_ctx*il);
+                            nb_v_row,
+                            wsp_ggml_row_size(kv_self.v->type, n_state_head),
+                            nb_v_row*n_ctx*il);
 
                 cur = wsp_ggml_flash_attn_ext(ctx0, Q, K, V, KQ_mask_f16, 1.0f, 0.0f, 0.0f);
 
@@ -2674,40 +3482,50 @@ static struct wsp_ggml_cgraph * whisper_build_graph_decoder(
 
             struct wsp_ggml_tensor * Q =
                 wsp_ggml_permute(ctx0,
-                        wsp_ggml_reshape_3d(ctx0, Qcur, n_state_head, n_head, n_tokens),
+                        wsp_ggml_reshape_4d(ctx0, Qcur, n_state_head, n_head, n_tokens_clip, n_clips),
                         0, 2, 1, 3);
 
             if (wctx.params.flash_attn) {
+                const size_t nb_k_cross = wsp_ggml_row_size(wstate.kv_cross.k->type, n_state);
+                const size_t nb_v_cross = wsp_ggml_row_size(wstate.kv_cross.v->type, n_state);
+
                 struct wsp_ggml_tensor * Kcross =
-                    wsp_ggml_view_3d(ctx0, wstate.kv_cross.k,
-                            n_state_head, n_audio_ctx_pad, n_head,
-                            wsp_ggml_element_size(wstate.kv_cross.k)*n_state,
-                            wsp_ggml_element_size(wstate.kv_cross.k)*n_state_head,
-                            wsp_ggml_element_size(wstate.kv_cross.k)*n_state*n_audio_ctx_pad*il);
+                    wsp_ggml_view_4d(ctx0, wstate.kv_cross.k,
+                            n_state_head, n_audio_ctx_pad, n_head, n_clips,
+                            nb_k_cross,
+                            wsp_ggml_row_size(wstate.kv_cross.k->type, n_state_head),
+                            nb_k_cross*n_layer*n_audio_ctx_pad,
+                            nb_k_cross*n_audio_ctx_pad*il);
 
                 struct wsp_ggml_tensor * Vcross =
-                    wsp_ggml_view_3d(ctx0, wstate.kv_cross.v,
-                            n_state_head, n_audio_ctx_pad, n_head,
-                            wsp_ggml_element_size(wstate.kv_cross.v)*n_state,
-                            wsp_ggml_element_size(wstate.kv_cross.v)*n_state_head,
-                            wsp_ggml_element_size(wstate.kv_cross.v)*n_state*n_audio_ctx_pad*il);
+                    wsp_ggml_view_4d(ctx0, wstate.kv_cross.v,
+                            n_state_head, n_audio_ctx_pad, n_head, n_clips,
+                            nb_v_cross,
+                            wsp_ggml_row_size(wstate.kv_cross.v->type, n_state_head),
+                            nb_v_cross*n_layer*n_audio_ctx_pad,
+                            nb_v_cross*n_audio_ctx_pad*il);
 
                 cur = wsp_ggml_flash_attn_ext(ctx0, Q, Kcross, Vcross, nullptr, KQscale, 0.0f, 0.0f);
 
                 cur = wsp_ggml_reshape_2d(ctx0, cur, n_state, n_tokens);
             } else {
-                struct wsp_ggml_tensor * Kcross =
-                    wsp_ggml_view_3d(ctx0, wstate.kv_cross.k,
-                            n_state_head, n_audio_ctx, n_head,
-                            wsp_ggml_element_size(wstate.kv_cross.k)*n_state,
-                            wsp_ggml_element_size(wstate.kv_cross.k)*n_state_head,
-                            wsp_ggml_element_size(wstate.kv_cross.k)*n_state*n_audio_ctx*il);
+                const size_t nb_k_cross = wsp_ggml_row_size(wstate.kv_cross.k->type, n_state);
 
+                struct wsp_ggml_tensor * Kcross =
+                    wsp_ggml_view_4d(ctx0, wstate.kv_cross.k,
+                            n_state_head, n_audio_ctx, n_head, n_clips,
+                            nb_k_cross,
+                            wsp_ggml_row_size(wstate.kv_cross.k->type, n_state_head),
+                            nb_k_cross*n_layer*n_audio_ctx,
+                            nb_k_cross*n_audio_ctx*il);
+
+                // the transposed V cache is never quantized, see whisper_init_with_params_no_state()
                 struct wsp_ggml_tensor * Vcross =
-                    wsp_ggml_view_3d(ctx0, wstate.kv_cross.v,
-                            n_audio_ctx, n_state_head, n_head,
+                    wsp_ggml_view_4d(ctx0, wstate.kv_cross.v,
+                            n_audio_ctx, n_state_head, n_head, n_clips,
                             n_audio_ctx*wsp_ggml_element_size(wstate.kv_cross.v),
                             n_audio_ctx*wsp_ggml_element_size(wstate.kv_cross.v)*n_state_head,
+                            n_audio_ctx*wsp_ggml_element_size(wstate.kv_cross.v)*n_state*n_layer,
                             n_audio_ctx*wsp_ggml_element_size(wstate.kv_cross.v)*n_state*il);
 
                 // ------
@@ -2718,19 +3536,18 @@ static struct wsp_ggml_cgraph * whisper_build_graph_decoder(
                 struct wsp_ggml_tensor * KQ_soft_max = wsp_ggml_soft_max_ext(ctx0, KQ, nullptr, KQscale, 0.0f);
 
                 // [EXPERIMENTAL] Token-level timestamps with DTW
-                if (wctx.params.dtw_token_timestamps) {
+                if (wctx.params.dtw_token_timestamps && n_clips == 1) {
                     if (wstate.aheads_masks.m[il] != nullptr) {
                         struct wsp_ggml_tensor * aheads_KQs = wsp_ggml_reshape_2d(ctx0, KQ_soft_max, KQ_soft_max->ne[0] * KQ_soft_max->ne[1], KQ_soft_max->ne[2]);
                         aheads_KQs = wsp_ggml_transpose(ctx0, aheads_KQs);
                         aheads_KQs = wsp_ggml_cont(ctx0, aheads_KQs);
                         aheads_KQs = wsp_ggml_mul_mat(ctx0, wstate.aheads_masks.m[il], aheads_KQs);
-                        aheads_KQs = wsp_ggml_transpose(ctx0, aheads_KQs);
-                        aheads_KQs = wsp_ggml_cont(ctx0, aheads_KQs);
-                        aheads_KQs = wsp_ggml_reshape_3d(ctx0, aheads_KQs, KQ_soft_max->ne[0], KQ_soft_max->ne[1], wstate.aheads_masks.m[il]->ne[1]);
+                        // keep the heads innermost so that the row of each token is contiguous
+                        aheads_KQs = wsp_ggml_reshape_3d(ctx0, aheads_KQs, wstate.aheads_masks.m[il]->ne[1], KQ_soft_max->ne[0], KQ_soft_max->ne[1]);
                         if (aheads_cross_QKs == NULL) {
                             aheads_cross_QKs = aheads_KQs;
                         } else {
-                            aheads_cross_QKs = wsp_ggml_concat(ctx0, aheads_cross_QKs, aheads_KQs, 2);
+                            aheads_cross_QKs = wsp_ggml_concat(ctx0, aheads_cross_QKs, aheads_KQs, 0);
                         }
                     }
                 }
@@ -2819,13 +3636,9 @@ static struct wsp_ggml_cgraph * whisper_build_graph_decoder(
     struct wsp_ggml_tensor * logits = wsp_ggml_mul_mat(ctx0, model.d_te, cur);
 
     // [EXPERIMENTAL] Token-level timestamps with DTW
-    if (wctx.params.dtw_token_timestamps && aheads_cross_QKs != nullptr) {
-        aheads_cross_QKs = wsp_ggml_transpose(ctx0, aheads_cross_QKs);
-        aheads_cross_QKs = wsp_ggml_cont(ctx0, aheads_cross_QKs);
-        if (save_alignment_heads_QKs) {
-            wsp_ggml_build_forward_expand(gf, aheads_cross_QKs);
-            wstate.aheads_cross_QKs = aheads_cross_QKs;
-        }
+    if (save_alignment_heads_QKs && aheads_cross_QKs != nullptr) {
+        wsp_ggml_set_name(aheads_cross_QKs, "aheads_cross_QKs");
+        wsp_ggml_build_forward_expand(gf, aheads_cross_QKs);
     }
 
     wsp_ggml_build_forward_expand(gf, logits);
@@ -2835,6 +3648,81 @@ static struct wsp_ggml_cgraph * whisper_build_graph_decoder(
     return gf;
 }
 
+#ifdef WHISPER_CHECK_GRAPH_REUSE
+// opt-in (-DWHISPER_CHECK_GRAPH_REUSE), doubles the cost of the decoder: evaluate a reused decoder graph, then its
+// inputs again with a freshly built graph, and check that the logits match, so that a missing key field in
+// whisper_graph_key shows up as an assert instead of wrong transcripts
+// the new graph replaces the reused one in wstate.sched_decode and is returned, nullptr on failure
+static wsp_ggml_cgraph * whisper_decode_check_reuse(
+        whisper_context & wctx,
+          whisper_state & wstate,
+    const whisper_batch & batch,
+                   bool   save_alignment_heads_QKs,
+        wsp_ggml_cgraph * gf,
+              const int   n_threads) {
+    static const char * inputs[] = { "embd", "position", "k_idxs", "v_idxs", "KQ_mask" };
+    static const int n_inputs = sizeof(inputs)/sizeof(inputs[0]);
+
+    std::vector<uint8_t> data[n_inputs];
+
+    for (int i = 0; i < n_inputs; ++i) {
+        const wsp_ggml_tensor * t = wsp_ggml_graph_get_tensor(gf, inputs[i]);
+        if (t) {
+            data[i].resize(wsp_ggml_nbytes(t));
+            wsp_ggml_backend_tensor_get(t, data[i].data(), 0, data[i].size());
+        }
+    }
+
+    // the inputs are read before the evaluation, their memory can be reused for the intermediate results
+    if (!whisper_sched_compute(wstate.sched_decode, gf, n_threads, wstate.threadpool)) {
+        return nullptr;
+    }
+
+    std::vector<float> logits_reused(wsp_ggml_nelements(wsp_ggml_graph_node(gf, -1)));
+    wsp_ggml_backend_tensor_get(wsp_ggml_graph_node(gf, -1), logits_reused.data(), 0, logits_reused.size()*sizeof(float));
+
+    const whisper_graph_key key = wstate.sched_decode.gf_key;
+
+    whisper_sched_reset(wstate.sched_decode);
+
+    gf = whisper_sched_graph(wstate.sched_decode, key, [&]() {
+        return whisper_build_graph_decoder(wctx, wstate, batch, save_alignment_heads_QKs, false);
+    });
+    if (!gf) {
+        return nullptr;
+    }
+
+    for (int i = 0; i < n_inputs; ++i) {
+        wsp_ggml_tensor * t = wsp_ggml_graph_get_tensor(gf, inputs[i]);
+        WHISPER_ASSERT((t != nullptr) == !data[i].empty());
+        if (t) {
+            WHISPER_ASSERT(wsp_ggml_nbytes(t) == data[i].size());
+            wsp_ggml_backend_tensor_set(t, data[i].data(), 0, data[i].size());
+        }
+    }
+
+    // the graph writes the KV of the batch to the same cells again, with the same values
+    if (!whisper_sched_compute(wstate.sched_decode, gf, n_threads, wstate.threadpool)) {
+        return nullptr;
+    }
+
+    std::vector<float> logits_built(logits_reused.size());
+    wsp_ggml_backend_tensor_get(wsp_ggml_graph_node(gf, -1), logits_built.data(), 0, logits_built.size()*sizeof(float));
+
+    float max_diff = 0.0f;
+    for (size_t i = 0; i < logits_built.size(); ++i) {
+        max_diff = std::max(max_diff, std::fabs(logits_built[i] - logits_reused[i]));
+    }
+
+    WHISPER_LOG_DEBUG("%s: n_tokens = %d, n_kv = %d, max logits diff = %g\n", __func__, key.n_tokens, key.n_kv, max_diff);
+
+    // the same kernels run on the same inputs, only the GPU backends may reorder their reductions
+    WHISPER_ASSERT(max_diff <= 1e-3f);
+
+    return gf;
+}
+#endif
+
 // evaluate the decoder
 //
 // given text prompt + audio features -> computes the logits for the next token
@@ -2882,11 +3770,20 @@ static bool whisper_decode_internal(
 
     // decoder
     {
-        auto & sched = wstate.sched_decode.sched;
-
-        wsp_ggml_cgraph * gf = whisper_build_graph_decoder(wctx, wstate, batch, save_alignment_heads_QKs, false);
-
-        if (!wsp_ggml_backend_sched_alloc_graph(sched, gf)) {
+        // the graph is reused while the number of tokens and the KV window stay the same
+        whisper_graph_key key;
+        key.n_tokens    = n_tokens;
+        key.n_kv        = wstate.kv_self.n;
+        key.n_audio_ctx = wstate.exp_n_audio_ctx > 0 ? wstate.exp_n_audio_ctx : hparams.n_audio_ctx;
+        key.n_clips     = wstate.n_clips;
+        key.aheads      = save_alignment_heads_QKs;
+
+        bool built = false;
+
+        wsp_ggml_cgraph * gf = whisper_sched_graph(wstate.sched_decode, key, [&]() {
+            return whisper_build_graph_decoder(wctx, wstate, batch, save_alignment_heads_QKs, false);
+        }, &built);
+        if (!gf) {
             // should never happen as we pre-allocate the memory
             return false;
         }
@@ -2905,6 +3802,34 @@ static bool whisper_decode_internal(
             }
         }
 
+        {
+            const auto & kv_self = wstate.kv_self;
+
+            // the tokens occupy the cells [head, head + n_tokens), see whisper_kv_cache_find_slot()
+            wstate.inp_idxs.resize(n_tokens);
+            for (int i = 0; i < n_tokens; ++i) {
+                wstate.inp_idxs[i] = kv_self.head + i;
+            }
+
+            struct wsp_ggml_tensor * k_idxs = wsp_ggml_graph_get_tensor(gf, "k_idxs");
+            wsp_ggml_backend_tensor_set(k_idxs, wstate.inp_idxs.data(), 0, n_tokens*sizeof(int32_t));
+
+            if (!wctx.params.flash_attn) {
+                const int n_state = hparams.n_text_state;
+
+                // element s of token i goes to row s*size + head + i of the transposed V cache
+                wstate.inp_idxs.resize(n_tokens*n_state);
+                for (int i = 0; i < n_tokens; ++i) {
+                    for (int s = 0; s < n_state; ++s) {
+                        wstate.inp_idxs[i*n_state + s] = s*kv_self.size + kv_self.head + i;
+                    }
+                }
+
+                struct wsp_ggml_tensor * v_idxs = wsp_ggml_graph_get_tensor(gf, "v_idxs");
+                wsp_ggml_backend_tensor_set(v_idxs, wstate.inp_idxs.data(), 0, n_tokens*n_state*sizeof(int32_t));
+            }
+        }
+
         {
             struct wsp_ggml_tensor * KQ_mask = wsp_ggml_graph_get_tensor(gf, "KQ_mask");
 
@@ -2920,10 +3845,10 @@ static bool whisper_decode_internal(
             for (int h = 0; h < 1; ++h) {
                 for (int j = 0; j < n_tokens; ++j) {
                     const whisper_pos    pos    = batch.pos[j];
-                    const whisper_seq_id seq_id = batch.seq_id[j][0];
+                    const whisper_seq_mask seq_bit = whisper_seq_bit(batch.seq_id[j][0]);
 
                     for (int i = 0; i < n_kv; ++i) {
-                        if (!kv_self.cells[i].has_seq_id(seq_id) || kv_self.cells[i].pos > pos) {
+                        if (!(kv_self.cells_seq[i] & seq_bit) || kv_self.cells_pos[i] > pos) {
                             data[h*(n_kv*n_tokens) + j*n_kv + i] = -INFINITY;
                         }
                     }
@@ -2941,7 +3866,27 @@ static bool whisper_decode_internal(
 
         logits = wsp_ggml_graph_node(gf, -1);
 
-        if (!wsp_ggml_graph_compute_helper(sched, gf, n_threads)) {
+        // [EXPERIMENTAL] Token-level timestamps with DTW
+        wstate.aheads_cross_QKs = save_alignment_heads_QKs ? wsp_ggml_graph_get_tensor(gf, "aheads_cross_QKs") : nullptr;
+
+        bool computed = false;
+
+#ifdef WHISPER_CHECK_GRAPH_REUSE
+        if (!built) {
+            gf = whisper_decode_check_reuse(wctx, wstate, batch, save_alignment_heads_QKs, gf, n_threads);
+            if (!gf) {
+                return false;
+            }
+
+            logits = wsp_ggml_graph_node(gf, -1);
+
+            wstate.aheads_cross_QKs = save_alignment_heads_QKs ? wsp_ggml_graph_get_tensor(gf, "aheads_cross_QKs") : nullptr;
+
+            computed = true;
+        }
+#endif
+
+        if (!computed && !whisper_sched_compute(wstate.sched_decode, gf, n_threads, wstate.threadpool)) {
             return false;
         }
     }
@@ -2995,6 +3940,9 @@ static std::string to_timestamp(int64_t t, bool comma = false) {
 }
 
 #define SIN_COS_N_COUNT WHISPER_N_FFT
+#define WHISPER_FFT_N_CPX (WHISPER_N_FFT/2)
+#define WHISPER_FFT_MAX_STAGES 8
+
 namespace {
 struct whisper_global_cache {
     // In FFT, we frequently use sine and cosine operations with the same values.
@@ -3007,9 +3955,21 @@ struct whisper_global_cache {
     // ref: https://github.com/openai/whisper/blob/main/whisper/audio.py#L147
     float hann_window[WHISPER_N_FFT];
 
+    // FFT plan for the real-valued frames of size WHISPER_N_FFT
+    // the frame is packed into WHISPER_N_FFT/2 complex values which are transformed with a mixed-radix
+    // Stockham FFT (radix 2, 4 and 5) and then unpacked into the WHISPER_N_FFT/2 + 1 non-redundant bins
+    int fft_n_stages = 0;
+    int fft_radix [WHISPER_FFT_MAX_STAGES];
+    int fft_tw_ofs[WHISPER_FFT_MAX_STAGES];
+
+    // per-stage twiddles w_n^(p*k), stored as [tw_ofs + (k - 1)*m + p]
+    float fft_tw_re[WHISPER_FFT_N_CPX];
+    float fft_tw_im[WHISPER_FFT_N_CPX];
+
     whisper_global_cache() {
         fill_sin_cos_table();
         fill_hann_window(sizeof(hann_window)/sizeof(hann_window[0]), true, hann_window);
+        fill_fft_plan();
     }
 
     void fill_sin_cos_table() {
@@ -3029,132 +3989,325 @@ struct whisper_global_cache {
             output[i] = 0.5 * (1.0 - cosf((2.0 * M_PI * i) / (length + offset)));
         }
     }
+
+    void fill_fft_plan() {
+        // prefer radix-4, then radix-2 and radix-5 - the stride of the later stages grows quickly,
+        // which allows them to be vectorized over the contiguous inner loop
+        int n = WHISPER_FFT_N_CPX;
+        while (n > 1) {
+            int r = 0;
+            if      (n % 4 == 0) r = 4;
+            else if (n % 2 == 0) r = 2;
+            else if (n % 5 == 0) r = 5;
+            else {
+                assert(false && "Unsupported FFT size");
+                break;
+            }
+            fft_radix[fft_n_stages++] = r;
+            n /= r;
+        }
+
+        int ofs = 0;
+        n = WHISPER_FFT_N_CPX;
+        for (int i = 0; i < fft_n_stages; i++) {
+            const int r = fft_radix[i];
+            const int m = n / r;
+            fft_tw_ofs[i] = ofs;
+            for (int k = 1; k < r; k++) {
+                for (int p = 0; p < m; p++) {
+                    const double theta = (2 * M_PI * p * k) / n;
+                    fft_tw_re[ofs] =  cos(theta);
+                    fft_tw_im[ofs] = -sin(theta);
+                    ofs++;
+                }
+            }
+            n = m;
+        }
+    }
 } global_cache;
 }
 
-// naive Discrete Fourier Transform
-// input is real-valued
-// output is complex-valued
-static void dft(const float* in, int N, float* out) {
-    const int sin_cos_step = SIN_COS_N_COUNT / N;
+// scalar and SIMD arithmetic used by the FFT butterflies
+struct whisper_fft_ops_f32 {
+    using T = float;
+    static constexpr int n = 1;
 
-    for (int k = 0; k < N; k++) {
-        float re = 0;
-        float im = 0;
+    static inline T load (const float * p)       { return *p; }
+    static inline void store(float * p, T v)     { *p = v; }
+    static inline T set1 (float v)               { return v; }
+    static inline T add  (T a, T b)              { return a + b; }
+    static inline T sub  (T a, T b)              { return a - b; }
+    static inline T mul  (T a, T b)              { return a * b; }
+    static inline T fma  (T a, T b, T c)         { return a + b*c; }
+};
 
-        for (int n = 0; n < N; n++) {
-            int idx = (k * n * sin_cos_step) % (SIN_COS_N_COUNT); // t = 2*M_PI*k*n/N
-            re += in[n]*global_cache.cos_vals[idx]; // cos(t)
-            im -= in[n]*global_cache.sin_vals[idx]; // sin(t)
-        }
+#if defined(__AVX__)
+#define WHISPER_FFT_SIMD
+struct whisper_fft_ops_vec {
+    using T = __m256;
+    static constexpr int n = 8;
+
+    static inline T load (const float * p)       { return _mm256_loadu_ps(p); }
+    static inline void store(float * p, T v)     { _mm256_storeu_ps(p, v); }
+    static inline T set1 (float v)               { return _mm256_set1_ps(v); }
+    static inline T add  (T a, T b)              { return _mm256_add_ps(a, b); }
+    static inline T sub  (T a, T b)              { return _mm256_sub_ps(a, b); }
+    static inline T mul  (T a, T b)              { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+    static inline T fma  (T a, T b, T c)         { return _mm256_fmadd_ps(b, c, a); }
+#else
+    static inline T fma  (T a, T b, T c)         { return _mm256_add_ps(a, _mm256_mul_ps(b, c)); }
+#endif
+};
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define WHISPER_FFT_SIMD
+struct whisper_fft_ops_vec {
+    using T = float32x4_t;
+    static constexpr int n = 4;
+
+    static inline T load (const float * p)       { return vld1q_f32(p); }
+    static inline void store(float * p, T v)     { vst1q_f32(p, v); }
+    static inline T set1 (float v)               { return vdupq_n_f32(v); }
+    static inline T add  (T a, T b)              { return vaddq_f32(a, b); }
+    static inline T sub  (T a, T b)              { return vsubq_f32(a, b); }
+    static inline T mul  (T a, T b)              { return vmulq_f32(a, b); }
+    static inline T fma  (T a, T b, T c)         { return vfmaq_f32(a, b, c); }
+};
+#elif defined(__SSE2__)
+#define WHISPER_FFT_SIMD
+struct whisper_fft_ops_vec {
+    using T = __m128;
+    static constexpr int n = 4;
+
+    static inline T load (const float * p)       { return _mm_loadu_ps(p); }
+    static inline void store(float * p, T v)     { _mm_storeu_ps(p, v); }
+    static inline T set1 (float v)               { return _mm_set1_ps(v); }
+    static inline T add  (T a, T b)              { return _mm_add_ps(a, b); }
+    static inline T sub  (T a, T b)              { return _mm_sub_ps(a, b); }
+    static inline T mul  (T a, T b)              { return _mm_mul_ps(a, b); }
+    static inline T fma  (T a, T b, T c)         { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+};
+#endif
+
+// one radix-r butterfly of a Stockham pass for the O::n lanes starting at q:
+//
+//   y[q + s*(r*p + k)] = w_n^(p*k) * sum_j x[q + s*(p + j*m)] * w_r^(j*k)
+//
+template <typename O>
+static inline void whisper_fft_butterfly(
+        int r, int m, int s, int p, int q,
+        const float * tw_re, const float * tw_im,
+        const float * xr, const float * xi,
+              float * yr,       float * yi) {
+    using T = typename O::T;
+
+    T ar[5];
+    T ai[5];
+    for (int j = 0; j < r; j++) {
+        ar[j] = O::load(xr + q + s*(p + j*m));
+        ai[j] = O::load(xi + q + s*(p + j*m));
+    }
+
+    T cr[5];
+    T ci[5];
+    switch (r) {
+        case 2:
+            {
+                cr[0] = O::add(ar[0], ar[1]); ci[0] = O::add(ai[0], ai[1]);
+                cr[1] = O::sub(ar[0], ar[1]); ci[1] = O::sub(ai[0], ai[1]);
+            } break;
+        case 4:
+            {
+                const T t0r = O::add(ar[0], ar[2]); const T t0i = O::add(ai[0], ai[2]);
+                const T t1r = O::sub(ar[0], ar[2]); const T t1i = O::sub(ai[0], ai[2]);
+                const T t2r = O::add(ar[1], ar[3]); const T t2i = O::add(ai[1], ai[3]);
+                const T t3r = O::sub(ar[1], ar[3]); const T t3i = O::sub(ai[1], ai[3]);
+
+                // w_4 = -i
+                cr[0] = O::add(t0r, t2r); ci[0] = O::add(t0i, t2i);
+                cr[1] = O::add(t1r, t3i); ci[1] = O::sub(t1i, t3r);
+                cr[2] = O::sub(t0r, t2r); ci[2] = O::sub(t0i, t2i);
+                cr[3] = O::sub(t1r, t3i); ci[3] = O::add(t1i, t3r);
+            } break;
+        case 5:
+            {
+                const T c1 = O::set1( 0.309016994374947424f); // cos(2*pi/5)
+                const T c2 = O::set1(-0.809016994374947424f); // cos(4*pi/5)
+                const T s1 = O::set1( 0.951056516295153572f); // sin(2*pi/5)
+                const T s2 = O::set1( 0.587785252292473129f); // sin(4*pi/5)
+
+                const T t1r = O::add(ar[1], ar[4]); const T t1i = O::add(ai[1], ai[4]);
+                const T t2r = O::add(ar[2], ar[3]); const T t2i = O::add(ai[2], ai[3]);
+                const T t3r = O::sub(ar[1], ar[4]); const T t3i = O::sub(ai[1], ai[4]);
+                const T t4r = O::sub(ar[2], ar[3]); const T t4i = O::sub(ai[2], ai[3]);
+
+                const T b1r = O::fma(O::fma(ar[0], c1, t1r), c2, t2r);
+                const T b1i = O::fma(O::fma(ai[0], c1, t1i), c2, t2i);
+                const T b2r = O::fma(O::fma(ar[0], c2, t1r), c1, t2r);
+                const T b2i = O::fma(O::fma(ai[0], c2, t1i), c1, t2i);
+
+                const T d1r = O::fma(O::mul(s1, t3r), s2, t4r);
+                const T d1i = O::fma(O::mul(s1, t3i), s2, t4i);
+                const T d2r = O::sub(O::mul(s2, t3r), O::mul(s1, t4r));
+                const T d2i = O::sub(O::mul(s2, t3i), O::mul(s1, t4i));
+
+                cr[0] = O::add(ar[0], O::add(t1r, t2r));
+                ci[0] = O::add(ai[0], O::add(t1i, t2i));
+
+                // X1 = b1 - i*d1, X4 = b1 + i*d1, X2 = b2 - i*d2, X3 = b2 + i*d2
+                cr[1] = O::add(b1r, d1i); ci[1] = O::sub(b1i, d1r);
+                cr[4] = O::sub(b1r, d1i); ci[4] = O::add(b1i, d1r);
+                cr[2] = O::add(b2r, d2i); ci[2] = O::sub(b2i, d2r);
+                cr[3] = O::sub(b2r, d2i); ci[3] = O::add(b2i, d2r);
+            } break;
+        default:
+            WSP_GGML_ABORT("unsupported FFT radix");
+    }
+
+    O::store(yr + q + s*(r*p), cr[0]);
+    O::store(yi + q + s*(r*p), ci[0]);
+    for (int k = 1; k < r; k++) {
+        const T wr = O::set1(tw_re[(k - 1)*m + p]);
+        const T wi = O::set1(tw_im[(k - 1)*m + p]);
 
-        out[k*2 + 0] = re;
-        out[k*2 + 1] = im;
+        O::store(yr + q + s*(r*p + k), O::sub(O::mul(cr[k], wr), O::mul(ci[k], wi)));
+        O::store(yi + q + s*(r*p + k), O::add(O::mul(cr[k], wi), O::mul(ci[k], wr)));
     }
 }
 
-// Cooley-Tukey FFT
-// poor man's implementation - use something better
-// input is real-valued
-// output is complex-valued
-static void fft(float* in, int N, float* out) {
-    if (N == 1) {
-        out[0] = in[0];
-        out[1] = 0;
-        return;
-    }
+// real-valued FFT of a single frame of size WHISPER_N_FFT
+// output is complex-valued, only the first WHISPER_N_FFT/2 + 1 bins are computed
+// work must hold 4*(WHISPER_N_FFT/2) floats
+static void fft(const float * in, float * out, float * work) {
+    const int M = WHISPER_FFT_N_CPX;
 
-    const int half_N = N / 2;
-    if (N - half_N*2 == 1) {
-        dft(in, N, out);
-        return;
-    }
+    float * xr = work + 0*M;
+    float * xi = work + 1*M;
+    float * yr = work + 2*M;
+    float * yi = work + 3*M;
 
-    float* even = in + N;
-    for (int i = 0; i < half_N; ++i) {
-        even[i]= in[2*i];
+    // pack the even samples into the real and the odd samples into the imaginary part
+    for (int i = 0; i < M; i++) {
+        xr[i] = in[2*i + 0];
+        xi[i] = in[2*i + 1];
     }
-    float* even_fft = out + 2 * N;
-    fft(even, half_N, even_fft);
 
-    float* odd = even;
-    for (int i = 0; i < half_N; ++i) {
-        odd[i] = in[2*i + 1];
+    int n = M;
+    int s = 1;
+    for (int i = 0; i < global_cache.fft_n_stages; i++) {
+        const int r = global_cache.fft_radix[i];
+        const int m = n / r;
+
+        const float * tw_re = global_cache.fft_tw_re + global_cache.fft_tw_ofs[i];
+        const float * tw_im = global_cache.fft_tw_im + global_cache.fft_tw_ofs[i];
+
+        for (int p = 0; p < m; p++) {
+            int q = 0;
+#if defined(WHISPER_FFT_SIMD)
+            for (; q + whisper_fft_ops_vec::n <= s; q += whisper_fft_ops_vec::n) {
+                whisper_fft_butterfly<whisper_fft_ops_vec>(r, m, s, p, q, tw_re, tw_im, xr, xi, yr, yi);
+            }
+#endif
+            for (; q < s; q++) {
+                whisper_fft_butterfly<whisper_fft_ops_f32>(r, m, s, p, q, tw_re, tw_im, xr, xi, yr, yi);
+            }
+        }
+
+        std::swap(xr, yr);
+        std::swap(xi, yi);
+
+        n  = m;
+        s *= r;
     }
-    float* odd_fft = even_fft + N;
-    fft(odd, half_N, odd_fft);
 
-    const int sin_cos_step = SIN_COS_N_COUNT / N;
-    for (int k = 0; k < half_N; k++) {
-        int idx = k * sin_cos_step; // t = 2*M_PI*k/N
-        float re = global_cache.cos_vals[idx]; // cos(t)
-        float im = -global_cache.sin_vals[idx]; // sin(t)
+    // unpack the spectrum of the real input:
+    //
+    //   X[k] = (Z[k] + conj(Z[M - k]))/2 - i*w_N^k*(Z[k] - conj(Z[M - k]))/2
+    //
+    for (int k = 0; k <= M; k++) {
+        const int k0 = k % M;
+        const int k1 = (M - k) % M;
 
-        float re_odd = odd_fft[2*k + 0];
-        float im_odd = odd_fft[2*k + 1];
+        const float even_re =  0.5f*(xr[k0] + xr[k1]);
+        const float even_im =  0.5f*(xi[k0] - xi[k1]);
+        const float odd_re  =  0.5f*(xi[k0] + xi[k1]);
+        const float odd_im  = -0.5f*(xr[k0] - xr[k1]);
 
-        out[2*k + 0] = even_fft[2*k + 0] + re*re_odd - im*im_odd;
-        out[2*k + 1] = even_fft[2*k + 1] + re*im_odd + im*re_odd;
+        const float wr =  global_cache.cos_vals[k]; // cos(t)
+        const float wi = -global_cache.sin_vals[k]; // sin(t)
 
-        out[2*(k + half_N) + 0] = even_fft[2*k + 0] - re*re_odd + im*im_odd;
-        out[2*(k + half_N) + 1] = even_fft[2*k + 1] - re*im_odd - im*re_odd;
+        out[2*k + 0] = even_re + wr*odd_re - wi*odd_im;
+        out[2*k + 1] = even_im + wr*odd_im + wi*odd_re;
+    }
+}
+
+// compute the log10 mel energies of a single frame
+// samples points at the start of the frame, only the first n_avail of them are read, the rest is treated as zeros
+// the result for mel band j is written to out[j*stride]
+static void log_mel_spectrogram_frame(const float * hann, const float * samples, int n_avail, int frame_size,
+                                      const whisper_filters & filters, int n_mel,
+                                      float * fft_in, float * fft_out, float * fft_work,
+                                      float * out, int stride) {
+    const int n_fft = filters.n_fft;
+
+    // apply Hann window (~10% faster)
+    for (int j = 0; j < std::min(frame_size, n_avail); j++) {
+        fft_in[j] = hann[j] * samples[j];
+    }
+
+    // fill the rest with zeros
+    if (n_avail < frame_size) {
+        std::fill(fft_in + std::max(n_avail, 0), fft_in + frame_size, 0.0f);
+    }
+
+    // FFT
+    fft(fft_in, fft_out, fft_work);
+
+    // Calculate modulus^2 of complex numbers
+    // Use pow(fft_out[2 * j + 0], 2) + pow(fft_out[2 * j + 1], 2) causes inference quality problem? Interesting.
+    for (int j = 0; j < n_fft; j++) {
+        fft_out[j] = (fft_out[2 * j + 0] * fft_out[2 * j + 0] + fft_out[2 * j + 1] * fft_out[2 * j + 1]);
+    }
+
+    // mel spectrogram
+    for (int j = 0; j < n_mel; j++) {
+        double sum = 0.0;
+        // unroll loop (suggested by GH user @lunixbochs)
+        int k = 0;
+        for (k = 0; k < n_fft - 3; k += 4) {
+            sum +=
+                    fft_out[k + 0] * filters.data[j * n_fft + k + 0] +
+                    fft_out[k + 1] * filters.data[j * n_fft + k + 1] +
+                    fft_out[k + 2] * filters.data[j * n_fft + k + 2] +
+                    fft_out[k + 3] * filters.data[j * n_fft + k + 3];
+        }
+        // handle n_fft remainder
+        for (; k < n_fft; k++) {
+            sum += fft_out[k] * filters.data[j * n_fft + k];
+        }
+        sum = log10(std::max(sum, 1e-10));
+        out[j * stride] = sum;
     }
 }
 
 static void log_mel_spectrogram_worker_thread(int ith, const float * hann, const std::vector<float> & samples,
                                               int n_samples, int frame_size, int frame_step, int n_threads,
                                               const whisper_filters & filters, whisper_mel & mel) {
-    std::vector<float> fft_in(frame_size * 2, 0.0);
-    std::vector<float> fft_out(frame_size * 2 * 2 * 2);
+    std::vector<float> fft_in(frame_size, 0.0);
+    std::vector<float> fft_out((frame_size / 2 + 1) * 2);
+    std::vector<float> fft_work(frame_size * 2);
 
-    int n_fft = filters.n_fft;
     int i = ith;
 
     // make sure n_fft == 1 + (WHISPER_N_FFT / 2), bin_0 to bin_nyquist
-    assert(n_fft == 1 + (frame_size / 2));
+    assert(filters.n_fft == 1 + (frame_size / 2));
 
     // calculate FFT only when fft_in are not all zero
     for (; i < std::min(n_samples / frame_step + 1, mel.n_len); i += n_threads) {
         const int offset = i * frame_step;
 
-        // apply Hann window (~10% faster)
-        for (int j = 0; j < std::min(frame_size, n_samples - offset); j++) {
-            fft_in[j] = hann[j] * samples[offset + j];
-        }
-
-        // fill the rest with zeros
-        if (n_samples - offset < frame_size) {
-            std::fill(fft_in.begin() + (n_samples - offset), fft_in.end(), 0.0);
-        }
-
-        // FFT
-        fft(fft_in.data(), frame_size, fft_out.data());
-
-        // Calculate modulus^2 of complex numbers
-        // Use pow(fft_out[2 * j + 0], 2) + pow(fft_out[2 * j + 1], 2) causes inference quality problem? Interesting.
-        for (int j = 0; j < n_fft; j++) {
-            fft_out[j] = (fft_out[2 * j + 0] * fft_out[2 * j + 0] + fft_out[2 * j + 1] * fft_out[2 * j + 1]);
-        }
-
-        // mel spectrogram
-        for (int j = 0; j < mel.n_mel; j++) {
-            double sum = 0.0;
-            // unroll loop (suggested by GH user @lunixbochs)
-            int k = 0;
-            for (k = 0; k < n_fft - 3; k += 4) {
-                sum +=
-                        fft_out[k + 0] * filters.data[j * n_fft + k + 0] +
-                        fft_out[k + 1] * filters.data[j * n_fft + k + 1] +
-                        fft_out[k + 2] * filters.data[j * n_fft + k + 2] +
-                        fft_out[k + 3] * filters.data[j * n_fft + k + 3];
-            }
-            // handle n_fft remainder
-            for (; k < n_fft; k++) {
-                sum += fft_out[k] * filters.data[j * n_fft + k];
-            }
-            sum = log10(std::max(sum, 1e-10));
-            mel.data[j * mel.n_len + i] = sum;
-        }
+        log_mel_spectrogram_frame(hann, samples.data() + offset, n_samples - offset, frame_size, filters, mel.n_mel,
+                                  fft_in.data(), fft_out.data(), fft_work.data(), mel.data.data() + i, mel.n_len);
     }
 
     // Otherwise fft_out are all zero
@@ -3208,22 +4361,9 @@ static bool log_mel_spectrogram(
     mel.n_len_org = 1 + (n_samples + stage_2_pad - frame_size) / frame_step;
     mel.data.resize(mel.n_mel * mel.n_len);
 
-    {
-        std::vector<std::thread> workers(n_threads - 1);
-        for (int iw = 0; iw < n_threads - 1; ++iw) {
-            workers[iw] = std::thread(
-                    log_mel_spectrogram_worker_thread, iw + 1, hann, std::cref(samples_padded),
-                    n_samples + stage_2_pad, frame_size, frame_step, n_threads,
-                    std::cref(filters), std::ref(mel));
-        }
-
-        // main thread
-        log_mel_spectrogram_worker_thread(0, hann, samples_padded, n_samples + stage_2_pad, frame_size, frame_step, n_threads, filters, mel);
-
-        for (int iw = 0; iw < n_threads - 1; ++iw) {
-            workers[iw].join();
-        }
-    }
+    wstate.workers.run(n_threads, [&](int ith, int nth) {
+        log_mel_spectrogram_worker_thread(ith, hann, samples_padded, n_samples + stage_2_pad, frame_size, frame_step, nth, filters, mel);
+    });
 
     // clamping and normalization
     double mmax = -1e20;
@@ -3381,10 +4521,23 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
         return nullptr;
     }
 
+    // the heads are views into the caches, so a quantized block must not span two heads
+    {
+        const int n_state_head = ctx->model.hparams.n_text_state/ctx->model.hparams.n_text_head;
+
+        for (auto type : { ctx->params.type_k, ctx->params.type_v }) {
+            if (n_state_head % wsp_ggml_blck_size(type) != 0) {
+                WHISPER_LOG_ERROR("%s: KV cache type %s does not fit the head size %d\n", __func__, wsp_ggml_type_name(type), n_state_head);
+                whisper_free_state(state);
+                return nullptr;
+            }
+        }
+    }
+
     // at this point, we don't know yet how many decoders will be used
     // later during decoding, if more decoders are used, we will recreate the KV cache respectively
     state->kv_self_n_dec = 1;
-    if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->itype,
+    if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->params.type_k, ctx->params.type_v,
                 ctx->model.hparams.n_text_state,
                 ctx->model.hparams.n_text_layer,
                 WSP_GGML_PAD(ctx->model.hparams.n_text_ctx, 256))) {
@@ -3395,10 +4548,11 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
 
     {
         const size_t memory_size = wsp_ggml_nbytes(state->kv_self.k) + wsp_ggml_nbytes(state->kv_self.v);
-        WHISPER_LOG_INFO("%s: kv self size  = %7.2f MB\n", __func__, memory_size / 1e6);
+        WHISPER_LOG_INFO("%s: kv self size  = %7.2f MB (K %s, V %s)\n", __func__, memory_size / 1e6,
+                wsp_ggml_type_name(state->kv_self.k->type), wsp_ggml_type_name(state->kv_self.v->type));
     }
 
-    if (!whisper_kv_cache_init(state->kv_cross, state->backends[0], ctx->itype,
+    if (!whisper_kv_cache_init(state->kv_cross, state->backends[0], ctx->params.type_k, ctx->params.type_v,
                 ctx->model.hparams.n_text_state,
                 ctx->model.hparams.n_text_layer,
                 WSP_GGML_PAD(ctx->model.hparams.n_audio_ctx, 256))) {
@@ -3409,10 +4563,11 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
 
     {
         const size_t memory_size = wsp_ggml_nbytes(state->kv_cross.k) + wsp_ggml_nbytes(state->kv_cross.v);
-        WHISPER_LOG_INFO("%s: kv cross size = %7.2f MB\n", __func__, memory_size / 1e6);
+        WHISPER_LOG_INFO("%s: kv cross size = %7.2f MB (K %s, V %s)\n", __func__, memory_size / 1e6,
+                wsp_ggml_type_name(state->kv_cross.k->type), wsp_ggml_type_name(state->kv_cross.v->type));
     }
 
-    if (!whisper_kv_cache_init(state->kv_pad, state->backends[0], ctx->itype,
+    if (!whisper_kv_cache_init(state->kv_pad, state->backends[0], ctx->itype, ctx->itype,
                 ctx->model.hparams.n_audio_state,
                 1,
                 WSP_GGML_PAD(ctx->model.hparams.n_audio_ctx, 256))) {
@@ -3435,6 +4590,29 @@ struct whisper_state * whisper_init_state(whisper_context * ctx) {
         }
         const size_t memory_size = aheads_masks_nbytes(state->aheads_masks);
         WHISPER_LOG_INFO("%s: alignment heads masks size = %zu B\n", __func__, memory_size);
+
+        int n_heads = 0;
+        for (const auto * m : state->aheads_masks.m) {
+            n_heads += m ? m->ne[1] : 0;
+        }
+
+        // the decoding of a window stops after n_text_ctx/2 - 4 tokens, the sot sequence adds at most 4 rows
+        const size_t dtw_size = whisper_dtw_mem_size(ctx->model.hparams.n_text_ctx/2, ctx->model.hparams.n_audio_ctx, n_heads);
+
+        struct wsp_ggml_init_params dtw_params = {
+            /*.mem_size   =*/ dtw_size,
+            /*.mem_buffer =*/ NULL,
+            /*.no_alloc   =*/ false,
+        };
+
+        state->dtw_ctx     = wsp_ggml_init(dtw_params);
+        state->dtw_backend = wsp_ggml_backend_init_by_type(WSP_GGML_BACKEND_DEVICE_TYPE_CPU, nullptr);
+        if (!state->dtw_ctx || !state->dtw_backend) {
+            WHISPER_LOG_ERROR("%s: failed to allocate the DTW scratch\n", __func__);
+            whisper_free_state(state);
+            return nullptr;
+        }
+        WHISPER_LOG_INFO("%s: dtw scratch size     = %7.2f MB\n", __func__, dtw_size / 1e6);
     }
 
 
@@ -3621,12 +4799,64 @@ struct whisper_context_params whisper_context_default_params() {
             /*.heads            =*/ NULL,
         },
         /*.dtw_mem_size         =*/ 1024*1024*128,
+
+        /*.kv_cross_cache_size  =*/ 0,
+
+        /*.type_k               =*/ WSP_GGML_TYPE_F16,
+        /*.type_v               =*/ WSP_GGML_TYPE_F16,
+
+        /*.use_extra_bufts      =*/ true,
+
+        /*.use_mmap             =*/ true,
     };
     return result;
 }
 
+static struct whisper_context * whisper_init_with_params_no_state_impl(
+        struct whisper_model_loader * loader,
+        struct whisper_context_params params,
+        std::shared_ptr<whisper_mmap> mapping);
+
 struct whisper_context * whisper_init_from_file_with_params_no_state(const char * path_model, struct whisper_context_params params) {
     WHISPER_LOG_INFO("%s: loading model from '%s'\n", __func__, path_model);
+
+    if (params.use_mmap) {
+        auto mapping = whisper_mmap_init(path_model);
+        if (mapping) {
+            whisper_model_loader loader = {};
+
+            loader.context = mapping.get();
+
+            loader.read = [](void * ctx, void * output, size_t read_size) {
+                whisper_mmap * mapping = reinterpret_cast<whisper_mmap *>(ctx);
+
+                const size_t size_to_copy = std::min(read_size, mapping->size - mapping->pos);
+
+                memcpy(output, (const char *) mapping->addr + mapping->pos, size_to_copy);
+                mapping->pos += size_to_copy;
+
+                return size_to_copy;
+            };
+
+            loader.eof = [](void * ctx) {
+                whisper_mmap * mapping = reinterpret_cast<whisper_mmap *>(ctx);
+
+                return mapping->pos >= mapping->size;
+            };
+
+            loader.close = [](void * /*ctx*/) { };
+
+            auto ctx = whisper_init_with_params_no_state_impl(&loader, params, std::move(mapping));
+
+            if (ctx) {
+                ctx->path_model = path_model;
+            }
+
+            return ctx;
+        }
+
+        WHISPER_LOG_WARN("%s: failed to map '%s', reading it instead\n", __func__, path_model);
+    }
 #ifdef _MSC_VER
     // Convert UTF-8 path to wide string (UTF-16) for Windows, resolving character encoding issues.
     std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
@@ -3707,22 +4937,49 @@ struct whisper_context * whisper_init_from_buffer_with_params_no_state(void * bu
 }
 
 struct whisper_context * whisper_init_with_params_no_state(struct whisper_model_loader * loader, struct whisper_context_params params) {
-    wsp_ggml_time_init();
+    return whisper_init_with_params_no_state_impl(loader, params, nullptr);
+}
 
+// disable the combinations of state params that are not supported
+static void whisper_context_params_check(struct whisper_context_params & params) {
     if (params.flash_attn && params.dtw_token_timestamps) {
         WHISPER_LOG_WARN("%s: dtw_token_timestamps is not supported with flash_attn - disabling\n", __func__);
         params.dtw_token_timestamps = false;
     }
 
+    for (auto * type : { &params.type_k, &params.type_v }) {
+        if (*type != WSP_GGML_TYPE_F16 && *type != WSP_GGML_TYPE_F32 && *type != WSP_GGML_TYPE_Q8_0 && *type != WSP_GGML_TYPE_Q4_0) {
+            WHISPER_LOG_WARN("%s: KV cache type %s is not supported - using f16\n", __func__, wsp_ggml_type_name(*type));
+            *type = WSP_GGML_TYPE_F16;
+        }
+    }
+
+    // without flash attention the V cache is transposed, which cannot be stored in blocks
+    if (!params.flash_attn && wsp_ggml_is_quantized(params.type_v)) {
+        WHISPER_LOG_WARN("%s: quantized V cache requires flash_attn - using f16\n", __func__);
+        params.type_v = WSP_GGML_TYPE_F16;
+    }
+}
+
+static struct whisper_context * whisper_init_with_params_no_state_impl(
+        struct whisper_model_loader * loader,
+        struct whisper_context_params params,
+        std::shared_ptr<whisper_mmap> mapping) {
+    wsp_ggml_time_init();
+
+    whisper_context_params_check(params);
+
     WHISPER_LOG_INFO("%s: use gpu    = %d\n", __func__, params.use_gpu);
     WHISPER_LOG_INFO("%s: flash attn = %d\n", __func__, params.flash_attn);
     WHISPER_LOG_INFO("%s: gpu_device = %d\n", __func__, params.gpu_device);
     WHISPER_LOG_INFO("%s: dtw        = %d\n", __func__, params.dtw_token_timestamps);
+    WHISPER_LOG_INFO("%s: kv type    = %s / %s\n", __func__, wsp_ggml_type_name(params.type_k), wsp_ggml_type_name(params.type_v));
     WHISPER_LOG_INFO("%s: devices    = %zu\n", __func__, wsp_ggml_backend_dev_count());
     WHISPER_LOG_INFO("%s: backends   = %zu\n", __func__, wsp_ggml_backend_reg_count());
 
     whisper_context * ctx = new whisper_context;
     ctx->params = params;
+    ctx->model.mapping = std::move(mapping);
 
     if (!whisper_model_load(loader, *ctx)) {
         loader->close(loader->context);
@@ -3781,6 +5038,61 @@ struct whisper_context * whisper_init_with_params(struct whisper_model_loader *
     return ctx;
 }
 
+struct whisper_context * whisper_init_from_context_with_params_no_state(struct whisper_context * src, struct whisper_context_params params) {
+    if (!src->model.weights) {
+        WHISPER_LOG_ERROR("%s: the source context has no model loaded\n", __func__);
+        return nullptr;
+    }
+
+    // the params that decide where the weights and the encoder live are the ones the weights were loaded with
+    params.use_gpu         = src->params.use_gpu;
+    params.use_coreml      = src->params.use_coreml;
+    params.use_mmap        = src->params.use_mmap;
+    params.gpu_device      = src->params.gpu_device;
+    params.use_extra_bufts = src->params.use_extra_bufts;
+
+    whisper_context_params_check(params);
+
+    whisper_context * ctx = new whisper_context;
+
+    ctx->t_start_us = wsp_ggml_time_us();
+
+    ctx->wtype      = src->wtype;
+    ctx->itype      = src->itype;
+    ctx->params     = params;
+    ctx->model      = src->model;
+    ctx->vocab      = src->vocab;
+    ctx->path_model = src->path_model;
+
+    // the loader state of the mapping is not needed anymore
+    ctx->model.mapping.reset();
+
+    return ctx;
+}
+
+struct whisper_context * whisper_init_from_context_no_state(struct whisper_context * src) {
+    return whisper_init_from_context_with_params_no_state(src, src->params);
+}
+
+struct whisper_context * whisper_init_from_context_with_params(struct whisper_context * src, struct whisper_context_params params) {
+    whisper_context * ctx = whisper_init_from_context_with_params_no_state(src, params);
+    if (!ctx) {
+        return nullptr;
+    }
+
+    ctx->state = whisper_init_state(ctx);
+    if (!ctx->state) {
+        whisper_free(ctx);
+        return nullptr;
+    }
+
+    return ctx;
+}
+
+struct whisper_context * whisper_init_from_context(struct whisper_context * src) {
+    return whisper_init_from_context_with_params(src, src->params);
+}
+
 struct whisper_context * whisper_init_from_file(const char * path_model) {
     return whisper_init_from_file_with_params(path_model, whisper_context_default_params());
 }
@@ -3838,6 +5150,8 @@ void whisper_free_state(struct whisper_state * state) {
 
         // [EXPERIMENTAL] Token-level timestamps with DTW
         aheads_masks_free(state->aheads_masks);
+        wsp_ggml_free(state->dtw_ctx);
+        wsp_ggml_backend_free(state->dtw_backend);
 
         if (state->vad_context != nullptr) {
             whisper_vad_free(state->vad_context);
@@ -3850,17 +5164,81 @@ void whisper_free_state(struct whisper_state * state) {
 
 void whisper_free(struct whisper_context * ctx) {
     if (ctx) {
-        for (wsp_ggml_context * context : ctx->model.ctxs) {
-            wsp_ggml_free(context);
+        // the weights are freed with the last context that uses them
+        whisper_free_state(ctx->state);
+
+        for (whisper_state * state : ctx->state_pool) {
+            whisper_free_state(state);
         }
 
-        for (wsp_ggml_backend_buffer_t buf : ctx->model.buffers) {
-            wsp_ggml_backend_buffer_free(buf);
+        delete ctx;
+    }
+}
+
+// take an idle state from the pool of the context or create a new one
+static whisper_state * whisper_state_pool_acquire(struct whisper_context * ctx) {
+    {
+        std::lock_guard<std::mutex> lock(ctx->state_pool_mutex);
+        if (!ctx->state_pool.empty()) {
+            whisper_state * state = ctx->state_pool.back();
+            ctx->state_pool.pop_back();
+            return state;
         }
+    }
 
-        whisper_free_state(ctx->state);
+    return whisper_init_state(ctx);
+}
 
-        delete ctx;
+// return a state to the pool, clearing what is left from its last use
+static void whisper_state_pool_release(struct whisper_context * ctx, struct whisper_state * state) {
+    state->t_mel_us    = 0;
+    state->t_sample_us = 0;
+    state->t_encode_us = 0;
+    state->t_decode_us = 0;
+    state->t_batchd_us = 0;
+    state->t_prompt_us = 0;
+    state->n_sample    = 0;
+    state->n_encode    = 0;
+    state->n_decode    = 0;
+    state->n_batchd    = 0;
+    state->n_prompt    = 0;
+
+    state->result_all.clear();
+    state->prompt_past0.clear();
+    state->prompt_past1.clear();
+
+    std::lock_guard<std::mutex> lock(ctx->state_pool_mutex);
+    ctx->state_pool.push_back(state);
+}
+
+int whisper_state_pool_reserve(struct whisper_context * ctx, int n_states) {
+    std::lock_guard<std::mutex> lock(ctx->state_pool_mutex);
+
+    while ((int) ctx->state_pool.size() < n_states) {
+        whisper_state * state = whisper_init_state(ctx);
+        if (state == nullptr) {
+            WHISPER_LOG_ERROR("%s: failed to create state %d/%d\n", __func__, (int) ctx->state_pool.size() + 1, n_states);
+            return -1;
+        }
+        ctx->state_pool.push_back(state);
+    }
+
+    return ctx->state_pool.size();
+}
+
+void whisper_state_pool_trim(struct whisper_context * ctx, int n_keep) {
+    std::vector<whisper_state *> states;
+
+    {
+        std::lock_guard<std::mutex> lock(ctx->state_pool_mutex);
+        while ((int) ctx->state_pool.size() > std::max(0, n_keep)) {
+            states.push_back(ctx->state_pool.back());
+            ctx->state_pool.pop_back();
+        }
+    }
+
+    for (whisper_state * state : states) {
+        whisper_free_state(state);
     }
 }
 
@@ -3877,6 +5255,8 @@ void whisper_free_params(struct whisper_full_params * params) {
 }
 
 int whisper_pcm_to_mel_with_state(struct whisper_context * ctx, struct whisper_state * state, const float * samples, int n_samples, int n_threads) {
+    state->mel_stream = {};
+
     if (!log_mel_spectrogram(*state, samples, n_samples, WHISPER_SAMPLE_RATE, WHISPER_N_FFT, WHISPER_HOP_LENGTH, ctx->model.filters.n_mel, n_threads, ctx->model.filters, false, state->mel)) {
         WHISPER_LOG_ERROR("%s: failed to compute mel spectrogram\n", __func__);
         return -1;
@@ -3889,6 +5269,132 @@ int whisper_pcm_to_mel(struct whisper_context * ctx, const float * samples, int
     return whisper_pcm_to_mel_with_state(ctx, ctx->state, samples, n_samples, n_threads);
 }
 
+static void whisper_mel_stream_worker_thread(int ith, int n_threads, const float * hann, const float * pcm, int64_t pcm_offset,
+                                             int64_t n_padded, int i0, int i1, const whisper_filters & filters, float * out) {
+    std::vector<float> fft_in(WHISPER_N_FFT, 0.0);
+    std::vector<float> fft_out((WHISPER_N_FFT / 2 + 1) * 2);
+    std::vector<float> fft_work(WHISPER_N_FFT * 2);
+
+    for (int i = i0 + ith; i < i1; i += n_threads) {
+        const int64_t offset = (int64_t) i*WHISPER_HOP_LENGTH;
+
+        log_mel_spectrogram_frame(hann, pcm + (offset - pcm_offset), (int) std::min<int64_t>(n_padded - offset, WHISPER_N_FFT), WHISPER_N_FFT,
+                                  filters, filters.n_mel, fft_in.data(), fft_out.data(), fft_work.data(),
+                                  out + (size_t) (i - i0)*filters.n_mel, 1);
+    }
+}
+
+int whisper_mel_stream_push_with_state(struct whisper_context * ctx, struct whisper_state * state, const float * samples, int n_samples, int n_threads) {
+    if (n_samples < 0) {
+        WHISPER_LOG_ERROR("%s: invalid number of samples: %d\n", __func__, n_samples);
+        return -1;
+    }
+
+    const int64_t t_start_us = wsp_ggml_time_us();
+
+    const whisper_filters & filters = ctx->model.filters;
+    const float * hann = global_cache.hann_window;
+
+    const int frame_size = WHISPER_N_FFT;
+    const int frame_step = WHISPER_HOP_LENGTH;
+    const int pad        = frame_size / 2;
+    const int n_mel      = filters.n_mel;
+
+    auto & stream = state->mel_stream;
+
+    if (!stream.active) {
+        stream = {};
+        stream.active = true;
+    }
+
+    const int64_t n_prev = stream.n_samples;
+
+    stream.n_samples += n_samples;
+    stream.pcm.insert(stream.pcm.end(), samples, samples + n_samples);
+
+    // reflective pad at the beginning of the audio, same as log_mel_spectrogram()
+    if (n_prev <= pad && stream.n_samples > pad) {
+        std::vector<float> padded(pad + stream.pcm.size());
+        std::reverse_copy(stream.pcm.begin() + 1, stream.pcm.begin() + 1 + pad, padded.begin());
+        std::copy(stream.pcm.begin(), stream.pcm.end(), padded.begin() + pad);
+
+        stream.pcm        = std::move(padded);
+        stream.pcm_offset = 0;
+    }
+
+    int n_complete = 0;
+
+    if (stream.n_samples > pad) {
+        const int64_t n_padded = pad + stream.n_samples; // end of the audio in the padded signal
+
+        n_complete = (stream.n_samples - pad) / frame_step + 1;
+
+        // frames that are fully covered by the audio, only the new ones are computed
+        const int n_new = n_complete - stream.n_frames;
+        if (n_new > 0) {
+            stream.frames.resize((size_t) (n_complete - stream.n_dropped)*n_mel);
+
+            const int n_workers = std::max(1, std::min(n_threads, n_new));
+            float * out = stream.frames.data() + (size_t) (stream.n_frames - stream.n_dropped)*n_mel;
+
+            state->workers.run(n_workers, [&](int ith, int nth) {
+                whisper_mel_stream_worker_thread(ith, nth, hann, stream.pcm.data(), stream.pcm_offset, n_padded, stream.n_frames, n_complete, filters, out);
+            });
+
+            stream.n_frames = n_complete;
+
+            // keep a single encoder window of complete frames, the tail frames cover the overlap with the end of the audio
+            const int n_keep = 2*ctx->model.hparams.n_audio_ctx;
+            if (stream.n_frames - stream.n_dropped > n_keep) {
+                const int n_drop = stream.n_frames - stream.n_dropped - n_keep;
+
+                stream.frames.erase(stream.frames.begin(), stream.frames.begin() + (size_t) n_drop*n_mel);
+                stream.n_dropped += n_drop;
+            }
+        }
+
+        // frames that overlap the end of the audio are recomputed on every push
+        const int n_end = (int) (n_padded / frame_step) + 1;
+
+        stream.n_tail = n_end - n_complete;
+        stream.tail.resize((size_t) stream.n_tail*n_mel);
+        whisper_mel_stream_worker_thread(0, 1, hann, stream.pcm.data(), stream.pcm_offset, n_padded, n_complete, n_end, filters, stream.tail.data());
+
+        // drop the samples that are not needed by the next frames
+        const int64_t n_drop = (int64_t) n_complete*frame_step - stream.pcm_offset;
+        if (n_drop > 0) {
+            stream.pcm.erase(stream.pcm.begin(), stream.pcm.begin() + n_drop);
+            stream.pcm_offset += n_drop;
+        }
+    }
+
+    // expose the same lengths as log_mel_spectrogram() would for the whole audio
+    state->mel.n_mel     = n_mel;
+    state->mel.n_len     = (stream.n_samples + WHISPER_SAMPLE_RATE * 30) / frame_step;
+    state->mel.n_len_org = n_complete;
+    state->mel.data.clear();
+
+    state->t_mel_us += wsp_ggml_time_us() - t_start_us;
+
+    return 0;
+}
+
+int whisper_mel_stream_push(struct whisper_context * ctx, const float * samples, int n_samples, int n_threads) {
+    return whisper_mel_stream_push_with_state(ctx, ctx->state, samples, n_samples, n_threads);
+}
+
+void whisper_mel_stream_reset_with_state(struct whisper_context * /*ctx*/, struct whisper_state * state) {
+    state->mel_stream = {};
+
+    state->mel.n_len     = 0;
+    state->mel.n_len_org = 0;
+    state->mel.data.clear();
+}
+
+void whisper_mel_stream_reset(struct whisper_context * ctx) {
+    whisper_mel_stream_reset_with_state(ctx, ctx->state);
+}
+
 int whisper_set_mel_with_state(
         struct whisper_context * ctx,
           struct whisper_state * state,
@@ -3900,6 +5406,8 @@ int whisper_set_mel_with_state(
         return -1;
     }
 
+    state->mel_stream = {};
+
     state->mel.n_len     = n_len;
     state->mel.n_len_org = n_len;
     state->mel.n_mel     = n_mel;
@@ -4256,6 +5764,8 @@ struct whisper_timings * whisper_get_timings(struct whisper_context * ctx) {
     timings->decode_ms = 1e-3f * ctx->state->t_decode_us / std::max(1, ctx->state->n_decode);
     timings->batchd_ms = 1e-3f * ctx->state->t_batchd_us / std::max(1, ctx->state->n_batchd);
     timings->prompt_ms = 1e-3f * ctx->state->t_prompt_us / std::max(1, ctx->state->n_prompt);
+    timings->kv_cross_cache_hits   = ctx->state->n_kv_cross_hit;
+    timings->kv_cross_cache_misses = ctx->state->n_kv_cross_miss;
     return timings;
 }
 
@@ -4279,6 +5789,9 @@ void whisper_print_timings(struct whisper_context * ctx) {
         WHISPER_LOG_INFO("%s:   decode time = %8.2f ms / %5d runs ( %8.2f ms per run)\n", __func__, 1e-3f * ctx->state->t_decode_us, n_decode, 1e-3f * ctx->state->t_decode_us / n_decode);
         WHISPER_LOG_INFO("%s:   batchd time = %8.2f ms / %5d runs ( %8.2f ms per run)\n", __func__, 1e-3f * ctx->state->t_batchd_us, n_batchd, 1e-3f * ctx->state->t_batchd_us / n_batchd);
         WHISPER_LOG_INFO("%s:   prompt time = %8.2f ms / %5d runs ( %8.2f ms per run)\n", __func__, 1e-3f * ctx->state->t_prompt_us, n_prompt, 1e-3f * ctx->state->t_prompt_us / n_prompt);
+        if (ctx->params.kv_cross_cache_size > 0) {
+            WHISPER_LOG_INFO("%s: kv cross cache = %5d hits / %5d misses\n", __func__, ctx->state->n_kv_cross_hit, ctx->state->n_kv_cross_miss);
+        }
     }
     WHISPER_LOG_INFO("%s:    total time = %8.2f ms\n", __func__, (t_end_us - ctx->t_start_us)/1000.0f);
 }
@@ -4297,6 +5810,8 @@ void whisper_reset_timings(struct whisper_context * ctx) {
         ctx->state->n_decode = 0;
         ctx->state->n_batchd = 0;
         ctx->state->n_prompt = 0;
+        ctx->state->n_kv_cross_hit  = 0;
+        ctx->state->n_kv_cross_miss = 0;
     }
 }
 
@@ -4410,6 +5925,28 @@ struct whisper_vad_segments {
     std::vector<whisper_vad_segment> data;
 };
 
+struct whisper_vad_stream_event {
+    bool    start; // speech started (true) or ended (false)
+    int64_t t;     // sample offset from the start of the stream
+};
+
+// state of the streaming VAD - the LSTM state lives in the h_state/c_state tensors of the context
+struct whisper_vad_stream {
+    // samples that do not fill a whole window yet
+    std::vector<float> pcm;
+
+    // number of windows evaluated since the last reset
+    int64_t n_windows = 0;
+
+    bool    triggered    = false; // the probability went above the threshold
+    bool    speech       = false; // the speech start event has been emitted
+    int64_t speech_start = 0;
+    int64_t temp_end     = -1;    // start of the current silence, -1 if none
+
+    // events emitted by the last push
+    std::vector<whisper_vad_stream_event> events;
+};
+
 struct whisper_vad_context {
     int64_t t_vad_us = 0;
 
@@ -4422,12 +5959,15 @@ struct whisper_vad_context {
     whisper_context_params      params;
     std::vector<uint8_t>        ctx_buf;
     whisper_sched               sched;
+    whisper_cpu_threadpool      threadpool;
 
     whisper_vad_model    model;
     std::string          path_model;
     struct wsp_ggml_tensor * h_state;
     struct wsp_ggml_tensor * c_state;
     std::vector<float>   probs;
+
+    whisper_vad_stream   stream;
 };
 
 struct whisper_vad_context_params whisper_vad_default_context_params(void) {
@@ -4520,20 +6060,36 @@ static wsp_ggml_backend_buffer_type_t select_weight_buft(const whisper_vad_hpara
     return nullptr;
 }
 
+// wsp_ggml_conv_1d lays out its result as [OL, n_batch, OC] when the input holds several signals,
+// permute it back to [OL, OC, n_batch] so that the windows can be batched through the VAD encoder
+static wsp_ggml_tensor * whisper_vad_conv_1d(wsp_ggml_context * ctx0,
+        wsp_ggml_tensor * kernel, wsp_ggml_tensor * cur, int s0, int p0, int d0) {
+    wsp_ggml_tensor * res = wsp_ggml_conv_1d(ctx0, kernel, cur, s0, p0, d0);
+    if (res->ne[2] == 1) {
+        return res;
+    }
+
+    res = wsp_ggml_reshape_3d(ctx0, res, res->ne[0], res->ne[2], res->ne[1]);
+    return wsp_ggml_cont(ctx0, wsp_ggml_permute(ctx0, res, 0, 2, 1, 3));
+}
+
 static wsp_ggml_tensor * whisper_vad_build_stft_layer(wsp_ggml_context * ctx0,
         const whisper_vad_model & model, wsp_ggml_tensor * cur) {
     // Apply reflective padding to the input tensor
     wsp_ggml_tensor * padded = wsp_ggml_pad_reflect_1d(ctx0, cur, 64, 64);
 
-    struct wsp_ggml_tensor * stft = wsp_ggml_conv_1d(ctx0, model.stft_forward_basis, padded, model.hparams.lstm_input_size, 0, 1);
+    // one single-channel signal per window: [n_window + 128, 1, n_batch]
+    padded = wsp_ggml_reshape_3d(ctx0, padded, padded->ne[0], 1, padded->ne[1]);
+
+    struct wsp_ggml_tensor * stft = whisper_vad_conv_1d(ctx0, model.stft_forward_basis, padded, model.hparams.lstm_input_size, 0, 1);
 
     // Calculate cutoff for real/imaginary parts
     int cutoff = model.stft_forward_basis->ne[2] / 2;
 
     // Extract real part (first half of the STFT output).
-    struct wsp_ggml_tensor * real_part = wsp_ggml_view_2d(ctx0, stft, 4, cutoff, stft->nb[1], 0);
+    struct wsp_ggml_tensor * real_part = wsp_ggml_view_3d(ctx0, stft, 4, cutoff, stft->ne[2], stft->nb[1], stft->nb[2], 0);
     // Extract imaginary part (second half of the STFT output).
-    struct wsp_ggml_tensor * img_part = wsp_ggml_view_2d(ctx0, stft, 4, cutoff, stft->nb[1], cutoff * stft->nb[1]);
+    struct wsp_ggml_tensor * img_part = wsp_ggml_view_3d(ctx0, stft, 4, cutoff, stft->ne[2], stft->nb[1], stft->nb[2], cutoff * stft->nb[1]);
 
     // Calculate magnitude: sqrt(real^2 + imag^2)
     struct wsp_ggml_tensor * real_squared = wsp_ggml_mul(ctx0, real_part, real_part);
@@ -4546,74 +6102,90 @@ static wsp_ggml_tensor * whisper_vad_build_stft_layer(wsp_ggml_context * ctx0,
 static wsp_ggml_tensor * whisper_vad_build_encoder_layer(wsp_ggml_context * ctx0,
         const whisper_vad_model & model, wsp_ggml_tensor * cur) {
     // First Conv1D: expands to 128 channels.
-    cur = wsp_ggml_conv_1d(ctx0, model.encoder_0_weight, cur, 1, 1, 1);
+    cur = whisper_vad_conv_1d(ctx0, model.encoder_0_weight, cur, 1, 1, 1);
     cur = wsp_ggml_add(ctx0, cur, wsp_ggml_reshape_3d(ctx0, model.encoder_0_bias, 1, 128, 1));
     cur = wsp_ggml_relu(ctx0, cur);
 
     // Second Conv1D: reduces to 64 channels.
-    cur = wsp_ggml_conv_1d(ctx0, model.encoder_1_weight, cur, 2, 1, 1);
+    cur = whisper_vad_conv_1d(ctx0, model.encoder_1_weight, cur, 2, 1, 1);
     cur = wsp_ggml_add(ctx0, cur, wsp_ggml_reshape_3d(ctx0, model.encoder_1_bias, 1, 64, 1));
     cur = wsp_ggml_relu(ctx0, cur);
 
     // Third Conv1D: maintains 64 channels
-    cur = wsp_ggml_conv_1d(ctx0, model.encoder_2_weight, cur, 2, 1, 1);
+    cur = whisper_vad_conv_1d(ctx0, model.encoder_2_weight, cur, 2, 1, 1);
     cur = wsp_ggml_add(ctx0, cur, wsp_ggml_reshape_3d(ctx0, model.encoder_2_bias, 1, 64, 1));
     cur = wsp_ggml_relu(ctx0, cur);
 
     // Fourth Conv1D: expands to 128 channels
-    cur = wsp_ggml_conv_1d(ctx0, model.encoder_3_weight, cur, 1, 1, 1);
+    cur = whisper_vad_conv_1d(ctx0, model.encoder_3_weight, cur, 1, 1, 1);
     cur = wsp_ggml_add(ctx0, cur, wsp_ggml_reshape_3d(ctx0, model.encoder_3_bias, 1, 128, 1));
     cur = wsp_ggml_relu(ctx0, cur);
 
     return cur;
 }
 
+// cur: [lstm_input_size, n_batch] - the encoder output of n_batch consecutive windows
+// the input-to-hidden projection is done for all windows at once, only the recurrence is evaluated step by step
+// returns the hidden states of all the steps: [lstm_hidden_size, n_batch]
 static wsp_ggml_tensor * whisper_vad_build_lstm_layer(wsp_ggml_context * ctx0,
         const whisper_vad_context & vctx, wsp_ggml_tensor * cur, wsp_ggml_cgraph * gf) {
     const whisper_vad_model & model = vctx.model;
-    const int hdim = model.hparams.lstm_hidden_size;
-
-    struct wsp_ggml_tensor * x_t = wsp_ggml_transpose(ctx0, cur);
+    const int hdim    = model.hparams.lstm_hidden_size;
+    const int n_batch = cur->ne[1];
 
     // Create operations using the input-to-hidden weights.
-    struct wsp_ggml_tensor * inp_gate = wsp_ggml_mul_mat(ctx0, model.lstm_ih_weight, x_t);
-    inp_gate = wsp_ggml_add(ctx0, inp_gate, model.lstm_ih_bias);
+    struct wsp_ggml_tensor * inp_gate_all = wsp_ggml_mul_mat(ctx0, model.lstm_ih_weight, cur);
+    inp_gate_all = wsp_ggml_add(ctx0, inp_gate_all, model.lstm_ih_bias);
+
+    struct wsp_ggml_tensor * out_all = wsp_ggml_new_tensor_2d(ctx0, WSP_GGML_TYPE_F32, hdim, n_batch);
+
+    struct wsp_ggml_tensor * h_t = vctx.h_state;
+    struct wsp_ggml_tensor * c_t = vctx.c_state;
+
+    for (int t = 0; t < n_batch; ++t) {
+        struct wsp_ggml_tensor * inp_gate = wsp_ggml_view_1d(ctx0, inp_gate_all, inp_gate_all->ne[0], t*inp_gate_all->nb[1]);
+
+        // Create operations using the hidden-to-hidden weights.
+        struct wsp_ggml_tensor * hid_gate = wsp_ggml_mul_mat(ctx0, model.lstm_hh_weight, h_t);
+        hid_gate = wsp_ggml_add(ctx0, hid_gate, model.lstm_hh_bias);
+
+        // Create add operation to get preactivations for all gates.
+        struct wsp_ggml_tensor * out_gate = wsp_ggml_add(ctx0, inp_gate, hid_gate);
 
-    // Create operations using the hidden-to-hidden weights.
-    struct wsp_ggml_tensor * hid_gate = wsp_ggml_mul_mat(ctx0, model.lstm_hh_weight, vctx.h_state);
-    hid_gate = wsp_ggml_add(ctx0, hid_gate, model.lstm_hh_bias);
+        const size_t hdim_size = wsp_ggml_row_size(out_gate->type, hdim);
 
-    // Create add operation to get preactivations for all gates.
-    struct wsp_ggml_tensor * out_gate = wsp_ggml_add(ctx0, inp_gate, hid_gate);
+        // Create sigmoid for input gate (using the first 128 bytes from the preactivations).
+        struct wsp_ggml_tensor * i_t = wsp_ggml_sigmoid(ctx0, wsp_ggml_view_1d(ctx0, out_gate, hdim, 0 * hdim_size));
 
-    const size_t hdim_size = wsp_ggml_row_size(out_gate->type, hdim);
+        // Create sigmoid for the forget gate (using the second 128 bytes from the preactivations).
+        struct wsp_ggml_tensor * f_t = wsp_ggml_sigmoid(ctx0, wsp_ggml_view_1d(ctx0, out_gate, hdim, 1 * hdim_size));
 
-    // Create sigmoid for input gate (using the first 128 bytes from the preactivations).
-    struct wsp_ggml_tensor * i_t = wsp_ggml_sigmoid(ctx0, wsp_ggml_view_1d(ctx0, out_gate, hdim, 0 * hdim_size));
+        // Create sigmoid for the cell gate (using the third 128 bytes from the preactivations).
+        struct wsp_ggml_tensor * g_t = wsp_ggml_tanh(ctx0, wsp_ggml_view_1d(ctx0, out_gate, hdim, 2 * hdim_size));
 
-    // Create sigmoid for the forget gate (using the second 128 bytes from the preactivations).
-    struct wsp_ggml_tensor * f_t = wsp_ggml_sigmoid(ctx0, wsp_ggml_view_1d(ctx0, out_gate, hdim, 1 * hdim_size));
+        // Create sigmoid for the output gate (using the fourth 128 bytes from the preactivations).
+        struct wsp_ggml_tensor * o_t = wsp_ggml_sigmoid(ctx0, wsp_ggml_view_1d(ctx0, out_gate, hdim, 3 * hdim_size));
 
-    // Create sigmoid for the cell gate (using the third 128 bytes from the preactivations).
-    struct wsp_ggml_tensor * g_t = wsp_ggml_tanh(ctx0, wsp_ggml_view_1d(ctx0, out_gate, hdim, 2 * hdim_size));
+        // Update cell state
+        c_t = wsp_ggml_add(ctx0,
+            wsp_ggml_mul(ctx0, f_t, c_t),
+            wsp_ggml_mul(ctx0, i_t, g_t));
 
-    // Create sigmoid for the output gate (using the fourth 128 bytes from the preactivations).
-    struct wsp_ggml_tensor * o_t = wsp_ggml_sigmoid(ctx0, wsp_ggml_view_1d(ctx0, out_gate, hdim, 3 * hdim_size));
+        // Update hidden state
+        h_t = wsp_ggml_mul(ctx0, o_t, wsp_ggml_tanh(ctx0, c_t));
 
-    // Update cell state
-    struct wsp_ggml_tensor * c_out = wsp_ggml_add(ctx0,
-        wsp_ggml_mul(ctx0, f_t, vctx.c_state),
-        wsp_ggml_mul(ctx0, i_t, g_t));
-    wsp_ggml_build_forward_expand(gf, wsp_ggml_cpy(ctx0, c_out, vctx.c_state));
+        // the nodes are evaluated in order, so the copies are done before out_all is used
+        wsp_ggml_build_forward_expand(gf, wsp_ggml_cpy(ctx0, h_t, wsp_ggml_view_1d(ctx0, out_all, hdim, t*out_all->nb[1])));
+    }
 
-    // Update hidden state
-    struct wsp_ggml_tensor * out = wsp_ggml_mul(ctx0, o_t, wsp_ggml_tanh(ctx0, c_out));
-    wsp_ggml_build_forward_expand(gf, wsp_ggml_cpy(ctx0, out,   vctx.h_state));
+    wsp_ggml_build_forward_expand(gf, wsp_ggml_cpy(ctx0, c_t, vctx.c_state));
+    wsp_ggml_build_forward_expand(gf, wsp_ggml_cpy(ctx0, h_t, vctx.h_state));
 
-    return out;
+    return out_all;
 }
 
-static struct wsp_ggml_cgraph * whisper_vad_build_graph(whisper_vad_context & vctx) {
+// evaluates n_batch consecutive windows of n_window samples
+static struct wsp_ggml_cgraph * whisper_vad_build_graph(whisper_vad_context & vctx, int n_batch) {
     const auto & model = vctx.model;
 
     struct wsp_ggml_init_params params = {
@@ -4624,9 +6196,9 @@ static struct wsp_ggml_cgraph * whisper_vad_build_graph(whisper_vad_context & vc
 
     struct wsp_ggml_context * ctx0 = wsp_ggml_init(params);
 
-    wsp_ggml_cgraph * gf = wsp_ggml_new_graph(ctx0);
+    wsp_ggml_cgraph * gf = wsp_ggml_new_graph_custom(ctx0, WHISPER_MAX_NODES, false);
 
-    struct wsp_ggml_tensor * frame = wsp_ggml_new_tensor_2d(ctx0, WSP_GGML_TYPE_F32, vctx.n_window, 1);
+    struct wsp_ggml_tensor * frame = wsp_ggml_new_tensor_2d(ctx0, WSP_GGML_TYPE_F32, vctx.n_window, n_batch);
     wsp_ggml_set_name(frame, "frame");
     wsp_ggml_set_input(frame);
 
@@ -4636,13 +6208,16 @@ static struct wsp_ggml_cgraph * whisper_vad_build_graph(whisper_vad_context & vc
 
         cur = whisper_vad_build_encoder_layer(ctx0, model, cur);
 
-        // Extract the first element of the first dimension
+        // Extract the first element of the first dimension of each window
         // (equivalent to pytorch's [:, :, 0])
-        cur = wsp_ggml_view_2d(ctx0, cur, 1, 128, cur->nb[1], 0);
+        cur = wsp_ggml_view_3d(ctx0, cur, 1, cur->ne[1], n_batch, cur->nb[1], cur->nb[2], 0);
+        cur = wsp_ggml_reshape_2d(ctx0, wsp_ggml_cont(ctx0, cur), cur->ne[1], n_batch);
 
         cur = whisper_vad_build_lstm_layer(ctx0, vctx, cur, gf);
         cur = wsp_ggml_relu(ctx0, cur);
-        cur = wsp_ggml_conv_1d(ctx0, model.final_conv_weight, cur, 1, 0, 1);
+
+        // the final 1x1 convolution over the hidden state is a dot product per window
+        cur = wsp_ggml_mul_mat(ctx0, model.final_conv_weight, cur);
         cur = wsp_ggml_add(ctx0, cur, model.final_conv_bias);
         cur = wsp_ggml_sigmoid(ctx0, cur);
         wsp_ggml_set_name(cur, "prob");
@@ -4704,7 +6279,7 @@ static bool whisper_vad_init_context(whisper_vad_context * vctx) {
     {
         bool ok = whisper_sched_graph_init(vctx->sched, vctx->backends,
                 [&]() {
-                    return whisper_vad_build_graph(*vctx);
+                    return whisper_vad_build_graph(*vctx, WHISPER_VAD_MAX_BATCH);
                 });
 
         if (!ok) {
@@ -5106,60 +6681,54 @@ bool whisper_vad_detect_speech_no_reset(
     vctx->probs.resize(n_chunks);
     WHISPER_LOG_INFO("%s: props size: %u\n", __func__, n_chunks);
 
-    std::vector<float> window(vctx->n_window, 0.0f);
+    std::vector<float> windows((size_t) std::min(n_chunks, WHISPER_VAD_MAX_BATCH)*vctx->n_window, 0.0f);
 
     auto & sched = vctx->sched.sched;
 
-    wsp_ggml_cgraph * gf = whisper_vad_build_graph(*vctx);
-
-    if (!wsp_ggml_backend_sched_alloc_graph(sched, gf)) {
-        WHISPER_LOG_ERROR("%s: failed to allocate the compute buffer\n", __func__);
-        return false;
-    }
-
-    struct wsp_ggml_tensor * frame = wsp_ggml_graph_get_tensor(gf, "frame");
-    struct wsp_ggml_tensor * prob  = wsp_ggml_graph_get_tensor(gf, "prob");
-
-    // we are going to reuse the graph multiple times for each chunk
     const int64_t t_start_vad_us = wsp_ggml_time_us();
 
-    for (int i = 0; i < n_chunks; i++) {
-        const int idx_start = i * vctx->n_window;
-        const int idx_end = std::min(idx_start + vctx->n_window, n_samples);
+    // the windows are evaluated in batches - the graph is built once per batch size and reused
+    wsp_ggml_cgraph * gf = nullptr;
+    int n_batch_gf = 0;
 
-        const int chunk_len = idx_end - idx_start;
+    for (int i0 = 0; i0 < n_chunks; i0 += WHISPER_VAD_MAX_BATCH) {
+        const int n_batch = std::min(WHISPER_VAD_MAX_BATCH, n_chunks - i0);
+
+        if (n_batch != n_batch_gf) {
+            if (gf) {
+                wsp_ggml_backend_sched_reset(sched);
+            }
 
-        if (chunk_len < vctx->n_window) {
-            WHISPER_LOG_INFO("%s: chunk_len: %d < n_window: %d\n", __func__, chunk_len, vctx->n_window);
-            std::vector<float> partial_chunk(vctx->n_window, 0.0f);
-            std::copy(samples + idx_start, samples + idx_end, partial_chunk.begin());
+            gf = whisper_vad_build_graph(*vctx, n_batch);
+            n_batch_gf = n_batch;
 
-            // Copy the zero-padded chunk to the window.
-            const int samples_to_copy_max = vctx->n_window;
-            const int samples_to_copy_cur = std::min(samples_to_copy_max, (int)partial_chunk.size());
-            std::copy(partial_chunk.begin(), partial_chunk.begin() + samples_to_copy_cur, window.begin());
-            if (samples_to_copy_cur < samples_to_copy_max) {
-                std::fill(window.begin() + samples_to_copy_cur, window.end(), 0.0f);
+            if (!wsp_ggml_backend_sched_alloc_graph(sched, gf)) {
+                WHISPER_LOG_ERROR("%s: failed to allocate the compute buffer\n", __func__);
+                return false;
             }
-        } else {
-            // Copy current frame samples to the window.
-            const int samples_to_copy = std::min(idx_end - idx_start, vctx->n_window);
-            std::copy(samples + idx_start, samples + idx_start + samples_to_copy, window.begin());
         }
 
+        struct wsp_ggml_tensor * frame = wsp_ggml_graph_get_tensor(gf, "frame");
+        struct wsp_ggml_tensor * prob  = wsp_ggml_graph_get_tensor(gf, "prob");
+
+        // Copy the samples of the batch, zero-padding the last window if needed.
+        const int idx_start = i0 * vctx->n_window;
+        const int idx_end   = std::min(idx_start + n_batch * vctx->n_window, n_samples);
+
+        std::copy(samples + idx_start, samples + idx_end, windows.begin());
+        std::fill(windows.begin() + (idx_end - idx_start), windows.begin() + (size_t) n_batch*vctx->n_window, 0.0f);
+
         // Set the frame tensor data with the samples.
-        wsp_ggml_backend_tensor_set(frame, window.data(), 0, wsp_ggml_nelements(frame) * sizeof(float));
+        wsp_ggml_backend_tensor_set(frame, windows.data(), 0, wsp_ggml_nbytes(frame));
 
-        // do not reset the scheduler - we will reuse the graph in the next chunk
-        if (!wsp_ggml_graph_compute_helper(sched, gf, vctx->n_threads, false)) {
+        // do not reset the scheduler - we will reuse the graph in the next batch
+        if (!wsp_ggml_graph_compute_helper(sched, gf, vctx->n_threads, vctx->threadpool, false)) {
             WHISPER_LOG_ERROR("%s: failed to compute VAD graph\n", __func__);
             break;
         }
 
-        // Get the probability for this chunk.
-        wsp_ggml_backend_tensor_get(prob, &vctx->probs[i], 0, sizeof(float));
-
-        //WHISPER_LOG_DEBUG("chunk %d: p = %7.3f\n", i, probs[i]);
+        // Get the probabilities for the windows of this batch.
+        wsp_ggml_backend_tensor_get(prob, vctx->probs.data() + i0, 0, n_batch*sizeof(float));
     }
 
     vctx->t_vad_us += wsp_ggml_time_us() - t_start_vad_us;
@@ -5178,34 +6747,147 @@ bool whisper_vad_detect_speech(
     return whisper_vad_detect_speech_no_reset(vctx, samples, n_samples);
 }
 
-int whisper_vad_segments_n_segments(struct whisper_vad_segments * segments) {
-    return segments->data.size();
-}
+// advance the speech start/end hysteresis of the stream by one window
+// uses the same thresholds as whisper_vad_segments_from_probs, but decides as soon as the window is evaluated
+static void whisper_vad_stream_update(
+        whisper_vad_stream & stream,
+        const whisper_vad_params & params,
+        int n_window,
+        float prob) {
+    const int sample_rate = WHISPER_SAMPLE_RATE;
 
-float whisper_vad_segments_get_segment_t0(struct whisper_vad_segments * segments, int i_segment) {
-    return segments->data[i_segment].start;
-}
+    const int64_t min_speech_samples  = (int64_t) sample_rate * params.min_speech_duration_ms  / 1000;
+    const int64_t min_silence_samples = (int64_t) sample_rate * params.min_silence_duration_ms / 1000;
+    const int64_t speech_pad_samples  = (int64_t) sample_rate * params.speech_pad_ms           / 1000;
 
-float whisper_vad_segments_get_segment_t1(struct whisper_vad_segments * segments, int i_segment) {
-    return segments->data[i_segment].end;
-}
+    const int64_t max_speech_samples = params.max_speech_duration_s > 100000.0f ?
+        INT64_MAX : (int64_t) (sample_rate * params.max_speech_duration_s);
 
-int whisper_vad_n_probs(struct whisper_vad_context * vctx) {
-    return vctx->probs.size();
-}
+    const float neg_threshold = std::max(params.threshold - 0.15f, 0.01f);
 
-float * whisper_vad_probs(struct whisper_vad_context * vctx) {
-    return vctx->probs.data();
-}
+    const int64_t curr_sample = stream.n_windows * n_window;
+    const int64_t next_sample = curr_sample + n_window;
 
-struct whisper_vad_segments * whisper_vad_segments_from_probs(
-        struct whisper_vad_context *  vctx,
-                whisper_vad_params    params) {
-    WHISPER_LOG_INFO("%s: detecting speech timestamps using %d probabilities\n", __func__, whisper_vad_n_probs(vctx));
+    if (prob >= params.threshold) {
+        stream.temp_end = -1;
 
-    int     n_probs                 = whisper_vad_n_probs(vctx);
-    float * probs                   = whisper_vad_probs(vctx);
-    float   threshold               = params.threshold;
+        if (!stream.triggered) {
+            stream.triggered    = true;
+            stream.speech_start = curr_sample;
+        }
+    } else if (prob < neg_threshold && stream.triggered) {
+        if (stream.temp_end < 0) {
+            stream.temp_end = curr_sample;
+        }
+
+        if (next_sample - stream.temp_end >= min_silence_samples) {
+            if (stream.speech) {
+                stream.events.push_back({ false, std::min(stream.temp_end + speech_pad_samples, next_sample) });
+            }
+
+            stream.triggered = false;
+            stream.speech    = false;
+            stream.temp_end  = -1;
+        }
+    }
+
+    // report the start only once the speech lasted long enough, short bursts are dropped
+    if (stream.triggered && !stream.speech && stream.temp_end < 0 && next_sample - stream.speech_start >= min_speech_samples) {
+        stream.events.push_back({ true, std::max<int64_t>(stream.speech_start - speech_pad_samples, 0) });
+        stream.speech = true;
+    }
+
+    if (stream.speech && next_sample - stream.speech_start > max_speech_samples) {
+        stream.events.push_back({ false, next_sample });
+
+        stream.triggered = false;
+        stream.speech    = false;
+        stream.temp_end  = -1;
+    }
+
+    stream.n_windows++;
+}
+
+int whisper_vad_stream_push(
+        struct whisper_vad_context * vctx,
+        struct whisper_vad_params    params,
+                       const float * samples,
+                               int   n_samples) {
+    auto & stream = vctx->stream;
+
+    stream.events.clear();
+    stream.pcm.insert(stream.pcm.end(), samples, samples + n_samples);
+
+    // only whole windows are evaluated, the rest waits for the next push
+    const int n_windows = stream.pcm.size() / vctx->n_window;
+    if (n_windows == 0) {
+        vctx->probs.clear();
+        return 0;
+    }
+
+    if (!whisper_vad_detect_speech_no_reset(vctx, stream.pcm.data(), n_windows*vctx->n_window)) {
+        return -1;
+    }
+
+    stream.pcm.erase(stream.pcm.begin(), stream.pcm.begin() + (size_t) n_windows*vctx->n_window);
+
+    for (int i = 0; i < n_windows; ++i) {
+        whisper_vad_stream_update(stream, params, vctx->n_window, vctx->probs[i]);
+    }
+
+    return stream.events.size();
+}
+
+void whisper_vad_stream_reset(struct whisper_vad_context * vctx) {
+    whisper_vad_reset_state(vctx);
+
+    vctx->stream = whisper_vad_stream();
+}
+
+int whisper_vad_stream_n_events(struct whisper_vad_context * vctx) {
+    return vctx->stream.events.size();
+}
+
+bool whisper_vad_stream_get_event_start(struct whisper_vad_context * vctx, int i_event) {
+    return vctx->stream.events[i_event].start;
+}
+
+float whisper_vad_stream_get_event_t(struct whisper_vad_context * vctx, int i_event) {
+    return vctx->stream.events[i_event].t * 100.0 / WHISPER_SAMPLE_RATE;
+}
+
+bool whisper_vad_stream_is_speech(struct whisper_vad_context * vctx) {
+    return vctx->stream.speech;
+}
+
+int whisper_vad_segments_n_segments(struct whisper_vad_segments * segments) {
+    return segments->data.size();
+}
+
+float whisper_vad_segments_get_segment_t0(struct whisper_vad_segments * segments, int i_segment) {
+    return segments->data[i_segment].start;
+}
+
+float whisper_vad_segments_get_segment_t1(struct whisper_vad_segments * segments, int i_segment) {
+    return segments->data[i_segment].end;
+}
+
+int whisper_vad_n_probs(struct whisper_vad_context * vctx) {
+    return vctx->probs.size();
+}
+
+float * whisper_vad_probs(struct whisper_vad_context * vctx) {
+    return vctx->probs.data();
+}
+
+struct whisper_vad_segments * whisper_vad_segments_from_probs(
+        struct whisper_vad_context *  vctx,
+                whisper_vad_params    params) {
+    WHISPER_LOG_INFO("%s: detecting speech timestamps using %d probabilities\n", __func__, whisper_vad_n_probs(vctx));
+
+    int     n_probs                 = whisper_vad_n_probs(vctx);
+    float * probs                   = whisper_vad_probs(vctx);
+    float   threshold               = params.threshold;
     int     min_speech_duration_ms  = params.min_speech_duration_ms;
     int     min_silence_duration_ms = params.min_silence_duration_ms;
     float   max_speech_duration_s   = params.max_speech_duration_s;
@@ -5793,7 +7475,8 @@ static struct whisper_grammar whisper_grammar_init(
     const whisper_grammar_element * pos;
 
     // copy rule definitions into vectors
-    std::vector<std::vector<whisper_grammar_element>> vec_rules(n_rules);
+    auto shared_rules = std::make_shared<std::vector<std::vector<whisper_grammar_element>>>(n_rules);
+    auto & vec_rules  = *shared_rules;
     for (size_t i = 0; i < n_rules; i++) {
         for (pos = rules[i]; pos->type != WHISPER_GRETYPE_END; pos++) {
             vec_rules[i].push_back(*pos);
@@ -5823,7 +7506,7 @@ static struct whisper_grammar whisper_grammar_init(
         }
     } while (true);
 
-    return { std::move(vec_rules), std::move(stacks), {} };
+    return { std::move(shared_rules), std::move(stacks), {} };
 }
 
 static void whisper_suppress_invalid_grammar(
@@ -5832,7 +7515,7 @@ static void whisper_suppress_invalid_grammar(
            std::vector<float> & logits,
     const     whisper_grammar & grammar) {
 
-    if (grammar.rules.empty() || grammar.stacks.empty()) {
+    if (!grammar.rules || grammar.rules->empty() || grammar.stacks.empty()) {
         return;
     }
 
@@ -5857,7 +7540,7 @@ static void whisper_suppress_invalid_grammar(
         }
     }
 
-    const auto rejects = whisper_grammar_reject_candidates(grammar.rules, grammar.stacks, candidates_grammar);
+    const auto rejects = whisper_grammar_reject_candidates(*grammar.rules, grammar.stacks, candidates_grammar);
 
     for (const auto & reject : rejects) {
         logits[reject.id] -= params.grammar_penalty;
@@ -5871,7 +7554,7 @@ static void whisper_suppress_invalid_grammar(
 }
 
 static void whisper_grammar_accept_token(whisper_context & ctx, whisper_grammar & grammar, whisper_token token) {
-    if (grammar.rules.empty() || grammar.stacks.empty()) {
+    if (!grammar.rules || grammar.rules->empty() || grammar.stacks.empty()) {
         return;
     }
 
@@ -5889,7 +7572,7 @@ static void whisper_grammar_accept_token(whisper_context & ctx, whisper_grammar
     const auto   decoded     = decode_utf8(text.c_str(), grammar.partial_utf8);
     const auto & code_points = decoded.first;
     for (auto it = code_points.begin(), end = code_points.end() - 1; it != end; ++it) {
-        grammar.stacks = whisper_grammar_accept(grammar.rules, grammar.stacks, *it);
+        grammar.stacks = whisper_grammar_accept(*grammar.rules, grammar.stacks, *it);
     }
     grammar.partial_utf8 = decoded.second;
 }
@@ -5943,6 +7626,7 @@ struct whisper_full_params whisper_full_default_params(enum whisper_sampling_str
 
         /*.debug_mode        =*/ false,
         /*.audio_ctx         =*/ 0,
+        /*.dynamic_audio_ctx =*/ false,
 
         /*.tdrz_enable       =*/ false,
 
@@ -6052,12 +7736,28 @@ static int utf8_len(const char * str) {
     return count;
 }
 
+static void whisper_aheads_rows_from_sequence(
+            struct whisper_context * ctx,
+            const whisper_sequence & sequence,
+  const std::vector<whisper_token> & prompt_init,
+                               int   eot_row,
+              std::vector<int32_t> & w_rows,
+                               int & n_sot);
+
+static bool whisper_aheads_rows_decode(
+            struct whisper_context * ctx,
+              struct whisper_state * state,
+                               int   i_segment,
+                               int   n_threads,
+              std::vector<int32_t> & w_rows,
+                               int & n_sot);
+
 static void whisper_exp_compute_token_level_timestamps_dtw(
             struct whisper_context * ctx,
               struct whisper_state * state,
-        struct whisper_full_params   params,
+        const std::vector<int32_t> & w_rows,
+                               int   n_sot,
                                int   i_segment,
-                            size_t   n_segments,
                                int   seek,
                                int   n_frames,
                                int   medfilt_width,
@@ -6125,40 +7825,249 @@ static const std::vector<std::string> non_speech_tokens = {
     "♪♪♪","♩", "♪", "♫", "♬", "♭", "♮", "♯"
 };
 
-static void whisper_compute_logprobs(
-                const std::vector<float> & logits,
-                              const int    n_logits,
-                      std::vector<float> & logprobs) {
-    const float logit_max = *std::max_element(logits.begin(), logits.end());
-    float logsumexp = 0.0f;
-    for (int i = 0; i < n_logits; ++i) {
-        if (logits[i] > -INFINITY) {
-            logsumexp += expf(logits[i] - logit_max);
+// compile the suppressions that depend only on the params into vocab-sized masks
+// the regex and the non-speech token lookups used to run for every sampled token
+static void whisper_suppress_init(
+              struct whisper_context & ctx,
+               struct whisper_state  & state,
+    const struct whisper_full_params & params) {
+    const auto & vocab    = ctx.vocab;
+    const int    n_logits = vocab.n_vocab;
+
+    auto & special = state.suppress_special;
+    special.assign(n_logits, INFINITY);
+
+    auto suppress = [n_logits](std::vector<float> & mask, whisper_token id) {
+        if (id >= 0 && id < n_logits) {
+            mask[id] = -INFINITY;
+        }
+    };
+
+    // suppress <|notimestamps|> token
+    // ref: https://github.com/openai/whisper/blob/0b1ba3d46ebf7fe6f953acfd8cad62a4f851b49f/whisper/decoding.py#L410-L412
+    suppress(special, vocab.token_not);
+    if (params.no_timestamps) {
+        for (int i = vocab.token_beg; i < n_logits; ++i) {
+            special[i] = -INFINITY;
         }
     }
-    logsumexp = logf(logsumexp) + logit_max;
 
-    for (int i = 0; i < n_logits; ++i) {
-        if (logits[i] > -INFINITY) {
-            logprobs[i] = logits[i] - logsumexp;
-        } else {
-            logprobs[i] = -INFINITY;
+    // suppress sot and nosp tokens
+    suppress(special, vocab.token_sot);
+    suppress(special, vocab.token_nosp);
+
+    // [TDRZ] when tinydiarize is disabled, suppress solm token
+    if (params.tdrz_enable == false) {
+        suppress(special, vocab.token_solm);
+    }
+
+    // suppress task tokens
+    suppress(special, vocab.token_translate);
+    suppress(special, vocab.token_transcribe);
+    suppress(special, vocab.token_prev);
+
+    // suppress lang tokens
+    for (size_t i = 0; i < g_lang.size(); ++i) {
+        suppress(special, whisper_token_lang(&ctx, i));
+    }
+
+    auto & text = state.suppress_text;
+    state.has_suppress_text = params.suppress_regex != nullptr || params.suppress_nst;
+    if (!state.has_suppress_text) {
+        return;
+    }
+
+    text.assign(n_logits, INFINITY);
+
+    // suppress any tokens matching a regular expression
+    // ref: https://github.com/openai/whisper/discussions/1041
+    if (params.suppress_regex != nullptr) {
+        std::regex re(params.suppress_regex);
+        for (std::pair<whisper_vocab::token, whisper_vocab::id> token_id : vocab.token_to_id) {
+            if (std::regex_match(token_id.first, re)) {
+                suppress(text, token_id.second);
+            }
+        }
+    }
+
+    // suppress non-speech tokens
+    // ref: https://github.com/openai/whisper/blob/7858aa9c08d98f75575035ecd6481f462d66ca27/whisper/tokenizer.py#L224-L253
+    if (params.suppress_nst) {
+        for (const std::string & token : non_speech_tokens) {
+            const std::string suppress_tokens[] = {token, " " + token};
+            for (const std::string & suppress_token : suppress_tokens) {
+                const auto it = vocab.token_to_id.find(suppress_token);
+                if (it != vocab.token_to_id.end()) {
+                    suppress(text, it->second);
+                }
+            }
+        }
+
+        // allow hyphens "-" and single quotes "'" between words, but not at the beginning of a word
+        for (const char * token : { " -", " '" }) {
+            const auto it = vocab.token_to_id.find(token);
+            if (it != vocab.token_to_id.end()) {
+                suppress(text, it->second);
+            }
         }
     }
 }
 
-static void whisper_compute_probs(
-    const std::vector<float> & logits,
-                  const int    n_logits,
-    const std::vector<float> & logprobs,
-          std::vector<float> & probs)     {
+// min() against a mask of +/-INFINITY, written branch-free so that it vectorizes
+static void whisper_suppress_apply(float * logits, const float * mask, int n_logits) {
     for (int i = 0; i < n_logits; ++i) {
-        if (logits[i] == -INFINITY) {
-            probs[i] = 0.0f;
-        } else {
-            probs[i] = expf(logprobs[i]);
+        logits[i] = mask[i] < logits[i] ? mask[i] : logits[i];
+    }
+}
+
+// index of the first maximum of x[0, n), n > 0
+// the lanes keep their own maximum and its index (strictly greater, so the first one wins) and are merged at the end
+static int whisper_argmax_f32(const float * x, int n, float & max) {
+    int i = 0;
+
+    int   i_max = 0;
+    float v_max = x[0];
+
+#if defined(__AVX__)
+    if (n >= 16) {
+        __m256 vmax = _mm256_loadu_ps(x);
+        __m256 vidx = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 vbest = vidx;
+
+        const __m256 step = _mm256_set1_ps(8.0f);
+        for (i = 8; i + 8 <= n; i += 8) {
+            vidx = _mm256_add_ps(vidx, step);
+            const __m256 v  = _mm256_loadu_ps(x + i);
+            const __m256 gt = _mm256_cmp_ps(v, vmax, _CMP_GT_OQ);
+            vmax  = _mm256_blendv_ps(vmax,  v,    gt);
+            vbest = _mm256_blendv_ps(vbest, vidx, gt);
+        }
+
+        float lane_max[8];
+        float lane_idx[8];
+        _mm256_storeu_ps(lane_max, vmax);
+        _mm256_storeu_ps(lane_idx, vbest);
+        for (int l = 0; l < 8; ++l) {
+            if (lane_max[l] > v_max || (lane_max[l] == v_max && (int) lane_idx[l] < i_max)) {
+                v_max = lane_max[l];
+                i_max = (int) lane_idx[l];
+            }
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (n >= 8) {
+        float32x4_t vmax = vld1q_f32(x);
+        float32x4_t vidx = { 0.0f, 1.0f, 2.0f, 3.0f };
+        float32x4_t vbest = vidx;
+
+        const float32x4_t step = vdupq_n_f32(4.0f);
+        for (i = 4; i + 4 <= n; i += 4) {
+            vidx = vaddq_f32(vidx, step);
+            const float32x4_t v  = vld1q_f32(x + i);
+            const uint32x4_t  gt = vcgtq_f32(v, vmax);
+            vmax  = vbslq_f32(gt, v,    vmax);
+            vbest = vbslq_f32(gt, vidx, vbest);
+        }
+
+        float lane_max[4];
+        float lane_idx[4];
+        vst1q_f32(lane_max, vmax);
+        vst1q_f32(lane_idx, vbest);
+        for (int l = 0; l < 4; ++l) {
+            if (lane_max[l] > v_max || (lane_max[l] == v_max && (int) lane_idx[l] < i_max)) {
+                v_max = lane_max[l];
+                i_max = (int) lane_idx[l];
+            }
+        }
+    }
+#elif defined(__SSE2__)
+    if (n >= 8) {
+        __m128 vmax = _mm_loadu_ps(x);
+        __m128 vidx = _mm_setr_ps(0, 1, 2, 3);
+        __m128 vbest = vidx;
+
+        const __m128 step = _mm_set1_ps(4.0f);
+        for (i = 4; i + 4 <= n; i += 4) {
+            vidx = _mm_add_ps(vidx, step);
+            const __m128 v  = _mm_loadu_ps(x + i);
+            const __m128 gt = _mm_cmpgt_ps(v, vmax);
+            vmax  = _mm_or_ps(_mm_and_ps(gt, v),    _mm_andnot_ps(gt, vmax));
+            vbest = _mm_or_ps(_mm_and_ps(gt, vidx), _mm_andnot_ps(gt, vbest));
+        }
+
+        float lane_max[4];
+        float lane_idx[4];
+        _mm_storeu_ps(lane_max, vmax);
+        _mm_storeu_ps(lane_idx, vbest);
+        for (int l = 0; l < 4; ++l) {
+            if (lane_max[l] > v_max || (lane_max[l] == v_max && (int) lane_idx[l] < i_max)) {
+                v_max = lane_max[l];
+                i_max = (int) lane_idx[l];
+            }
         }
     }
+#endif
+
+    for (; i < n; ++i) {
+        if (x[i] > v_max) {
+            v_max = x[i];
+            i_max = i;
+        }
+    }
+
+    max = v_max;
+
+    return i_max;
+}
+
+// log_softmax of the logits, also writes the probs
+// exp(x - max) and its sum are computed with ggml's vectorized soft_max, then a single pass writes both outputs
+// the max logprob of the tokens [0, n_text) and the total probability of [n_text, n) are returned for the timestamp rule
+static void whisper_log_softmax(
+        const float * logits,
+                int   n,
+                int   n_text,
+              float * logprobs,
+              float * probs,
+              float & max_text_logprob,
+             double & sum_ts) {
+    float max_text = -INFINITY;
+    float max_ts   = -INFINITY;
+    if (n_text > 0) {
+        whisper_argmax_f32(logits, n_text, max_text);
+    }
+    if (n > n_text) {
+        whisper_argmax_f32(logits + n_text, n - n_text, max_ts);
+    }
+
+    const float max = std::max(max_text, max_ts);
+
+    sum_ts = 0.0;
+
+    if (max == -INFINITY) {
+        // everything is suppressed
+        std::fill(logprobs, logprobs + n, -INFINITY);
+        std::fill(probs,    probs    + n, 0.0f);
+        max_text_logprob = -INFINITY;
+        return;
+    }
+
+    const double sum = wsp_ggml_cpu_soft_max_f32(n, probs, logits, max);
+
+    const float logsumexp = logf(sum) + max;
+    const float scale     = 1.0/sum;
+
+    // -INFINITY logits stay -INFINITY and their probs are already 0
+    for (int i = 0; i < n; ++i) {
+        logprobs[i] = logits[i] - logsumexp;
+        probs[i]   *= scale;
+    }
+
+    for (int i = n_text; i < n; ++i) {
+        sum_ts += probs[i];
+    }
+
+    max_text_logprob = max_text - logsumexp;
 }
 
 // process the logits for the selected decoder
@@ -6186,12 +8095,16 @@ static void whisper_process_logits(
     auto & logprobs = decoder.logprobs;
     {
         logits.resize(n_logits);
-        memcpy(logits.data(), state.logits.data() + decoder.i_batch*n_logits, n_logits*sizeof(float));
 
-        if (temperature > 0.0f) {
-            for (int i = 0; i < n_logits; i++) {
-                logits[i] /= temperature;
-            }
+        // copy, scale by the temperature and suppress <|notimestamps|>, sot, nosp, solm, task and lang tokens
+        // (and all timestamps with no_timestamps) in a single pass, see whisper_suppress_init()
+        const float * src     = state.logits.data() + decoder.i_batch*n_logits;
+        const float * special = state.suppress_special.data();
+        const float   t       = temperature > 0.0f ? temperature : 1.0f;
+
+        for (int i = 0; i < n_logits; i++) {
+            const float x = src[i]/t;
+            logits[i] = special[i] < x ? special[i] : x;
         }
 
         // will be populated a bit later
@@ -6211,15 +8124,6 @@ static void whisper_process_logits(
             }
         }
 
-        // suppress <|notimestamps|> token
-        // ref: https://github.com/openai/whisper/blob/0b1ba3d46ebf7fe6f953acfd8cad62a4f851b49f/whisper/decoding.py#L410-L412
-        logits[vocab.token_not] = -INFINITY;
-        if (params.no_timestamps) {
-            for (int i = vocab.token_beg; i < n_logits; ++i) {
-                logits[i] = -INFINITY;
-            }
-        }
-
         // ref: https://github.com/ggml-org/whisper.cpp/pull/3798
         if (!params.no_timestamps && !params.single_segment && params.max_tokens > 0 && (int) tokens_cur.size() >= params.max_tokens) {
             for (int i = 0; i < vocab.token_eot; ++i) {
@@ -6227,62 +8131,13 @@ static void whisper_process_logits(
             }
         }
 
-        // suppress sot and nosp tokens
-        logits[vocab.token_sot]  = -INFINITY;
-        logits[vocab.token_nosp] = -INFINITY;
-
-        // [TDRZ] when tinydiarize is disabled, suppress solm token
-        if (params.tdrz_enable == false) {
-            logits[vocab.token_solm] = -INFINITY;
-        }
-
-        // suppress task tokens
-        logits[vocab.token_translate]  = -INFINITY;
-        logits[vocab.token_transcribe] = -INFINITY;
-        logits[vocab.token_prev]       = -INFINITY;
-
-        // suppress lang tokens
-        for (size_t i = 0; i < g_lang.size(); ++i) {
-            logits[whisper_token_lang(&ctx, i)] = -INFINITY;
-        }
-
-        // suppress prev token
-        logits[vocab.token_prev] = -INFINITY;
-
         if (params.logits_filter_callback) {
             params.logits_filter_callback(&ctx, &state, tokens_cur.data(), tokens_cur.size(), logits.data(), params.logits_filter_callback_user_data);
         }
 
-        // suppress any tokens matching a regular expression
-        // ref: https://github.com/openai/whisper/discussions/1041
-        if (params.suppress_regex != nullptr) {
-            std::regex re(params.suppress_regex);
-            for (std::pair<whisper_vocab::token, whisper_vocab::id> token_id : vocab.token_to_id) {
-                if (std::regex_match(token_id.first, re)) {
-                    logits[token_id.second] = -INFINITY;
-                }
-            }
-        }
-
-        // suppress non-speech tokens
-        // ref: https://github.com/openai/whisper/blob/7858aa9c08d98f75575035ecd6481f462d66ca27/whisper/tokenizer.py#L224-L253
-        if (params.suppress_nst) {
-            for (const std::string & token : non_speech_tokens) {
-                const std::string suppress_tokens[] = {token, " " + token};
-                for (const std::string & suppress_token : suppress_tokens) {
-                    if (vocab.token_to_id.find(suppress_token) != vocab.token_to_id.end()) {
-                        logits[vocab.token_to_id.at(suppress_token)] = -INFINITY;
-                    }
-                }
-            }
-
-            // allow hyphens "-" and single quotes "'" between words, but not at the beginning of a word
-            if (vocab.token_to_id.find(" -") != vocab.token_to_id.end()) {
-                logits[vocab.token_to_id.at(" -")] = -INFINITY;
-            }
-            if (vocab.token_to_id.find(" '") != vocab.token_to_id.end()) {
-                logits[vocab.token_to_id.at(" '")] = -INFINITY;
-            }
+        // suppress the tokens matching suppress_regex and the non-speech tokens (suppress_nst)
+        if (state.has_suppress_text) {
+            whisper_suppress_apply(logits.data(), state.suppress_text.data(), n_logits);
         }
 
         // timestamps have to appear in pairs, except directly before EOT; mask logits accordingly
@@ -6327,67 +8182,38 @@ static void whisper_process_logits(
             }
         }
 
-        // populate the logprobs array (log_softmax)
-        whisper_compute_logprobs(logits, n_logits, logprobs);
+        // populate the logprobs and probs arrays (log_softmax)
+        float  max_text_token_logprob = -INFINITY;
+        double sum_ts                 = 0.0;
+
+        whisper_log_softmax(logits.data(), n_logits, vocab.token_beg, logprobs.data(), probs.data(), max_text_token_logprob, sum_ts);
 
         // if sum of probability over timestamps is above any other token, sample timestamp
         // ref: https://github.com/openai/whisper/blob/0b1ba3d46ebf7fe6f953acfd8cad62a4f851b49f/whisper/decoding.py#L431-L437
         {
             // logsumexp over timestamps
-            float timestamp_logprob = -INFINITY;
-            {
-                float logsumexp = 0.0f;
-                const float logprob_max = *std::max_element(logprobs.begin() + vocab.token_beg, logprobs.end());
-                for (int i = vocab.token_beg; i < n_logits; ++i) {
-                    if (logprobs[i] > -INFINITY) {
-                        logsumexp += expf(logprobs[i] - logprob_max);
-                    }
-                }
-                if (logsumexp > 0.0f) {
-                    timestamp_logprob = logf(logsumexp) + logprob_max;
-                }
-            }
-
-            const float max_text_token_logprob = *std::max_element(logprobs.begin(), logprobs.begin() + vocab.token_beg);
+            const float timestamp_logprob = sum_ts > 0.0 ? logf(sum_ts) : -INFINITY;
 
             //WHISPER_LOG_INFO("timestamp_logprob=%f max_text_token_logprob=%f\n", timestamp_logprob, max_text_token_logprob);
 
             if (timestamp_logprob > max_text_token_logprob) {
+                // the timestamp probs are kept as they are (not renormalized)
                 for (int i = 0; i < vocab.token_beg; ++i) {
                     logits[i]   = -INFINITY;
                     logprobs[i] = -INFINITY;
+                    probs[i]    = 0.0f;
                 }
             } else {
                 if (params.n_grammar_rules > 0) {
                     whisper_suppress_invalid_grammar(ctx, params, logits, decoder.grammar);
 
-                    // populate the logprobs array (log_softmax)
-                    {
-                        const float logit_max = *std::max_element(logits.begin(), logits.end());
-                        float logsumexp = 0.0f;
-                        for (int i = 0; i < n_logits; ++i) {
-                            if (logits[i] > -INFINITY) {
-                                logsumexp += expf(logits[i] - logit_max);
-                            }
-                        }
-                        logsumexp = logf(logsumexp) + logit_max;
-
-                        for (int i = 0; i < n_logits; ++i) {
-                            if (logits[i] > -INFINITY) {
-                                logprobs[i] = logits[i] - logsumexp;
-                            } else {
-                                logprobs[i] = -INFINITY;
-                            }
-                        }
-                    }
+                    // populate the logprobs and probs arrays again (log_softmax)
+                    whisper_log_softmax(logits.data(), n_logits, vocab.token_beg, logprobs.data(), probs.data(), max_text_token_logprob, sum_ts);
                 }
             }
         }
     }
 
-    // compute probs
-    whisper_compute_probs(logits, n_logits, logprobs, probs);
-
 #if 0
     // print first 100 logits - token string : logit
     //for (int i = 0; i < 10; i++) {
@@ -6455,9 +8281,91 @@ static bool whisper_sequence_tokens_equal(const whisper_sequence & a, const whis
     return true;
 }
 
+// the statistics of the token probs used by the samplers, computed in a single pass:
+// the text tokens only go through the argmax, the timestamp tokens through the argmax and the sum
+struct whisper_probs_stats {
+    whisper_token id     = 0;  // most probable token
+    whisper_token tid    = -1; // most probable timestamp token, -1 if all timestamps have zero probability
+    float         p      = 0.0f;
+    double        max_ts = 0.0;
+    double        sum_ts = 0.0;
+};
+
+static whisper_probs_stats whisper_probs_stats_compute(const whisper_vocab & vocab, const std::vector<float> & probs) {
+    whisper_probs_stats stats;
+
+    const int n_logits = vocab.n_vocab;
+    const int n_text   = vocab.token_beg;
+
+    float max_text = 0.0f;
+    const int id_text = n_text > 0 ? whisper_argmax_f32(probs.data(), n_text, max_text) : 0;
+
+    float max_ts = 0.0f;
+    const int id_ts = n_logits > n_text ? n_text + whisper_argmax_f32(probs.data() + n_text, n_logits - n_text, max_ts) : 0;
+
+    // the timestamp range is small, sum it in double as before
+    for (int i = n_text; i < n_logits; ++i) {
+        stats.sum_ts += probs[i];
+    }
+
+    if (max_ts > 0.0f) {
+        stats.tid    = id_ts;
+        stats.max_ts = max_ts;
+    }
+
+    // probs are non-negative, a zero maximum leaves the first token as the argmax
+    if (max_ts > max_text) {
+        stats.id = id_ts;
+        stats.p  = max_ts;
+    } else if (max_text > 0.0f) {
+        stats.id = id_text;
+        stats.p  = max_text;
+    }
+
+    return stats;
+}
+
+// build the cumulative probs of the decoder, returns the total probability
+static double whisper_probs_cdf_init(whisper_decoder & decoder) {
+    const auto & probs = decoder.probs;
+    auto       & cdf   = decoder.probs_cdf;
+
+    cdf.resize(probs.size());
+
+    double sum = 0.0;
+    for (size_t i = 0; i < probs.size(); ++i) {
+        sum += probs[i];
+        cdf[i] = sum;
+    }
+
+    return sum;
+}
+
+// draw a token with probability proportional to probs: a uniform draw in [0, sum) is looked up in the cumulative probs
+// this is the method of std::discrete_distribution, but the tokens drawn from a given seed are only guaranteed to be
+// the same across runs with the same standard library - libstdc++ and libc++ (Android, iOS) produce different sequences
+static whisper_token whisper_probs_cdf_sample(const whisper_decoder & decoder, double sum) {
+    const auto & cdf = decoder.probs_cdf;
+
+    if (!(sum > 0.0)) {
+        return 0;
+    }
+
+    const double u = std::generate_canonical<double, std::numeric_limits<double>::digits>(decoder.rng)*sum;
+
+    // the first token whose cumulative probability exceeds u, tokens with zero probability are never selected
+    auto it = std::upper_bound(cdf.begin(), cdf.end(), u);
+    if (it == cdf.end()) {
+        // u == sum, some standard libraries can return 1.0 from generate_canonical - take the last token with probability
+        it = std::lower_bound(cdf.begin(), cdf.end(), sum);
+    }
+
+    return (whisper_token) (it - cdf.begin());
+}
+
 static whisper_token_data whisper_sample_token(
             whisper_context & ctx,
-      const whisper_decoder & decoder,
+            whisper_decoder & decoder,
                        bool   best) {
     whisper_token_data result = {
         0, 0, 0.0f, 0.0f, 0.0f, 0.0f, -1, -1, -1, 0.0f,
@@ -6468,40 +8376,20 @@ static whisper_token_data whisper_sample_token(
     const auto & probs    = decoder.probs;
     const auto & logprobs = decoder.logprobs;
 
-    const int n_logits = vocab.n_vocab;
-
-    {
-        double sum_ts = 0.0;
-        double max_ts = 0.0;
-
-        for (int i = vocab.token_beg; i < n_logits; i++) {
-            if (probs[i] == -INFINITY) {
-                continue;
-            }
-
-            sum_ts += probs[i];
-            if (max_ts < probs[i]) {
-                max_ts = probs[i];
-                result.tid = i;
-            }
-        }
+    const auto stats = whisper_probs_stats_compute(vocab, probs);
 
-        result.pt    = max_ts/(sum_ts + 1e-10);
-        result.ptsum = sum_ts;
-    }
+    result.tid   = stats.tid;
+    result.pt    = stats.max_ts/(stats.sum_ts + 1e-10);
+    result.ptsum = stats.sum_ts;
 
     if (best) {
-        for (int i = 0; i < n_logits; ++i) {
-            if (result.p < probs[i]) {
-                result.id   = i;
-                result.p    = probs[i];
-                result.plog = logprobs[i];
-            }
-        }
+        result.id   = stats.id;
+        result.p    = probs[result.id];
+        result.plog = stats.p > 0.0f ? logprobs[result.id] : 0.0f;
     } else {
-        std::discrete_distribution<> dist(probs.begin(), probs.end());
+        const double sum = whisper_probs_cdf_init(decoder);
 
-        result.id   = dist(decoder.rng);
+        result.id   = whisper_probs_cdf_sample(decoder, sum);
         result.p    = probs[result.id];
         result.plog = logprobs[result.id];
     }
@@ -6521,61 +8409,23 @@ static std::vector<whisper_token_data> whisper_sample_token_topk(
     const auto & vocab = ctx.vocab;
 
     const auto & probs    = decoder.probs;
-    const auto & logits   = decoder.logits;
     const auto & logprobs = decoder.logprobs;
 
-    const int n_logits = vocab.n_vocab;
-
-    auto & logits_id = decoder.logits_id;
-
-    logits_id.resize(n_logits);
-    for (int i = 0; i < n_logits; ++i) {
-        logits_id[i].first = logits[i];
-        logits_id[i].second = i;
-    }
-
-    {
-        using pair_type = std::remove_reference<decltype(logits_id)>::type::value_type;
-        std::partial_sort(
-                logits_id.begin(),
-                logits_id.begin() + k, logits_id.end(),
-                [](const pair_type & a, const pair_type & b) {
-            return a.first > b.first;
-        });
-    }
-
+    // note: the k candidates are drawn from probs, so a sorted top-k of the logits is not needed here
     std::vector<whisper_token_data> result;
     result.reserve(k);
 
-    whisper_token tid = vocab.token_beg;
-
-    float pt    = 0.0;
-    float ptsum = 0.0;
-
-    {
-        double sum_ts = 0.0;
-        double max_ts = 0.0;
-
-        for (int i = vocab.token_beg; i < n_logits; i++) {
-            if (probs[i] == -INFINITY) {
-                continue;
-            }
+    const auto stats = whisper_probs_stats_compute(vocab, probs);
 
-            sum_ts += probs[i];
-            if (max_ts < probs[i]) {
-                max_ts = probs[i];
-                tid = i;
-            }
-        }
+    const whisper_token tid = stats.tid >= 0 ? stats.tid : vocab.token_beg;
 
-        pt    = max_ts/(sum_ts + 1e-10);
-        ptsum = sum_ts;
-    }
+    const float pt    = stats.max_ts/(stats.sum_ts + 1e-10);
+    const float ptsum = stats.sum_ts;
 
-    std::discrete_distribution<> dist(probs.begin(), probs.end());
+    const double sum = whisper_probs_cdf_init(decoder);
 
     for (int i = 0; i < k; ++i) {
-        const auto id = dist(decoder.rng);
+        const auto id = whisper_probs_cdf_sample(decoder, sum);
         //printf("XXX %d %d %f %f %f %f\n", id, tid, probs[id], logprobs[id], pt, ptsum);
 
         result.push_back({ id, tid, probs[id], logprobs[id], pt, ptsum, -1, -1, -1, 0.0f, });
@@ -6800,15 +8650,113 @@ static bool whisper_vad(
     return true;
 }
 
-int whisper_full_with_state(
-        struct whisper_context * ctx,
-          struct whisper_state * state,
-    struct whisper_full_params   params,
-                   const float * samples,
-                           int   n_samples) {
-    // clear old results
-    auto & result_all = state->result_all;
-
+// the audio context for a window with n_frames mel frames (10 ms each) of audio left, used with params.dynamic_audio_ctx
+// it covers the audio plus a 1 s margin, since the model tends to drop the last words when they reach the end of the context,
+// rounded up to a multiple of 256 so that only a handful of graph sizes are used (256, 512, ..., 1280, 1500)
+// all of them fit in the compute buffers reserved for the full context in whisper_init_state()
+static int whisper_dynamic_audio_ctx(const whisper_context & ctx, const whisper_state & state, int n_frames) {
+    // the external encoders have a fixed input size
+    if (whisper_encode_external(state)) {
+        return 0;
+    }
+
+    const int n_audio_ctx = ctx.model.hparams.n_audio_ctx;
+    const int n_ctx       = (n_frames + 1)/2 + 50;
+
+    return std::min(n_audio_ctx, WSP_GGML_PAD(n_ctx, 256));
+}
+
+// recreate the self-attention KV cache if it was constructed for less than n_seq sequences
+static bool whisper_kv_self_reserve(whisper_context & ctx, whisper_state & state, int n_seq) {
+    if (state.kv_self_n_dec >= n_seq) {
+        return true;
+    }
+
+    WHISPER_LOG_DEBUG("%s: recreating KV cache: n_seq = %d\n", __func__, n_seq);
+
+    whisper_kv_cache_free(state.kv_self);
+
+    // the cached decoder graph references the old cache tensors
+    whisper_sched_reset(state.sched_decode);
+
+    // overallocate to workaround KV cache fragmentation issues
+    const int factor = n_seq > 1 ? n_seq + 2 : 1;
+
+    if (!whisper_kv_cache_init(state.kv_self, state.backends[0], ctx.params.type_k, ctx.params.type_v,
+                ctx.model.hparams.n_text_state,
+                ctx.model.hparams.n_text_layer,
+                WSP_GGML_PAD(ctx.model.hparams.n_text_ctx, 256)*factor)) {
+        WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for self-attention cache\n", __func__);
+        return false;
+    }
+
+    state.kv_self_n_dec = n_seq;
+
+    return true;
+}
+
+// [EXPERIMENTAL] Token-level timestamps with DTW
+// the rows of a window are kept in slots, the slots are reset for every window and the slots of dropped beams are
+// reused, so the buffer never holds more than the prompt rows and the rows of the live sequences
+static void whisper_aheads_reset_rows(whisper_state & state) {
+    state.aheads_rows_free.clear();
+    state.aheads_n_rows = 0;
+}
+
+// keep the alignment heads attention of the token i_batch of the last decode in a free slot
+static int whisper_aheads_store_row(whisper_state & state, int i_batch) {
+    const wsp_ggml_tensor * QKs = state.aheads_cross_QKs;
+    WHISPER_ASSERT(QKs != nullptr);
+    WHISPER_ASSERT(state.aheads_n_audio <= QKs->ne[1]);
+
+    const size_t n_row = QKs->ne[0]*state.aheads_n_audio;
+
+    int i_row;
+    if (!state.aheads_rows_free.empty()) {
+        i_row = state.aheads_rows_free.back();
+        state.aheads_rows_free.pop_back();
+    } else {
+        i_row = state.aheads_n_rows++;
+    }
+
+    auto & data = state.aheads_cross_QKs_data;
+    if (data.size() < (i_row + 1)*n_row) {
+        data.resize((i_row + 1)*n_row);
+    }
+
+    wsp_ggml_backend_tensor_get(QKs, data.data() + i_row*n_row, i_batch*QKs->nb[2], n_row*sizeof(float));
+
+    return i_row;
+}
+
+// free the slots that no decoder refers to anymore, the first n_rows_keep slots (the prompt) are always kept
+static void whisper_aheads_recycle_rows(whisper_state & state, int n_decoders, int n_rows_keep) {
+    auto & used = state.aheads_rows_used;
+    used.assign(state.aheads_n_rows, 0);
+
+    for (int j = 0; j < n_decoders; ++j) {
+        for (const int i_row : state.decoders[j].sequence.aheads_rows) {
+            used[i_row] = 1;
+        }
+    }
+
+    state.aheads_rows_free.clear();
+    for (int i_row = state.aheads_n_rows - 1; i_row >= n_rows_keep; --i_row) {
+        if (!used[i_row]) {
+            state.aheads_rows_free.push_back(i_row);
+        }
+    }
+}
+
+int whisper_full_with_state(
+        struct whisper_context * ctx,
+          struct whisper_state * state,
+    struct whisper_full_params   params,
+                   const float * samples,
+                           int   n_samples) {
+    // clear old results
+    auto & result_all = state->result_all;
+
     result_all.clear();
 
     if (n_samples > 0) {
@@ -6823,7 +8771,12 @@ int whisper_full_with_state(
     if (params.language == nullptr || strlen(params.language) == 0 || strcmp(params.language, "auto") == 0 || params.detect_language) {
         std::vector<float> probs(whisper_lang_max_id() + 1, 0.0f);
 
-        const auto lang_id = whisper_lang_auto_detect_with_state(ctx, state, 0, params.n_threads, probs.data());
+        if (params.dynamic_audio_ctx) {
+            state->exp_n_audio_ctx = whisper_dynamic_audio_ctx(*ctx, *state, whisper_n_len_from_state(state) - state->mel_stream.n_dropped);
+        }
+
+        // a mel stream only keeps its last window, detect the language on it
+        const auto lang_id = whisper_lang_auto_detect_with_state(ctx, state, state->mel_stream.n_dropped*10, params.n_threads, probs.data());
         if (lang_id < 0) {
             WHISPER_LOG_ERROR("%s: failed to auto-detect language\n", __func__);
             return -3;
@@ -6846,8 +8799,9 @@ int whisper_full_with_state(
         }
     }
 
-    const int seek_start = params.offset_ms/10;
-    const int seek_end = params.duration_ms == 0 ? whisper_n_len_from_state(state) : seek_start + params.duration_ms/10;
+    // the frames dropped from a mel stream cannot be transcribed anymore
+    const int seek_start = std::max(params.offset_ms/10, state->mel_stream.n_dropped);
+    const int seek_end = params.duration_ms == 0 ? whisper_n_len_from_state(state) : params.offset_ms/10 + params.duration_ms/10;
 
     // if length of spectrogram is less than 100ms (10 frames), then return
     // basically don't process anything that is less than 100ms
@@ -6905,6 +8859,8 @@ int whisper_full_with_state(
         decoder.rng = std::mt19937(j);
     }
 
+    whisper_suppress_init(*ctx, *state, params);
+
     // the accumulated text context split into static (prompt_past0) and dynamic (prompt_past1)
     auto & prompt_past0 = state->prompt_past0;
     auto & prompt_past1 = state->prompt_past1;
@@ -6988,13 +8944,27 @@ int whisper_full_with_state(
         prompt_init.push_back(whisper_token_not(ctx));
     }
 
+    // [EXPERIMENTAL] Token-level timestamps with DTW
+    // without timestamps the text is decoded in the same context as the DTW sequence sot + [lang] + not + text + eot,
+    // so the rows of the alignment heads are kept during decoding - with timestamps they are decoded after the window
+    const bool dtw_keep_rows = ctx->params.dtw_token_timestamps && params.no_timestamps;
+
     int seek = seek_start;
 
     std::vector<whisper_token> prompt;
     prompt.reserve(whisper_n_text_ctx(ctx));
 
+    // a candidate is the sequence of decoder_idx extended by token, it is only materialized if selected
     struct beam_candidate {
         int decoder_idx;
+
+        whisper_token_data token;
+
+        double sum_logprobs_all;
+    };
+
+    // the decoder state the selected candidates are built from, reused across steps to avoid allocations
+    struct beam_parent {
         int seek_delta;
 
         bool has_ts;
@@ -7005,6 +8975,7 @@ int whisper_full_with_state(
 
     std::vector<std::vector<beam_candidate>> bc_per_dec(n_decoders);
     std::vector<beam_candidate> beam_candidates;
+    std::vector<beam_parent> beam_parents(n_decoders);
 
     // main loop
     while (true) {
@@ -7027,12 +8998,24 @@ int whisper_full_with_state(
             }
         }
 
+        if (params.dynamic_audio_ctx) {
+            state->exp_n_audio_ctx = whisper_dynamic_audio_ctx(*ctx, *state, seek_end - seek);
+        }
+
         // encode audio features starting at offset seek
         if (!whisper_encode_internal(*ctx, *state, seek, params.n_threads, params.abort_callback, params.abort_callback_user_data)) {
             WHISPER_LOG_ERROR("%s: failed to encode\n", __func__);
             return -6;
         }
 
+        // [EXPERIMENTAL] Token-level timestamps with DTW
+        // the rows keep only the audio positions this window can align to
+        if (ctx->params.dtw_token_timestamps) {
+            const int n_audio_ctx = state->exp_n_audio_ctx > 0 ? state->exp_n_audio_ctx : ctx->model.hparams.n_audio_ctx;
+
+            state->aheads_n_audio = std::min(n_audio_ctx, (seek_end - seek)/2);
+        }
+
         // if there is a very short audio segment left to process, we remove any past prompt since it tends
         // to confuse the decoder and often make it repeat or hallucinate stuff
         if (seek > seek_start && seek + 500 >= seek_end) {
@@ -7073,6 +9056,7 @@ int whisper_full_with_state(
                 auto & decoder = state->decoders[j];
 
                 decoder.sequence.tokens.clear();
+                decoder.sequence.aheads_rows.clear();
                 decoder.sequence.result_len       = 0;
                 decoder.sequence.sum_logprobs_all = 0.0;
                 decoder.sequence.sum_logprobs     = -INFINITY;
@@ -7086,6 +9070,8 @@ int whisper_full_with_state(
                 decoder.completed = false;
                 decoder.has_ts    = false;
 
+                decoder.aheads_row = 0;
+
                 if (params.grammar_rules != nullptr) {
                     decoder.grammar = whisper_grammar_init(params.grammar_rules, params.n_grammar_rules, params.i_start_rule);
                 } else {
@@ -7130,45 +9116,50 @@ int whisper_full_with_state(
                 WHISPER_LOG_DEBUG("\n\n");
 
                 // recreate the KV cache if the number of decoders has changed
-                if (state->kv_self_n_dec < n_decoders_cur) {
-                    WHISPER_LOG_DEBUG("%s: recreating KV cache: n_decoders_cur = %d\n", __func__, n_decoders_cur);
-
-                    whisper_kv_cache_free(state->kv_self);
-
-                    // overallocate to workaround KV cache fragmentation issues
-                    const int factor = n_decoders_cur > 1 ? n_decoders_cur + 2 : 1;
-
-                    if (!whisper_kv_cache_init(state->kv_self, state->backends[0], ctx->itype,
-                                ctx->model.hparams.n_text_state,
-                                ctx->model.hparams.n_text_layer,
-                                WSP_GGML_PAD(ctx->model.hparams.n_text_ctx, 256)*factor)) {
-                        WHISPER_LOG_ERROR("%s: whisper_kv_cache_init() failed for self-attention cache\n", __func__);
-                        whisper_free_state(state);
-                        return -7;
-                    }
-
-                    state->kv_self_n_dec = n_decoders_cur;
+                if (!whisper_kv_self_reserve(*ctx, *state, n_decoders_cur)) {
+                    whisper_free_state(state);
+                    return -7;
                 }
 
                 whisper_kv_cache_clear(state->kv_self);
 
                 whisper_batch_prep_legacy(state->batch, prompt.data(), prompt.size(), 0, 0);
 
-                if (!whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, false, params.abort_callback, params.abort_callback_user_data)) {
+                if (!whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, dtw_keep_rows, params.abort_callback, params.abort_callback_user_data)) {
                     WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
                     return -8;
                 }
 
+                // [EXPERIMENTAL] Token-level timestamps with DTW
+                // the rows of the prompt_init tokens take the first slots, the last one produced the logits of the first token
+                if (dtw_keep_rows) {
+                    whisper_aheads_reset_rows(*state);
+
+                    int i_row = 0;
+                    for (int k = 0; k < (int) prompt_init.size(); ++k) {
+                        i_row = whisper_aheads_store_row(*state, prompt.size() - prompt_init.size() + k);
+                    }
+
+                    for (int j = 0; j < n_decoders_cur; ++j) {
+                        state->decoders[j].aheads_row = i_row;
+                    }
+                }
+
                 // Calculate no_speech probability after first decode.
                 // This has to be done before any logit filtering. Hence we cannot use the probs from the whisper_process_logits.
                 {
                     const int n_logits = ctx->vocab.id_to_token.size();
-                    std::vector<float> logprobs(n_logits);
-                    std::vector<float> probs(n_logits);
 
-                    whisper_compute_logprobs(state->logits, n_logits, logprobs);
-                    whisper_compute_probs(state->logits, n_logits, logprobs, probs);
-                    state->no_speech_prob = probs[whisper_token_nosp(ctx)];
+                    // the probs of decoder 0 are overwritten by whisper_process_logits() below, use them as scratch
+                    auto & probs = state->decoders[0].probs;
+                    probs.resize(n_logits);
+
+                    float logit_max = -INFINITY;
+                    whisper_argmax_f32(state->logits.data(), n_logits, logit_max);
+
+                    const double sum = wsp_ggml_cpu_soft_max_f32(n_logits, probs.data(), state->logits.data(), logit_max);
+
+                    state->no_speech_prob = probs[whisper_token_nosp(ctx)]/sum;
                 }
 
                 {
@@ -7202,7 +9193,7 @@ int whisper_full_with_state(
                 }
 
                 // sampling
-                // TODO: avoid memory allocations, optimize, avoid threads?
+                // TODO: avoid memory allocations, optimize
                 {
                     std::atomic<int> j_cur(0);
 
@@ -7230,38 +9221,24 @@ int whisper_full_with_state(
                                         }
 
                                         decoder.sequence.sum_logprobs_all += decoder.sequence.tokens.back().plog;
+
+                                        if (dtw_keep_rows) {
+                                            decoder.sequence.aheads_rows.push_back(decoder.aheads_row);
+                                        }
                                     } break;
                                 case whisper_sampling_strategy::WHISPER_SAMPLING_BEAM_SEARCH:
                                     {
                                         const auto tokens_new = whisper_sample_token_topk(*ctx, decoder, params.beam_search.beam_size);
 
                                         for (const auto & token : tokens_new) {
-                                            bc_per_dec[j].push_back({ j, decoder.seek_delta, decoder.has_ts, decoder.sequence, decoder.grammar, });
-                                            bc_per_dec[j].back().sequence.tokens.push_back(token);
-                                            bc_per_dec[j].back().sequence.sum_logprobs_all += token.plog;
+                                            bc_per_dec[j].push_back({ j, token, decoder.sequence.sum_logprobs_all + token.plog, });
                                         }
                                     } break;
                             };
                         }
                     };
 
-                    const int n_threads = std::min(params.n_threads, n_decoders_cur);
-
-                    if (n_threads == 1) {
-                        process();
-                    } else {
-                        std::vector<std::thread> threads(n_threads - 1);
-
-                        for (int t = 0; t < n_threads - 1; ++t) {
-                            threads[t] = std::thread(process);
-                        }
-
-                        process();
-
-                        for (int t = 0; t < n_threads - 1; ++t) {
-                            threads[t].join();
-                        }
-                    }
+                    state->workers.run(std::min(params.n_threads, n_decoders_cur), [&](int, int) { process(); });
                 }
 
                 beam_candidates.clear();
@@ -7279,15 +9256,42 @@ int whisper_full_with_state(
                             beam_candidates.begin(),
                             beam_candidates.end(),
                             [](const beam_candidate & a, const beam_candidate & b) {
-                        if (a.sequence.sum_logprobs_all != b.sequence.sum_logprobs_all) {
-                            return a.sequence.sum_logprobs_all > b.sequence.sum_logprobs_all;
+                        if (a.sum_logprobs_all != b.sum_logprobs_all) {
+                            return a.sum_logprobs_all > b.sum_logprobs_all;
                         }
                         return a.decoder_idx < b.decoder_idx;
                     });
 
+                    // move the decoder states aside (no copy), the decoders are then overwritten with the winners
+                    for (int j = 0; j < n_decoders_cur; ++j) {
+                        auto & decoder = state->decoders[j];
+
+                        if (decoder.completed || decoder.failed) {
+                            continue;
+                        }
+
+                        auto & parent = beam_parents[j];
+
+                        parent.seek_delta = decoder.seek_delta;
+                        parent.has_ts     = decoder.has_ts;
+                        std::swap(parent.sequence, decoder.sequence);
+                        std::swap(parent.grammar,  decoder.grammar);
+                    }
+
+                    const auto beam_candidate_equal = [&](const beam_candidate & a, const beam_candidate & b) {
+                        return a.token.id == b.token.id &&
+                            (a.decoder_idx == b.decoder_idx ||
+                             whisper_sequence_tokens_equal(beam_parents[a.decoder_idx].sequence, beam_parents[b.decoder_idx].sequence));
+                    };
+
+                    // the KV cache sequence each decoder continues from, finished decoders keep their own
+                    whisper_seq_id kv_src[WHISPER_MAX_DECODERS];
+
                     uint32_t cur_c = 0;
 
                     for (int j = 0; j < n_decoders_cur; ++j) {
+                        kv_src[j] = j;
+
                         auto & decoder = state->decoders[j];
 
                         if (decoder.completed || decoder.failed) {
@@ -7300,32 +9304,32 @@ int whisper_full_with_state(
 
                         auto & cur = beam_candidates[cur_c++];
 
-                        while (beam_candidates.size() > cur_c && whisper_sequence_tokens_equal(beam_candidates[cur_c].sequence, cur.sequence) && i > 0) {
+                        while (beam_candidates.size() > cur_c && beam_candidate_equal(beam_candidates[cur_c], cur) && i > 0) {
                             ++cur_c;
                         }
 
-                        decoder.seek_delta = cur.seek_delta;
-                        decoder.has_ts     = cur.has_ts;
-                        decoder.sequence   = cur.sequence;
-                        decoder.grammar    = cur.grammar;
+                        const auto & parent = beam_parents[cur.decoder_idx];
 
-                        whisper_kv_cache_seq_cp(state->kv_self, cur.decoder_idx, WHISPER_MAX_DECODERS + j, -1, -1);
+                        // assignment reuses the capacity of the decoder sequence, the grammar rules are shared
+                        decoder.seek_delta = parent.seek_delta;
+                        decoder.has_ts     = parent.has_ts;
+                        decoder.sequence   = parent.sequence;
+                        decoder.grammar    = parent.grammar;
 
-                        WHISPER_LOG_DEBUG("%s: beam search: decoder %d: from decoder %d: token = %10s, plog = %8.5f, sum_logprobs = %8.5f\n",
-                                __func__, j, cur.decoder_idx, ctx->vocab.id_to_token.at(decoder.sequence.tokens.back().id).c_str(), decoder.sequence.tokens.back().plog, decoder.sequence.sum_logprobs_all);
-                    }
+                        decoder.sequence.tokens.push_back(cur.token);
+                        decoder.sequence.sum_logprobs_all = cur.sum_logprobs_all;
 
-                    for (int j = 0; j < n_decoders_cur; ++j) {
-                        auto & decoder = state->decoders[j];
-
-                        if (decoder.completed || decoder.failed) {
-                            continue;
+                        if (dtw_keep_rows) {
+                            decoder.sequence.aheads_rows.push_back(state->decoders[cur.decoder_idx].aheads_row);
                         }
 
-                        whisper_kv_cache_seq_rm(state->kv_self, j,                           -1, -1);
-                        whisper_kv_cache_seq_cp(state->kv_self, WHISPER_MAX_DECODERS + j, j, -1, -1);
-                        whisper_kv_cache_seq_rm(state->kv_self, WHISPER_MAX_DECODERS + j,    -1, -1);
+                        kv_src[j] = cur.decoder_idx;
+
+                        WHISPER_LOG_DEBUG("%s: beam search: decoder %d: from decoder %d: token = %10s, plog = %8.5f, sum_logprobs = %8.5f\n",
+                                __func__, j, cur.decoder_idx, ctx->vocab.id_to_token.at(decoder.sequence.tokens.back().id).c_str(), decoder.sequence.tokens.back().plog, decoder.sequence.sum_logprobs_all);
                     }
+
+                    whisper_kv_cache_seq_remap(state->kv_self, kv_src, n_decoders_cur);
                 }
 
                 // update the decoder state
@@ -7466,14 +9470,32 @@ int whisper_full_with_state(
 
                     assert(batch.n_tokens > 0);
 
-                    if (!whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, false, params.abort_callback, params.abort_callback_user_data)) {
+                    if (!whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, dtw_keep_rows, params.abort_callback, params.abort_callback_user_data)) {
                         WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
                         return -9;
                     }
 
+                    // [EXPERIMENTAL] Token-level timestamps with DTW
+                    if (dtw_keep_rows) {
+                        // the beams that were not selected leave rows behind, reuse their slots
+                        if (params.strategy == whisper_sampling_strategy::WHISPER_SAMPLING_BEAM_SEARCH) {
+                            whisper_aheads_recycle_rows(*state, n_decoders_cur, prompt_init.size());
+                        }
+
+                        for (int j = 0; j < n_decoders_cur; ++j) {
+                            auto & decoder = state->decoders[j];
+
+                            if (decoder.failed || decoder.completed) {
+                                continue;
+                            }
+
+                            decoder.aheads_row = whisper_aheads_store_row(*state, decoder.i_batch);
+                        }
+                    }
+
                     const int64_t t_start_sample_us = wsp_ggml_time_us();
 
-                    // TODO: avoid memory allocations, optimize, avoid threads?
+                    // TODO: avoid memory allocations, optimize
                     {
                         std::atomic<int> j_cur(0);
 
@@ -7495,23 +9517,7 @@ int whisper_full_with_state(
                             }
                         };
 
-                        const int n_threads = std::min(params.n_threads, n_decoders_cur);
-
-                        if (n_threads == 1) {
-                            process();
-                        } else {
-                            std::vector<std::thread> threads(n_threads - 1);
-
-                            for (int t = 0; t < n_threads - 1; ++t) {
-                                threads[t] = std::thread(process);
-                            }
-
-                            process();
-
-                            for (int t = 0; t < n_threads - 1; ++t) {
-                                threads[t].join();
-                            }
-                        }
+                        state->workers.run(std::min(params.n_threads, n_decoders_cur), [&](int, int) { process(); });
                     }
 
                     state->t_sample_us += wsp_ggml_time_us() - t_start_sample_us;
@@ -7724,9 +9730,40 @@ int whisper_full_with_state(
             {
                 const int n_segments = state->result_all.size() - n_segments_before;
                 if (ctx->params.dtw_token_timestamps && n_segments) {
+                    std::vector<int32_t> w_rows;
+                    int n_sot = 0;
+
+                    if (dtw_keep_rows) {
+                        // the DTW rows end with eot as an input, decode it after the last sampled token of the best sequence
+                        // (the last token itself was never an input unless it is eot)
+                        whisper_token tail[2];
+                        int n_tail = 0;
+                        if (tokens_cur.back().id != whisper_token_eot(ctx)) {
+                            tail[n_tail++] = tokens_cur.back().id;
+                        }
+                        tail[n_tail++] = whisper_token_eot(ctx);
+
+                        whisper_batch_prep_legacy(state->batch, tail, n_tail, prompt.size() + tokens_cur.size() - 1, best_decoder_id);
+
+                        if (!whisper_decode_internal(*ctx, *state, state->batch, params.n_threads, true, params.abort_callback, params.abort_callback_user_data)) {
+                            WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
+                            return -9;
+                        }
+
+                        if (n_tail > 1) {
+                            state->decoders[best_decoder_id].sequence.aheads_rows.push_back(whisper_aheads_store_row(*state, 0));
+                        }
+                        const int eot_row = whisper_aheads_store_row(*state, n_tail - 1);
+
+                        whisper_aheads_rows_from_sequence(ctx, best_decoder.sequence, prompt_init, eot_row, w_rows, n_sot);
+                    } else if (!whisper_aheads_rows_decode(ctx, state, result_all.size() - n_segments, params.n_threads, w_rows, n_sot)) {
+                        WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
+                        return -9;
+                    }
+
                     const int n_frames = std::min(std::min(WHISPER_CHUNK_SIZE * 100, seek_delta), seek_end - seek);
                     whisper_exp_compute_token_level_timestamps_dtw(
-                            ctx, state, params, result_all.size() - n_segments, n_segments, seek, n_frames, 7, params.n_threads);
+                            ctx, state, w_rows, n_sot, result_all.size() - n_segments, seek, n_frames, 7, params.n_threads);
                     if (params.new_segment_callback) {
                         for (int seg = (int) result_all.size() - n_segments; seg < n_segments; seg++) {
                             params.new_segment_callback(ctx, state, seg, params.new_segment_callback_user_data);
@@ -7749,37 +9786,632 @@ int whisper_full_with_state(
                 seek_delta = std::min(seek_end - seek, WHISPER_CHUNK_SIZE * 100);
             }
 
-            // update audio window
-            seek += seek_delta;
+            // update audio window
+            seek += seek_delta;
+
+            WHISPER_LOG_DEBUG("seek = %d, seek_delta = %d\n", seek, seek_delta);
+        }
+    }
+
+    return 0;
+}
+
+int whisper_full(
+        struct whisper_context * ctx,
+    struct whisper_full_params   params,
+                   const float * samples,
+                           int   n_samples) {
+
+    std::vector<float> vad_samples;
+    if (params.vad) {
+        WHISPER_LOG_INFO("%s: VAD is enabled, processing speech segments only\n", __func__);
+        if (!whisper_vad(ctx, ctx->state, params, samples, n_samples, vad_samples)) {
+            WHISPER_LOG_ERROR("%s: failed to compute VAD\n", __func__);
+            return -1;
+        }
+        if (vad_samples.empty()) {
+            ctx->state->result_all.clear();
+            return 0;
+        }
+        samples = vad_samples.data();
+        n_samples = vad_samples.size();
+    }
+    return whisper_full_with_state(ctx, ctx->state, params, samples, n_samples);
+}
+
+// greedy decoding of the clips encoded in the kv_cross slots [0, n_group), the clip in slot j uses the decoder and the KV cache sequence j
+// the prompts of the clips differ only in the language token, so each clip contributes the same number of tokens to a batch
+// finished clips are removed by moving the last slot into theirs, which keeps the remaining slots contiguous
+static int whisper_full_batch_decode(
+        struct whisper_context * ctx,
+          struct whisper_state * state,
+    const struct whisper_full_params & params,
+    const std::vector<whisper_token> & prompt_past,
+                    const int * clips,
+                    const int * n_len,
+                            int n_group,
+           std::vector<uint8_t> & buf) {
+    const int n_vocab = ctx->vocab.n_vocab;
+
+    // same as in whisper_full_with_state(), with a single window per clip
+    const int delta_min = 10;
+    const int n_max     = whisper_n_text_ctx(ctx)/2 - 4;
+
+    const float t_cur = params.temperature;
+
+    std::vector<std::vector<whisper_token>> prompts(n_group);
+
+    for (int j = 0; j < n_group; ++j) {
+        auto & prompt = prompts[j];
+
+        prompt = prompt_past;
+        prompt.push_back(whisper_token_sot(ctx));
+
+        if (whisper_is_multilingual(ctx)) {
+            prompt.push_back(whisper_token_lang(ctx, state->clip_lang_ids[clips[j]]));
+            prompt.push_back(params.translate ? whisper_token_translate(ctx) : whisper_token_transcribe(ctx));
+        }
+
+        if (params.no_timestamps) {
+            prompt.push_back(whisper_token_not(ctx));
+        }
+    }
+
+    const int n_prompt = prompts[0].size();
+
+    // TAGS: WHISPER_DECODER_INIT
+    for (int j = 0; j < n_group; ++j) {
+        auto & decoder = state->decoders[j];
+
+        decoder.sequence.tokens.clear();
+        decoder.sequence.result_len       = 0;
+        decoder.sequence.sum_logprobs_all = 0.0;
+        decoder.sequence.sum_logprobs     = -INFINITY;
+        decoder.sequence.avg_logprobs     = -INFINITY;
+        decoder.sequence.entropy          = 0.0;
+        decoder.sequence.score            = -INFINITY;
+
+        decoder.seek_delta = 100*WHISPER_CHUNK_SIZE;
+
+        decoder.failed    = false;
+        decoder.completed = false;
+        decoder.has_ts    = false;
+
+        if (params.grammar_rules != nullptr) {
+            decoder.grammar = whisper_grammar_init(params.grammar_rules, params.n_grammar_rules, params.i_start_rule);
+        } else {
+            decoder.grammar = {};
+        }
+
+        decoder.probs.resize   (n_vocab);
+        decoder.logits.resize  (n_vocab);
+        decoder.logprobs.resize(n_vocab);
+        decoder.logits_id.reserve(n_vocab);
+
+        decoder.rng = std::mt19937(j);
+    }
+
+    auto & batch = state->batch;
+
+    whisper_kv_cache_clear(state->kv_self);
+
+    batch.n_tokens = 0;
+
+    for (int j = 0; j < n_group; ++j) {
+        for (int i = 0; i < n_prompt; ++i) {
+            batch.token   [batch.n_tokens]    = prompts[j][i];
+            batch.pos     [batch.n_tokens]    = i;
+            batch.n_seq_id[batch.n_tokens]    = 1;
+            batch.seq_id  [batch.n_tokens][0] = j;
+            batch.logits  [batch.n_tokens]    = i == n_prompt - 1;
+            batch.n_tokens++;
+        }
+
+        state->decoders[j].i_batch = (j + 1)*n_prompt - 1;
+    }
+
+    state->n_clips = n_group;
+
+    if (!whisper_decode_internal(*ctx, *state, batch, params.n_threads, false, params.abort_callback, params.abort_callback_user_data)) {
+        WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
+        return -8;
+    }
+
+    // the no_speech probability of each clip, before any logit filtering
+    std::vector<float> no_speech_probs(n_group);
+
+    for (int j = 0; j < n_group; ++j) {
+        const float * logits = state->logits.data() + (size_t) state->decoders[j].i_batch*n_vocab;
+
+        auto & probs = state->decoders[j].probs;
+
+        float logit_max = -INFINITY;
+        whisper_argmax_f32(logits, n_vocab, logit_max);
+
+        const double sum = wsp_ggml_cpu_soft_max_f32(n_vocab, probs.data(), logits, logit_max);
+
+        no_speech_probs[j] = probs[whisper_token_nosp(ctx)]/sum;
+    }
+
+    // slots[s] is the clip whose cross-attention KV is in slot s of kv_cross
+    std::vector<int> slots(n_group);
+    for (int j = 0; j < n_group; ++j) {
+        slots[j] = j;
+    }
+
+    const auto process_logits = [&]() {
+        const int64_t t_start_sample_us = wsp_ggml_time_us();
+
+        std::atomic<int> s_cur(0);
+
+        state->workers.run(std::min<int>(params.n_threads, slots.size()), [&](int, int) {
+            while (true) {
+                const int s = s_cur.fetch_add(1);
+
+                if (s >= (int) slots.size()) {
+                    break;
+                }
+
+                whisper_process_logits(*ctx, *state, state->decoders[slots[s]], params, t_cur);
+            }
+        });
+
+        state->t_sample_us += wsp_ggml_time_us() - t_start_sample_us;
+    };
+
+    process_logits();
+
+    for (int i = 0; i < n_max && !slots.empty(); ++i) {
+        const int64_t t_start_sample_us = wsp_ggml_time_us();
+
+        for (int s = 0; s < (int) slots.size(); ++s) {
+            const int j = slots[s];
+
+            auto & decoder = state->decoders[j];
+
+            decoder.sequence.tokens.push_back(whisper_sample_token(*ctx, decoder, t_cur < 1e-6f));
+            decoder.sequence.sum_logprobs_all += decoder.sequence.tokens.back().plog;
+
+            state->n_sample += 1;
+
+            auto & has_ts     = decoder.has_ts;
+            auto & seek_delta = decoder.seek_delta;
+            auto & result_len = decoder.sequence.result_len;
+
+            const auto & token = decoder.sequence.tokens.back();
+
+            // timestamp token - update sliding window
+            if (token.id > whisper_token_beg(ctx)) {
+                const int seek_delta_new = 2*(token.id - whisper_token_beg(ctx));
+
+                // do not allow to go back in time
+                if (has_ts && seek_delta > seek_delta_new && result_len < i) {
+                    decoder.failed = true;
+                    continue;
+                }
+
+                seek_delta = seek_delta_new;
+                result_len = i + 1;
+                has_ts = true;
+            }
+
+            whisper_grammar_accept_token(*ctx, decoder.grammar, token.id);
+
+            // end of segment
+            if (token.id == whisper_token_eot(ctx) ||
+               (params.max_tokens > 0 && i >= params.max_tokens) ||
+               (has_ts && seek_delta + delta_min >= n_len[j])) {
+                if (result_len == 0 && !params.no_timestamps) {
+                    if (seek_delta + delta_min >= n_len[j]) {
+                        result_len = i + 1;
+                    } else {
+                        decoder.failed = true;
+                        continue;
+                    }
+                }
+
+                if (params.single_segment || params.no_timestamps) {
+                    result_len = i + 1;
+                    seek_delta = 100*WHISPER_CHUNK_SIZE;
+                }
+
+                decoder.completed = true;
+                continue;
+            }
+
+            // TESTS: if no tensors are loaded, it means we are running tests
+            if (ctx->model.n_loaded == 0) {
+                seek_delta = 100*WHISPER_CHUNK_SIZE;
+                decoder.completed = true;
+                continue;
+            }
+
+            // there is no temperature fallback, the clip keeps the tokens up to the last timestamp
+            if (i == n_max - 1) {
+                decoder.failed = true;
+            }
+        }
+
+        // remove the finished clips, from the last slot so that the slot moved into a freed one is never finished
+        for (int s = (int) slots.size() - 1; s >= 0; --s) {
+            const int j = slots[s];
+
+            if (!state->decoders[j].completed && !state->decoders[j].failed) {
+                continue;
+            }
+
+            whisper_kv_cache_seq_rm(state->kv_self, j, -1, -1);
+
+            const int s_last = slots.size() - 1;
+            if (s != s_last) {
+                whisper_kv_cross_copy_slot(*ctx, *state, s_last, s, buf);
+                slots[s] = slots[s_last];
+            }
+
+            slots.pop_back();
+        }
+
+        state->t_sample_us += wsp_ggml_time_us() - t_start_sample_us;
+
+        if (slots.empty()) {
+            break;
+        }
+
+        // obtain logits for the next token of each clip
+        batch.n_tokens = 0;
+
+        for (int s = 0; s < (int) slots.size(); ++s) {
+            const int j = slots[s];
+
+            auto & decoder = state->decoders[j];
+
+            decoder.i_batch = batch.n_tokens;
+
+            batch.token   [batch.n_tokens]    = decoder.sequence.tokens.back().id;
+            batch.pos     [batch.n_tokens]    = n_prompt + i;
+            batch.n_seq_id[batch.n_tokens]    = 1;
+            batch.seq_id  [batch.n_tokens][0] = j;
+            batch.logits  [batch.n_tokens]    = 1;
+            batch.n_tokens++;
+        }
+
+        state->n_clips = slots.size();
+
+        if (!whisper_decode_internal(*ctx, *state, batch, params.n_threads, false, params.abort_callback, params.abort_callback_user_data)) {
+            WHISPER_LOG_ERROR("%s: failed to decode\n", __func__);
+            return -9;
+        }
+
+        process_logits();
+    }
+
+    // split the tokens of each clip into segments at the timestamp tokens
+    auto & result_all = state->result_all;
+
+    for (int j = 0; j < n_group; ++j) {
+        auto & decoder = state->decoders[j];
+
+        auto & tokens_cur = decoder.sequence.tokens;
+
+        tokens_cur.resize(decoder.sequence.result_len);
+        whisper_sequence_score(params, decoder.sequence);
+
+        const bool is_no_speech = (no_speech_probs[j] > params.no_speech_thold &&
+            decoder.sequence.avg_logprobs < params.logprob_thold);
+
+        if (tokens_cur.empty() || ctx->model.n_loaded == 0 || is_no_speech) {
+            continue;
+        }
+
+        const auto n_segments_before = result_all.size();
+
+        const auto push_segment = [&](int64_t t0, int64_t t1, const std::string & text, bool speaker_turn_next, int i0, int i1) {
+            result_all.push_back({ t0, t1, text, no_speech_probs[j], {}, speaker_turn_next, clips[j] });
+            result_all.back().tokens.assign(tokens_cur.begin() + i0, tokens_cur.begin() + i1);
+        };
+
+        int  i0 = 0;
+        auto t0 = params.no_timestamps ? 0 : 2*(tokens_cur.front().tid - whisper_token_beg(ctx));
+
+        std::string text;
+        bool speaker_turn_next = false;
+
+        for (int i = 0; i < (int) tokens_cur.size(); i++) {
+            if (params.print_special || tokens_cur[i].id < whisper_token_eot(ctx)) {
+                text += whisper_token_to_str(ctx, tokens_cur[i].id);
+            }
+
+            // [TDRZ] record if speaker turn was predicted after current segment
+            if (params.tdrz_enable && tokens_cur[i].id == whisper_token_solm(ctx)) {
+                speaker_turn_next = true;
+            }
+
+            if (tokens_cur[i].id > whisper_token_beg(ctx) && !params.single_segment) {
+                const auto t1 = 2*(tokens_cur[i].tid - whisper_token_beg(ctx));
+
+                if (!text.empty()) {
+                    push_segment(t0, t1, text, speaker_turn_next, i0, i + 1);
+                }
+                text = "";
+                t0 = t1;
+                while (i + 1 < (int) tokens_cur.size() && tokens_cur[i + 1].id > whisper_token_beg(ctx)) {
+                    i++;
+                    if (params.print_special) {
+                        text += whisper_token_to_str(ctx, tokens_cur[i].id);
+                    }
+                    t0 = 2*(tokens_cur[i].tid - whisper_token_beg(ctx));
+                }
+                i0 = i + 1;
+                speaker_turn_next = false;
+            }
+        }
+
+        if (!text.empty()) {
+            push_segment(t0, std::min(decoder.seek_delta, n_len[j]), text, speaker_turn_next, i0, tokens_cur.size());
+        }
+
+        const int n_new = result_all.size() - n_segments_before;
+        if (params.new_segment_callback && n_new > 0) {
+            params.new_segment_callback(ctx, state, n_new, params.new_segment_callback_user_data);
+        }
+    }
+
+    return 0;
+}
+
+static int whisper_full_batch_internal(
+        struct whisper_context * ctx,
+          struct whisper_state * state,
+    struct whisper_full_params   params,
+           const float * const * samples,
+                     const int * n_samples,
+                           int   n_clips) {
+    // clear old results
+    auto & result_all = state->result_all;
+
+    result_all.clear();
+
+    state->has_vad_segments = false;
+    state->clip_lang_ids.assign(std::max(0, n_clips), state->lang_id);
+
+    if (params.audio_ctx > whisper_n_audio_ctx(ctx)) {
+        WHISPER_LOG_ERROR("%s: audio_ctx is larger than the maximum allowed (%d > %d)\n", __func__, params.audio_ctx, whisper_n_audio_ctx(ctx));
+        return -5;
+    }
+
+    // the clips that are long enough to be processed, see whisper_full_with_state()
+    std::vector<int> clips;
+
+    for (int c = 0; c < n_clips; ++c) {
+        if (n_samples[c] > WHISPER_CHUNK_SIZE*WHISPER_SAMPLE_RATE) {
+            WHISPER_LOG_ERROR("%s: clip %d is longer than %d s, use whisper_full() instead\n", __func__, c, WHISPER_CHUNK_SIZE);
+            return -1;
+        }
+
+        if (n_samples[c] < 10*WHISPER_HOP_LENGTH) {
+            WHISPER_LOG_WARN("%s: clip %d is too short - %d ms < 100 ms\n", __func__, c, n_samples[c]*1000/WHISPER_SAMPLE_RATE);
+            continue;
+        }
+
+        clips.push_back(c);
+    }
+
+    const bool detect_language = params.language == nullptr || strlen(params.language) == 0 || strcmp(params.language, "auto") == 0 || params.detect_language;
+
+    if (!detect_language) {
+        state->clip_lang_ids.assign(n_clips, whisper_lang_id(params.language));
+    }
+
+    // first release distilled models require the "no_timestamps" token
+    {
+        const bool is_distil = ctx->model.hparams.n_text_layer == 2 && ctx->model.hparams.n_vocab != 51866;
+        if (is_distil && !params.no_timestamps) {
+            WHISPER_LOG_WARN("%s: using first release distilled models - forcing no_timestamps\n", __func__);
+            params.no_timestamps = true;
+        }
+    }
+
+    whisper_suppress_init(*ctx, *state, params);
+
+    // the initial prompt, shared by all clips
+    std::vector<whisper_token> prompt_past;
+    {
+        std::vector<whisper_token> prompt_tokens;
+
+        if (!params.prompt_tokens && params.initial_prompt) {
+            prompt_tokens.resize(1024);
+            int n_needed = whisper_tokenize(ctx, params.initial_prompt, prompt_tokens.data(), prompt_tokens.size());
+            if (n_needed < 0) {
+                prompt_tokens.resize(-n_needed);
+                n_needed = whisper_tokenize(ctx, params.initial_prompt, prompt_tokens.data(), prompt_tokens.size());
+            }
+            prompt_tokens.resize(n_needed);
+            params.prompt_tokens   = prompt_tokens.data();
+            params.prompt_n_tokens = prompt_tokens.size();
+        }
+
+        const int max_prompt_ctx = std::min(params.n_max_text_ctx, whisper_n_text_ctx(ctx)/2);
+
+        if (params.prompt_tokens && params.prompt_n_tokens > 0 && max_prompt_ctx > 1) {
+            const int n_take = std::min(params.prompt_n_tokens, max_prompt_ctx - 1);
+
+            prompt_past.push_back(whisper_token_prev(ctx));
+            prompt_past.insert(prompt_past.end(), params.prompt_tokens + (params.prompt_n_tokens - n_take), params.prompt_tokens + params.prompt_n_tokens);
+        }
+    }
+
+    // the prompts of all clips of a group must fit into one batch
+    const int n_prompt    = prompt_past.size() + 4;
+    const int n_group_max = std::max(1, std::min<int>(WHISPER_MAX_DECODERS, whisper_n_text_ctx(ctx)/n_prompt));
+
+    std::vector<int>     n_len(n_group_max);
+    std::vector<uint8_t> buf;
+
+    for (int g0 = 0; g0 < (int) clips.size(); g0 += n_group_max) {
+        if (params.progress_callback) {
+            params.progress_callback(ctx, state, (100*g0)/clips.size(), params.progress_callback_user_data);
+        }
+
+        const int n_group = std::min<int>(n_group_max, clips.size() - g0);
+
+        // all clips of a group share the audio context, it is sized for the longest one
+        state->exp_n_audio_ctx = params.audio_ctx;
+        if (params.dynamic_audio_ctx) {
+            int n_frames_max = 0;
+            for (int j = 0; j < n_group; ++j) {
+                n_frames_max = std::max(n_frames_max, n_samples[clips[g0 + j]]/WHISPER_HOP_LENGTH);
+            }
+            state->exp_n_audio_ctx = whisper_dynamic_audio_ctx(*ctx, *state, n_frames_max);
+        }
+
+        if (!whisper_kv_cross_reserve(*ctx, *state, n_group) || !whisper_kv_self_reserve(*ctx, *state, n_group)) {
+            return -7;
+        }
+
+        // encode the clips from the last to the first, each is then moved from slot 0 to its own slot
+        for (int j = n_group - 1; j >= 0; --j) {
+            const int c = clips[g0 + j];
+
+            if (params.encoder_begin_callback) {
+                if (params.encoder_begin_callback(ctx, state, params.encoder_begin_callback_user_data) == false) {
+                    WHISPER_LOG_ERROR("%s: encoder_begin_callback returned false - aborting\n", __func__);
+                    return 0;
+                }
+            }
+
+            if (whisper_pcm_to_mel_with_state(ctx, state, samples[c], n_samples[c], params.n_threads) != 0) {
+                WHISPER_LOG_ERROR("%s: failed to compute log mel spectrogram\n", __func__);
+                return -2;
+            }
+
+            n_len[j] = whisper_n_len_from_state(state);
+
+            if (detect_language) {
+                // the language detection encodes the clip too
+                const int lang_id = whisper_lang_auto_detect_with_state(ctx, state, 0, params.n_threads, nullptr);
+                if (lang_id < 0) {
+                    WHISPER_LOG_ERROR("%s: failed to auto-detect language\n", __func__);
+                    return -3;
+                }
+                state->clip_lang_ids[c] = lang_id;
+            } else if (!whisper_encode_internal(*ctx, *state, 0, params.n_threads, params.abort_callback, params.abort_callback_user_data)) {
+                WHISPER_LOG_ERROR("%s: failed to encode\n", __func__);
+                return -6;
+            }
+
+            if (j > 0) {
+                whisper_kv_cross_copy_slot(*ctx, *state, 0, j, buf);
+            }
+        }
+
+        if (params.detect_language) {
+            continue;
+        }
+
+        const int ret = whisper_full_batch_decode(ctx, state, params, prompt_past, clips.data() + g0, n_len.data(), n_group, buf);
 
-            WHISPER_LOG_DEBUG("seek = %d, seek_delta = %d\n", seek, seek_delta);
+        state->n_clips = 1;
+
+        if (ret != 0) {
+            return ret;
         }
     }
 
+    if (params.progress_callback) {
+        params.progress_callback(ctx, state, 100, params.progress_callback_user_data);
+    }
+
     return 0;
 }
 
-int whisper_full(
+int whisper_full_batch_with_state(
         struct whisper_context * ctx,
+          struct whisper_state * state,
     struct whisper_full_params   params,
-                   const float * samples,
-                           int   n_samples) {
+           const float * const * samples,
+                     const int * n_samples,
+                           int   n_clips) {
+    const int ret = whisper_full_batch_internal(ctx, state, params, samples, n_samples, n_clips);
 
-    std::vector<float> vad_samples;
-    if (params.vad) {
-        WHISPER_LOG_INFO("%s: VAD is enabled, processing speech segments only\n", __func__);
-        if (!whisper_vad(ctx, ctx->state, params, samples, n_samples, vad_samples)) {
-            WHISPER_LOG_ERROR("%s: failed to compute VAD\n", __func__);
-            return -1;
+    // the batch slots are only needed while the clips are decoded
+    if (!whisper_kv_cross_release(*ctx, *state)) {
+        return -7;
+    }
+
+    return ret;
+}
+
+int whisper_full_batch(
+        struct whisper_context * ctx,
+    struct whisper_full_params   params,
+           const float * const * samples,
+                     const int * n_samples,
+                           int   n_clips) {
+    return whisper_full_batch_with_state(ctx, ctx->state, params, samples, n_samples, n_clips);
+}
+
+// find a quiet point in [i0, i1) to split the audio at: the center of the 20 ms window with the lowest energy
+static int whisper_find_quiet_point(const float * samples, int i0, int i1) {
+    const int n_window = WHISPER_SAMPLE_RATE/50;
+
+    if (i1 - i0 <= n_window) {
+        return (i0 + i1)/2;
+    }
+
+    double energy = 0.0;
+    for (int i = i0; i < i0 + n_window; ++i) {
+        energy += samples[i]*samples[i];
+    }
+
+    double energy_min = energy;
+    int    best       = i0;
+
+    for (int i = i0 + 1; i + n_window <= i1; ++i) {
+        energy += samples[i + n_window - 1]*samples[i + n_window - 1] - samples[i - 1]*samples[i - 1];
+        if (energy < energy_min) {
+            energy_min = energy;
+            best       = i;
         }
-        if (vad_samples.empty()) {
-            ctx->state->result_all.clear();
-            return 0;
+    }
+
+    return best + n_window/2;
+}
+
+// split [i0, i1) into units of at most n_unit samples
+// units end at the last preferred cut (e.g. a VAD silence gap) that fits, otherwise at the quietest point near the limit
+static std::vector<std::pair<int, int>> whisper_parallel_units(const float * samples, int i0, int i1, int n_unit, const std::vector<int> & cuts) {
+    std::vector<std::pair<int, int>> units;
+
+    const int n_min    = WHISPER_SAMPLE_RATE;              // don't create units shorter than 1 second
+    const int n_search = std::min(5*WHISPER_SAMPLE_RATE, n_unit/4);
+
+    int pos = i0;
+    auto it = cuts.begin();
+
+    while (pos < i1) {
+        const int limit = pos + n_unit;
+        if (limit >= i1) {
+            units.emplace_back(pos, i1);
+            break;
         }
-        samples = vad_samples.data();
-        n_samples = vad_samples.size();
+
+        int cut = -1;
+        while (it != cuts.end() && *it <= limit) {
+            if (*it >= pos + n_min) {
+                cut = *it;
+            }
+            ++it;
+        }
+
+        if (cut < 0) {
+            cut = whisper_find_quiet_point(samples, std::max(pos + n_min, limit - n_search), limit);
+        }
+
+        units.emplace_back(pos, cut);
+        pos = cut;
     }
-    return whisper_full_with_state(ctx, ctx->state, params, samples, n_samples);
+
+    return units;
 }
 
 int whisper_full_parallel(
@@ -7793,6 +10425,9 @@ int whisper_full_parallel(
         return whisper_full(ctx, params, samples, n_samples);
     }
 
+    // preferred split points, in samples
+    std::vector<int> cuts;
+
     std::vector<float> vad_samples;
     if (params.vad) {
         WHISPER_LOG_INFO("%s: VAD is enabled, processing speech segments only\n", __func__);
@@ -7801,69 +10436,135 @@ int whisper_full_parallel(
             return -1;
         }
         if (vad_samples.empty()) {
+            ctx->state->result_all.clear();
             return 0;
         }
         samples = vad_samples.data();
         n_samples = vad_samples.size();
+
+        // split in the middle of the silence inserted between the speech segments
+        for (size_t i = 1; i < ctx->state->vad_segments.size(); ++i) {
+            cuts.push_back(std::max(0, cs_to_samples(ctx->state->vad_segments[i].vad_start) - WHISPER_SAMPLE_RATE/20));
+        }
     }
     int ret = 0;
 
-    // prepare separate states for each thread
-    std::vector<whisper_state*> states;
+    const int offset_samples = std::min(n_samples, (WHISPER_SAMPLE_RATE*params.offset_ms)/1000);
+    const int end_samples    = params.duration_ms > 0 ? std::min(n_samples, offset_samples + (WHISPER_SAMPLE_RATE*params.duration_ms)/1000) : n_samples;
+
+    // units of at most one encoder window, but no longer than needed to give each processor some work
+    const int n_unit = std::max(WHISPER_SAMPLE_RATE, std::min(WHISPER_CHUNK_SIZE*WHISPER_SAMPLE_RATE, (end_samples - offset_samples + n_processors - 1)/n_processors));
+
+    const auto units = whisper_parallel_units(samples, offset_samples, end_samples, n_unit, cuts);
+
+    // no audio after the offset, like whisper_full() there is nothing to transcribe
+    if (units.empty()) {
+        ctx->state->result_all.clear();
+        return 0;
+    }
+
+    const int n_units   = units.size();
+    const int n_workers = std::min(n_processors, n_units);
 
-    const int offset_samples = (WHISPER_SAMPLE_RATE*params.offset_ms)/1000;
-    const int n_samples_per_processor = (n_samples - offset_samples)/n_processors;
+    // prepare separate states for each extra worker
+    std::vector<whisper_state *> states(n_workers);
+    states[0] = ctx->state;
+    for (int i = 1; i < n_workers; ++i) {
+        states[i] = whisper_state_pool_acquire(ctx);
+        if (states[i] == nullptr) {
+            WHISPER_LOG_ERROR("%s: failed to create state for worker %d\n", __func__, i);
+            for (int j = 1; j < i; ++j) {
+                whisper_state_pool_release(ctx, states[j]);
+            }
+            return -1;
+        }
+    }
 
-    // the calling thread will process the first chunk
-    // while the other threads will process the remaining chunks
+    // the text context carried over from previous calls only applies to the first unit
+    const auto prompt_past0 = ctx->state->prompt_past0;
+    const auto prompt_past1 = ctx->state->prompt_past1;
 
-    std::vector<std::thread> workers(n_processors - 1);
-    for (int i = 0; i < n_processors - 1; ++i) {
-        // create a new state for each thread
-        states.push_back(whisper_init_state(ctx));
+    std::vector<std::vector<whisper_segment>> results(n_units);
 
-        const int start_samples = offset_samples + (i + 1)*n_samples_per_processor;
-        const int n_samples_cur = (i == n_processors - 2) ? n_samples - start_samples : n_samples_per_processor;
+    std::atomic<int> i_next(0);
+    std::atomic<int> n_done(0);
+    std::mutex       mutex_ret;
 
-        auto params_cur = params;
+    auto params_unit = params;
 
-        params_cur.offset_ms = 0;
-        params_cur.print_progress = false;
-        params_cur.print_realtime = false;
+    params_unit.offset_ms = 0;
+    params_unit.duration_ms = 0;
+    params_unit.print_progress = false;
+    params_unit.print_realtime = false;
 
-        params_cur.new_segment_callback = nullptr;
-        params_cur.new_segment_callback_user_data = nullptr;
+    // the units are cut from the speech segments already, the VAD mapping of the default state stays in place
+    params_unit.vad = false;
 
-        params_cur.progress_callback = nullptr;
-        params_cur.progress_callback_user_data = nullptr;
+    params_unit.new_segment_callback = nullptr;
+    params_unit.new_segment_callback_user_data = nullptr;
 
-        workers[i] = std::thread(whisper_full_with_state, ctx, states[i], std::move(params_cur), samples + start_samples, n_samples_cur);
-    }
+    params_unit.progress_callback = nullptr;
+    params_unit.progress_callback_user_data = nullptr;
 
-    {
-        auto params_cur = params;
+    // the workers pull units from a shared counter, so a worker that got short or silent units takes more of them
+    // the calling thread is worker 0 and uses the default state
+    ctx->workers.run(n_workers, [&](int ith, int /*nth*/) {
+        whisper_state * state = states[ith];
 
-        // We need to disable the print real-time for this one as well, otherwise it will show only for the first chunk.
-        params_cur.print_realtime = false;
+        while (true) {
+            const int iu = i_next.fetch_add(1);
+            if (iu >= n_units) {
+                break;
+            }
 
-        // Run the first transformation using default state but only for the first chunk.
-        ret = whisper_full_with_state(ctx, ctx->state, std::move(params_cur), samples, offset_samples + n_samples_per_processor);
-    }
+            if (iu == 0) {
+                state->prompt_past0 = prompt_past0;
+                state->prompt_past1 = prompt_past1;
+            } else {
+                state->prompt_past0.clear();
+                state->prompt_past1.clear();
+            }
 
-    for (int i = 0; i < n_processors - 1; ++i) {
-        workers[i].join();
-    }
+            const int ret_cur = whisper_full_with_state(ctx, state, params_unit, samples + units[iu].first, units[iu].second - units[iu].first);
+            if (ret_cur != 0) {
+                std::lock_guard<std::mutex> lock(mutex_ret);
+                if (ret == 0) {
+                    ret = ret_cur;
+                }
+                // stop handing out units
+                i_next = n_units;
+                break;
+            }
+
+            results[iu] = std::move(state->result_all);
+            state->result_all.clear();
+
+            // callbacks are only invoked from the calling thread
+            const int n_done_cur = ++n_done;
+            if (ith == 0 && params.progress_callback) {
+                params.progress_callback(ctx, ctx->state, (100*n_done_cur)/n_units, params.progress_callback_user_data);
+            }
+        }
+    });
 
     const int64_t offset_t = (int64_t) params.offset_ms/10.0;
 
-    // combine results into result_state->result_all from all other states
-    for (int i = 0; i < n_processors - 1; ++i) {
-        auto& results_i = states[i]->result_all;
+    // combine the results of the units in time order into the default state
+    ctx->state->result_all.clear();
+
+    for (int iu = 0; iu < n_units; ++iu) {
+        // correct the timestamps taking into account the start of the unit
+        const int64_t t_unit = 100*(int64_t) (units[iu].first - offset_samples)/WHISPER_SAMPLE_RATE + offset_t;
 
-        for (auto& result : results_i) {
-            // correct the segment timestamp taking into account the offset
-            result.t0 += 100 * ((i + 1) * n_samples_per_processor) / WHISPER_SAMPLE_RATE + offset_t;
-            result.t1 += 100 * ((i + 1) * n_samples_per_processor) / WHISPER_SAMPLE_RATE + offset_t;
+        for (auto & result : results[iu]) {
+            result.t0 += t_unit;
+            result.t1 += t_unit;
+
+            for (auto & token : result.tokens) {
+                if (token.t0    >= 0) token.t0    += t_unit;
+                if (token.t1    >= 0) token.t1    += t_unit;
+                if (token.t_dtw >= 0) token.t_dtw += t_unit;
+            }
 
             // make sure that segments are not overlapping
             if (!ctx->state->result_all.empty()) {
@@ -7877,7 +10578,9 @@ int whisper_full_parallel(
                 params.new_segment_callback(ctx, ctx->state, 1, params.new_segment_callback_user_data);
             }
         }
+    }
 
+    for (int i = 1; i < n_workers; ++i) {
         ctx->state->t_mel_us += states[i]->t_mel_us;
 
         ctx->state->t_sample_us += states[i]->t_sample_us;
@@ -7892,22 +10595,20 @@ int whisper_full_parallel(
         ctx->state->n_batchd += states[i]->n_batchd;
         ctx->state->n_prompt += states[i]->n_prompt;
 
-        whisper_free_state(states[i]);
+        whisper_state_pool_release(ctx, states[i]);
     }
 
     // average the timings
-    ctx->state->t_mel_us    /= n_processors;
-    ctx->state->t_sample_us /= n_processors;
-    ctx->state->t_encode_us /= n_processors;
-    ctx->state->t_decode_us /= n_processors;
+    ctx->state->t_mel_us    /= n_workers;
+    ctx->state->t_sample_us /= n_workers;
+    ctx->state->t_encode_us /= n_workers;
+    ctx->state->t_decode_us /= n_workers;
 
     // print information about the audio boundaries
-    WHISPER_LOG_WARN("\n");
-    WHISPER_LOG_WARN("%s: the audio has been split into %d chunks at the following times:\n", __func__, n_processors);
-    for (int i = 0; i < n_processors - 1; ++i) {
-        WHISPER_LOG_WARN("%s: split %d - %s\n", __func__, (i + 1), to_timestamp(100*((i + 1)*n_samples_per_processor)/WHISPER_SAMPLE_RATE + offset_t).c_str());
+    WHISPER_LOG_INFO("%s: the audio has been split into %d units processed by %d workers:\n", __func__, n_units, n_workers);
+    for (int iu = 1; iu < n_units; ++iu) {
+        WHISPER_LOG_INFO("%s: split %d - %s\n", __func__, iu, to_timestamp(100*(int64_t) (units[iu].first - offset_samples)/WHISPER_SAMPLE_RATE + offset_t).c_str());
     }
-    WHISPER_LOG_WARN("%s: the transcription quality may be degraded near these boundaries\n", __func__);
 
     return ret;
 }
@@ -7928,6 +10629,22 @@ int whisper_full_lang_id(struct whisper_context * ctx) {
     return ctx->state->lang_id;
 }
 
+int whisper_full_clip_lang_id_from_state(struct whisper_state * state, int i_clip) {
+    return state->clip_lang_ids[i_clip];
+}
+
+int whisper_full_clip_lang_id(struct whisper_context * ctx, int i_clip) {
+    return ctx->state->clip_lang_ids[i_clip];
+}
+
+int whisper_full_get_segment_clip_from_state(struct whisper_state * state, int i_segment) {
+    return state->result_all[i_segment].clip;
+}
+
+int whisper_full_get_segment_clip(struct whisper_context * ctx, int i_segment) {
+    return ctx->state->result_all[i_segment].clip;
+}
+
 static int64_t map_processed_to_original_time(int64_t processed_time, const std::vector<vad_time_mapping> & mapping_table) {
     if (mapping_table.empty()) {
         return processed_time;
@@ -8701,62 +11418,74 @@ static std::vector<uint32_t> get_alignment_heads_by_layer(const whisper_context_
 // https://github.com/openai/whisper/blob/main/whisper/timing.py#L83
 static wsp_ggml_tensor * dtw_and_backtrace(wsp_ggml_context * ctx, wsp_ggml_tensor * x) {
     WHISPER_ASSERT(wsp_ggml_n_dims(x) == 2);
+    WHISPER_ASSERT(x->type == WSP_GGML_TYPE_F32);
+    WHISPER_ASSERT(x->nb[0] == sizeof(float));
 
-    int64_t N = x->ne[0];
-    int64_t M = x->ne[1];
-    struct wsp_ggml_tensor * cost = wsp_ggml_new_tensor_2d(ctx, WSP_GGML_TYPE_F32, N + 1, M + 1);
-    struct wsp_ggml_tensor * trace = wsp_ggml_new_tensor_2d(ctx, WSP_GGML_TYPE_I32, N + 1, M + 1);
+    const int64_t N = x->ne[0];
+    const int64_t M = x->ne[1];
 
-    cost = whisper_set_f32(cost, INFINITY);
-    trace = whisper_set_i32(trace, -1);
-    whisper_set_f32_nd(cost, 0, 0, 0, 0, 0.0);
+    // the cells (i, j) with i + j = d only depend on the diagonals d - 1 and d - 2, so the cost matrix is filled one
+    // anti-diagonal at a time, each of them with a loop without dependencies that the compiler can vectorize
+    // the diagonal d is stored at d*(N + 1) and indexed by i, only the last three diagonals of the cost are kept
+    const int64_t n_diag = N + M + 1;
+    const int64_t stride = N + 1;
+
+    float  * xd    = (float  *) wsp_ggml_new_tensor_2d(ctx, WSP_GGML_TYPE_F32, stride, n_diag)->data; // x(i - 1, j - 1) of the cell (i, j)
+    float  * cost  = (float  *) wsp_ggml_new_tensor_2d(ctx, WSP_GGML_TYPE_F32, stride, 3)->data;
+    int8_t * trace = (int8_t *) wsp_ggml_new_tensor_2d(ctx, WSP_GGML_TYPE_I8,  stride, n_diag)->data;
 
-    // dtw
-    // supposedly can be optmized by computing diagonals in parallel ?
-    // Not sure it is worth it since x will be GENERATED_TOKENS*1500 size at most.
     for (int64_t j = 1; j < M + 1; ++j) {
+        const float * xj = (const float *) ((const char *) x->data + (j - 1)*x->nb[1]);
         for (int64_t i = 1; i < N + 1; ++i) {
-            float c0 = whisper_get_f32_nd(cost, i - 1, j - 1, 0, 0);
-            float c1 = whisper_get_f32_nd(cost, i - 1, j, 0, 0);
-            float c2 = whisper_get_f32_nd(cost, i, j - 1, 0, 0);
-
-            float c;
-            int32_t t;
-            if (c0 < c1 && c0 < c2) {
-                c = c0;
-                t = 0;
-            } else if (c1 < c0 && c1 < c2) {
-                c = c1;
-                t = 1;
-            } else {
-                c = c2;
-                t = 2;
-            }
+            xd[(i + j)*stride + i] = xj[i - 1];
+        }
+    }
+
+    // dtw
+    std::fill(cost, cost + 3*stride, INFINITY);
+    cost[0] = 0.0f;
+    for (int64_t d = 1; d < n_diag; ++d) {
+        float       * c  = cost + ((d + 0) % 3)*stride;
+        const float * c1 = cost + ((d + 2) % 3)*stride; // d - 1
+        const float * c2 = cost + ((d + 1) % 3)*stride; // d - 2
+
+        // the borders (0, d) and (d, 0)
+        c[0] = INFINITY;
+        if (d < N + 1) {
+            c[d] = INFINITY;
+        }
+
+        const float * xdd = xd    + d*stride;
+        int8_t      * t   = trace + d*stride;
 
-            c = whisper_get_f32_nd(x, i - 1, j - 1, 0, 0) + c;
-            whisper_set_f32_nd(cost, i, j, 0, 0, c);
-            whisper_set_i32_nd(trace, i, j, 0, 0, t);
+        const int64_t i0 = std::max<int64_t>(1, d - M);
+        const int64_t i1 = std::min<int64_t>(N, d - 1);
+
+        for (int64_t i = i0; i <= i1; ++i) {
+            const float v0 = c2[i - 1]; // (i - 1, j - 1)
+            const float v1 = c1[i - 1]; // (i - 1, j)
+            const float v2 = c1[i];     // (i, j - 1)
+
+            // no short-circuit to keep the loop free of branches, b0 and b1 are exclusive
+            const int b0 = (v0 < v1) & (v0 < v2);
+            const int b1 = (v1 < v0) & (v1 < v2);
+
+            c[i] = xdd[i] + (b0 ? v0 : b1 ? v1 : v2);
+            t[i] = 2 - b1 - 2*b0;
         }
     }
 
     // Backtrace
-    const int64_t BT_MAX_ROWS = N + M - 1;
-    struct wsp_ggml_tensor * bt = wsp_ggml_new_tensor_2d(ctx, WSP_GGML_TYPE_I32, BT_MAX_ROWS, 2);
-    // trace[0, :] = 2;
-    for (int64_t i = 0; i < M + 1; ++i)
-        whisper_set_i32_nd(trace, 0, i, 0, 0, 2);
-    //trace[:, 0] = 1;
-    for (int64_t i = 0; i < N + 1; ++i)
-        whisper_set_i32_nd(trace, i, 0, 0, 0, 1);
-    int bt_row_idx = BT_MAX_ROWS - 1;
+    // trace[0, :] = 2, trace[:, 0] = 1
+    int32_t * bt = (int32_t *) wsp_ggml_new_tensor_1d(ctx, WSP_GGML_TYPE_I32, 2*(N + M))->data;
+    int64_t n_bt = 0;
     int64_t i = N;
     int64_t j = M;
     while (i > 0 || j > 0) {
-        whisper_set_i32_nd(bt, bt_row_idx, 0, 0, 0, i - 1);
-        whisper_set_i32_nd(bt, bt_row_idx, 1, 0, 0, j - 1);
-        --bt_row_idx;
+        bt[n_bt++] = i - 1;
+        bt[n_bt++] = j - 1;
 
-        int32_t t = whisper_get_i32_nd(trace, i, j, 0, 0);
+        const int32_t t = i == 0 ? 2 : j == 0 ? 1 : trace[(i + j)*stride + i];
         if (t == 0) {
             --i;
             --j;
@@ -8769,17 +11498,15 @@ static wsp_ggml_tensor * dtw_and_backtrace(wsp_ggml_context * ctx, wsp_ggml_tens
         }
     }
 
-    // FIXME: manual clip/transpose might not be the most efficient way? (e.g. use ggml funcs)
-    // Clip + transpose
+    // Reverse + transpose
     // This might not be entirely necessary for our case, but leaving it for now so output matrix
     // is identical to dtw on openAI timing.py
-    const int64_t result_n_cols = BT_MAX_ROWS-bt_row_idx-1;
+    const int64_t result_n_cols = n_bt/2;
     wsp_ggml_tensor * r = wsp_ggml_new_tensor_2d(ctx, WSP_GGML_TYPE_I32, 2, result_n_cols);
-    for (int64_t i = 0; i < 2; ++i) {
-        for (int64_t j = 0; j < result_n_cols; ++j) {
-            int32_t v = whisper_get_i32_nd(bt, j+bt_row_idx+1, i, 0, 0);
-            whisper_set_i32_nd(r, i, j, 0, 0, v);
-        }
+    int32_t * rd = (int32_t *) r->data;
+    for (int64_t k = 0; k < result_n_cols; ++k) {
+        rd[2*k + 0] = bt[2*(result_n_cols - 1 - k) + 0];
+        rd[2*k + 1] = bt[2*(result_n_cols - 1 - k) + 1];
     }
 
     return r;
@@ -8789,124 +11516,192 @@ struct median_filter_user_data {
     int filter_width;
 };
 
-static void median_filter(struct wsp_ggml_tensor * dst , const struct wsp_ggml_tensor * a, int ith, int /*nth*/, void * userdata) {
-    if (ith != 0) {
-        return;
-    }
+static void median_filter(struct wsp_ggml_tensor * dst , const struct wsp_ggml_tensor * a, int ith, int nth, void * userdata) {
     int filter_width = ((median_filter_user_data *) userdata)->filter_width;
     WHISPER_ASSERT(filter_width < a->ne[2]);
     WHISPER_ASSERT(filter_width % 2);
     WHISPER_ASSERT(wsp_ggml_n_dims(a) == 3);
     WHISPER_ASSERT(a->type == WSP_GGML_TYPE_F32);
 
-    std::vector<float> filter;
-    filter.reserve(filter_width);
-    for (int64_t i = 0; i < a->ne[0]; ++i) {
-        for (int64_t j = 0; j < a->ne[1]; ++j) {
-            for (int64_t k = 0; k < a->ne[2]; ++k) {
-                for (int64_t off = -filter_width/2; off <= filter_width/2; ++off) {
-                    // "reflect" padding
-                    int64_t idx = k + off;
-                    if (idx < 0) {
-                        idx = -idx;
-                    } else if (idx >= a->ne[2]) {
-                        idx = 2*(a->ne[2] - 1) - idx;
-                    }
+    const int64_t n    = a->ne[2];
+    const int64_t half = filter_width/2;
+
+    // rows are split between the threads in contiguous blocks
+    const int64_t n_rows = a->ne[0]*a->ne[1];
+    const int64_t r0 = (n_rows*(ith + 0))/nth;
+    const int64_t r1 = (n_rows*(ith + 1))/nth;
+
+    // the windows of all the elements of a row are sorted together: the x-th value of every window is stored in the
+    // lane x and an odd-even transposition network runs over the lanes, so each min/max step is a loop over the row
+    // without dependencies between the elements (for small widths this is faster than sliding a sorted window)
+    std::vector<float> row(n + 2*half); // the row with "reflect" padding
+    std::vector<float> lanes(filter_width*n);
+
+    for (int64_t r = r0; r < r1; ++r) {
+        const int64_t i = r / a->ne[1];
+        const int64_t j = r % a->ne[1];
+
+        const char * src = (const char *) a->data + i*a->nb[0] + j*a->nb[1];
+        for (int64_t k = -half; k < n + half; ++k) {
+            const int64_t idx = k < 0 ? -k : k >= n ? 2*(n - 1) - k : k;
+            row[k + half] = *(const float *) (src + idx*a->nb[2]);
+        }
 
-                    filter.push_back(whisper_get_f32_nd(a, i, j, idx, 0));
+        for (int x = 0; x < filter_width; ++x) {
+            std::copy(row.begin() + x, row.begin() + x + n, lanes.begin() + x*n);
+        }
+
+        for (int pass = 0; pass < filter_width; ++pass) {
+            for (int x = pass % 2; x + 1 < filter_width; x += 2) {
+                float * lo = lanes.data() + (x + 0)*n;
+                float * hi = lanes.data() + (x + 1)*n;
+                for (int64_t k = 0; k < n; ++k) {
+                    const float v0 = lo[k];
+                    const float v1 = hi[k];
+                    lo[k] = std::min(v0, v1);
+                    hi[k] = std::max(v0, v1);
                 }
-                std::sort(filter.begin(), filter.end());
-                const float v = filter[filter.size()/2];
-                whisper_set_f32_nd(dst, i, j, k, 0, v);
-                filter.clear();
             }
         }
+
+        const float * median = lanes.data() + half*n;
+        char * out = (char *) dst->data + i*dst->nb[0] + j*dst->nb[1];
+        for (int64_t k = 0; k < n; ++k) {
+            *(float *) (out + k*dst->nb[2]) = median[k];
+        }
     }
 }
 
-static void whisper_exp_compute_token_level_timestamps_dtw(
+// [EXPERIMENTAL] Token-level timestamps with DTW
+// The cross attention QKs of the alignment heads were kept during decoding, see whisper_aheads_store_row()
+// Pick the rows that a decode of sot + [lang] + not + text result + eot would produce: the sot and language rows
+// of the prompt (not the task), the row that sampled the first text token, the rows that had a text token as
+// input and the eot row
+// The text tokens are those of the segments, i.e. all the sampled tokens: result_len is 0 when every temperature
+// of the fallback failed, the segments are still made of the tokens of the last attempt
+static void whisper_aheads_rows_from_sequence(
+            struct whisper_context * ctx,
+            const whisper_sequence & sequence,
+  const std::vector<whisper_token> & prompt_init,
+                               int   eot_row,
+              std::vector<int32_t> & w_rows,
+                               int & n_sot) {
+    const auto & tokens = sequence.tokens;
+    const auto & rows   = sequence.aheads_rows;
+
+    w_rows.clear();
+    for (int k = 0; k < (int) prompt_init.size(); ++k) {
+        if (prompt_init[k] == whisper_token_sot(ctx) ||
+           (prompt_init[k] > whisper_token_sot(ctx) && prompt_init[k] < whisper_token_translate(ctx))) {
+            w_rows.push_back(k);
+        }
+    }
+    n_sot = w_rows.size();
+
+    int n_text = 0;
+    for (int i = 0; i < (int) tokens.size(); ++i) {
+        if (tokens[i].id >= whisper_token_eot(ctx)) {
+            continue;
+        }
+        if (n_text++ == 0) {
+            w_rows.push_back(rows[i]);
+        }
+        w_rows.push_back(rows[i + 1]);
+    }
+    if (n_text == 0) {
+        w_rows.clear();
+        return;
+    }
+    w_rows.push_back(eot_row);
+}
+
+// [EXPERIMENTAL] Token-level timestamps with DTW
+// decode sot + [lang] + not + the text tokens of the segments from i_segment on + eot and keep the rows of all of
+// them, for the windows decoded with timestamps: the timestamp tokens are not part of the DTW sequence, so the rows
+// kept during decoding saw a different context
+static bool whisper_aheads_rows_decode(
             struct whisper_context * ctx,
               struct whisper_state * state,
-        struct whisper_full_params   params,
                                int   i_segment,
-                            size_t   n_segments,
-                               int   seek,
-                               int   n_frames,
-                               int   medfilt_width,
-                               int   n_threads)
-{
-    const int n_audio_ctx = state->exp_n_audio_ctx > 0 ? state->exp_n_audio_ctx : ctx->model.hparams.n_audio_ctx;
-    WHISPER_ASSERT(medfilt_width % 2);
-    WHISPER_ASSERT(n_frames <= n_audio_ctx * 2);
-    WHISPER_ASSERT(ctx->params.dtw_aheads_preset != WHISPER_AHEADS_NONE);
-
-    // FIXME: Allocating mem everytime we call this func
-    // Our ggml buffer should be pre-allocated somewhere during init and reused
-    // when we call this function
-    struct wsp_ggml_init_params gparams = {
-        /*.mem_size   =*/ ctx->params.dtw_mem_size,
-        /*.mem_buffer =*/ NULL,
-        /*.no_alloc   =*/ false,
-    };
-    struct wsp_ggml_context * gctx = wsp_ggml_init(gparams);
-
-    // Build token sequence that will be passed to decoder
-    // sot + [lang] + text result + eot
+                               int   n_threads,
+              std::vector<int32_t> & w_rows,
+                               int & n_sot) {
     std::vector<whisper_token> tokens = { whisper_token_sot(ctx), };
     if (whisper_is_multilingual(ctx)) {
-        const int lang_id = whisper_lang_id(params.language);
-        state->lang_id = lang_id;
-        tokens.push_back(whisper_token_lang(ctx, lang_id));
+        tokens.push_back(whisper_token_lang(ctx, state->lang_id));
     }
-    const size_t sot_sequence_length = tokens.size();
+    n_sot = tokens.size();
     tokens.push_back(whisper_token_not(ctx));
-    for (size_t i = i_segment; i < i_segment + n_segments; ++i) {
-        auto & segment = state->result_all[i];
-        for (auto &t: segment.tokens) {
-            // Only text tokens
+    for (size_t i = i_segment; i < state->result_all.size(); ++i) {
+        for (const auto & t : state->result_all[i].tokens) {
             if (t.id < whisper_token_eot(ctx)) {
                 tokens.push_back(t.id);
             }
         }
     }
+
+    w_rows.clear();
+    if ((int) tokens.size() == n_sot + 1) {
+        return true;
+    }
     tokens.push_back(whisper_token_eot(ctx));
 
-    // Get result tokens, pass then along to decoder to get cross attention QKs
-    // used in timestamping
-    // Decoder already returns only alignment head QKs, already concatenated in
-    // one tensor.
     whisper_kv_cache_clear(state->kv_self);
     whisper_batch_prep_legacy(state->batch, tokens.data(), tokens.size(), 0, 0);
-    whisper_kv_cache_seq_rm(state->kv_self, 0, 0, -1);
     if (!whisper_decode_internal(*ctx, *state, state->batch, n_threads, true, nullptr, nullptr)) {
-        WHISPER_LOG_INFO("DECODER FAILED\n");
-        WHISPER_ASSERT(0);
+        return false;
+    }
+
+    whisper_aheads_reset_rows(*state);
+    for (int i = 0; i < (int) tokens.size(); ++i) {
+        w_rows.push_back(whisper_aheads_store_row(*state, i));
+    }
+
+    return true;
+}
+
+// the rows of w_rows start with the n_sot rows of sot + [lang] and end with the eot row, see
+// whisper_aheads_rows_from_sequence() and whisper_aheads_rows_decode()
+static void whisper_exp_compute_token_level_timestamps_dtw(
+            struct whisper_context * ctx,
+              struct whisper_state * state,
+        const std::vector<int32_t> & w_rows,
+                               int   n_sot,
+                               int   i_segment,
+                               int   seek,
+                               int   n_frames,
+                               int   medfilt_width,
+                               int   n_threads)
+{
+    WHISPER_ASSERT(medfilt_width % 2);
+    WHISPER_ASSERT(ctx->params.dtw_aheads_preset != WHISPER_AHEADS_NONE);
+
+    if (w_rows.empty()) {
+        return;
     }
-    WHISPER_ASSERT(state->aheads_cross_QKs != nullptr);
 
-    const auto n_audio_tokens = n_frames/2;
-    WHISPER_ASSERT(state->aheads_cross_QKs != NULL);
-    WHISPER_ASSERT(n_audio_tokens <= state->aheads_cross_QKs->ne[1]);
-    const auto n_tokens = state->aheads_cross_QKs->ne[0];
-    const auto n_heads = state->aheads_cross_QKs->ne[2];
+    // The scratch is allocated in whisper_init_state() for the longest window and reused
+    struct wsp_ggml_context * gctx = state->dtw_ctx;
+    wsp_ggml_reset(gctx);
+
+    const int n_audio_tokens = std::min(n_frames/2, state->aheads_n_audio);
+    const int n_tokens = w_rows.size();
+    int n_heads = 0;
+    for (const auto * m : state->aheads_masks.m) {
+        n_heads += m ? m->ne[1] : 0;
+    }
 
-    // Copy data from decoder buffer to a local CPU tensor, discarding unused audio
-    // tokens (i.e. discarding rows at the end of tensor)
-    // IN: Tensor with N_TOKENS*audio_ctx*N_ALIGNMENT_HEADS dims
+    // Gather the rows in a local CPU tensor, discarding unused audio tokens
+    // IN: Rows with N_AUDIO*N_ALIGNMENT_HEADS dims
     // OUT: Tensor with N_TOKENS*N_AUDIO_TOKENS*N_ALIGNMENT_HEADS dims
-    WHISPER_ASSERT(state->aheads_cross_QKs->type == WSP_GGML_TYPE_F32);
-    WHISPER_ASSERT(wsp_ggml_is_contiguous(state->aheads_cross_QKs));
     wsp_ggml_tensor * w = wsp_ggml_new_tensor_3d(gctx, WSP_GGML_TYPE_F32, n_tokens, n_audio_tokens, n_heads);
-    auto & data = state->aheads_cross_QKs_data;
-    data.resize(n_tokens * n_audio_ctx * n_heads);
-    wsp_ggml_backend_tensor_get(state->aheads_cross_QKs, data.data(), 0, sizeof(float) * n_tokens * n_audio_ctx * n_heads);
-    for (int k = 0; k < n_heads; ++k) {
+    const size_t n_row = (size_t) n_heads*state->aheads_n_audio;
+    for (int i = 0; i < n_tokens; ++i) {
+        const float * row = state->aheads_cross_QKs_data.data() + w_rows[i]*n_row;
         for (int j = 0; j < n_audio_tokens; ++j) {
-            memcpy(
-                (char *) w->data + j * w->nb[1] + k * w->nb[2],
-                data.data() + j * n_tokens + k * n_tokens * n_audio_ctx,
-                n_tokens * sizeof(float)
-            );
+            for (int k = 0; k < n_heads; ++k) {
+                *(float *) ((char *) w->data + i*w->nb[0] + j*w->nb[1] + k*w->nb[2]) = row[j*n_heads + k];
+            }
         }
     }
 
@@ -8916,32 +11711,34 @@ static void whisper_exp_compute_token_level_timestamps_dtw(
     // operation (after median filter)
     // IN: Tensor with N_TOKENS*N_AUDIO_TOKENS*N_ALIGNMENT_HEADS dims
     // OUT: Tensor with N_ALIGNMENT_HEADS*N_TOKENS*N_AUDIO_TOKENS dims
-    w = wsp_ggml_norm(gctx, w, 1e-9f);
+    w = wsp_ggml_norm_inplace(gctx, w, 1e-9f);
     w = wsp_ggml_permute(gctx, wsp_ggml_permute(gctx, w, 2, 1, 0 ,3), 0, 2, 1, 3);
 
     // Pass median filter - this is done over AUDIO_TOKENS dimension.
     // IN: Tensor with N_ALIGNMENT_HEADS*N_TOKENS*N_AUDIO_TOKENS dims
     // OUT: Same dims
     median_filter_user_data mf_user_data = {medfilt_width};
-    w = wsp_ggml_map_custom1(gctx, w, median_filter, 1, &mf_user_data);
+    w = wsp_ggml_map_custom1(gctx, w, median_filter, WSP_GGML_N_TASKS_MAX, &mf_user_data);
 
     // Take mean over columns, scale by -1, reshape to 2D tensor, remove SOT sequence and EOT
     // IN: Tensor with N_ALIGNMENT_HEADS*N_TOKENS*N_AUDIO_TOKENS dims
     // OUT: Tensor with N_TOKENS*N_AUDIO_TOKENS dims
     w = wsp_ggml_mean(gctx, w);
-    w = wsp_ggml_scale(gctx, w, -1.0);
+    w = wsp_ggml_scale_inplace(gctx, w, -1.0);
     w = wsp_ggml_reshape_2d(gctx, w, w->ne[1], w->ne[2]);
 
     // Remove SOT sequence and EOT
-    // Out dimension is (N_TOKENS-sot_sequence_length-1)*N_AUDIO_TOKENS
-    w = wsp_ggml_view_2d(gctx, w, w->ne[0] - sot_sequence_length - 1, w->ne[1], w->nb[1], sot_sequence_length * w->nb[0]);
+    // Out dimension is (N_TOKENS-n_sot-1)*N_AUDIO_TOKENS
+    w = wsp_ggml_view_2d(gctx, w, w->ne[0] - n_sot - 1, w->ne[1], w->nb[1], n_sot * w->nb[0]);
 
     // Compute
     struct wsp_ggml_cgraph * gf = wsp_ggml_new_graph(gctx);
     wsp_ggml_build_forward_expand(gf, w);
 
-    wsp_ggml_backend_ptr backend { wsp_ggml_backend_init_by_type(WSP_GGML_BACKEND_DEVICE_TYPE_CPU, nullptr) };
-    wsp_ggml_backend_graph_compute(backend.get(), gf);
+    wsp_ggml_backend_t backend_cpu = state->dtw_backend;
+    wsp_ggml_backend_cpu_set_n_threads(backend_cpu, n_threads);
+    whisper_cpu_threadpool_attach(state->threadpool, &backend_cpu, 1, n_threads);
+    wsp_ggml_backend_graph_compute(backend_cpu, gf);
 
     wsp_ggml_tensor * alignment = dtw_and_backtrace(gctx, w);
 
@@ -8975,7 +11772,7 @@ static void whisper_exp_compute_token_level_timestamps_dtw(
     }
 
     // Print DTW timestamps
-    /*for (size_t i = i_segment; i < i_segment + n_segments; ++i) {
+    /*for (size_t i = i_segment; i < state->result_all.size(); ++i) {
         auto & segment = state->result_all[i];
         for (auto &t: segment.tokens) {
             const char * tok = whisper_token_to_str(ctx, t.id);
@@ -8983,8 +11780,224 @@ static void whisper_exp_compute_token_level_timestamps_dtw(
         }
         fprintf(stderr, "\n");
     }*/
+}
+
+WHISPER_API int whisper_bench_dtw(struct whisper_context * ctx, int n_threads) {
+    fputs(whisper_bench_dtw_str(ctx, n_threads), stderr);
+    return 0;
+}
+
+// the peak resident set size of the process in MB, 0 if unknown
+static double whisper_peak_rss_mb() {
+#if defined(__APPLE__)
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss/1e6 : 0.0; // bytes
+#elif defined(__unix__)
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss/1e3 : 0.0; // kilobytes
+#else
+    return 0.0;
+#endif
+}
+
+// suppress eot until n_text tokens were sampled, then force it, so that every run aligns the same number of tokens
+static void whisper_bench_dtw_logits_filter(
+        struct whisper_context * ctx,
+          struct whisper_state * /*state*/,
+      const whisper_token_data * /*tokens*/,
+                           int   n_tokens,
+                         float * logits,
+                          void * user_data) {
+    const int n_text = *(const int *) user_data;
+    const whisper_token token_eot = whisper_token_eot(ctx);
+
+    if (n_tokens < n_text) {
+        logits[token_eot] = -INFINITY;
+        return;
+    }
+
+    for (int i = 0; i < whisper_n_vocab(ctx); ++i) {
+        if (i != token_eot) {
+            logits[i] = -INFINITY;
+        }
+    }
+}
+
+WHISPER_API const char * whisper_bench_dtw_str(struct whisper_context * ctx, int n_threads) {
+    static std::string s;
+    s = "";
+    char strbuf[256];
+
+    wsp_ggml_time_init();
+
+    // the DTW state memory only exists for contexts created with dtw_token_timestamps, use the alignment heads of the
+    // last text layer for the other ones - the temporary state is built without flash attention, like such contexts
+    const whisper_context_params cparams = ctx->params;
+    if (!ctx->params.dtw_token_timestamps) {
+        ctx->params.dtw_token_timestamps = true;
+        ctx->params.dtw_aheads_preset    = WHISPER_AHEADS_N_TOP_MOST;
+        ctx->params.dtw_n_top            = 1;
+    }
+    ctx->params.flash_attn = false;
+
+    const double rss0 = whisper_peak_rss_mb();
+
+    whisper_state * state = whisper_init_state(ctx);
+    if (state == nullptr) {
+        ctx->params = cparams;
+        s = "dtw: failed to initialize the state\n";
+        return s.c_str();
+    }
+
+    int n_heads = 0;
+    for (const auto * m : state->aheads_masks.m) {
+        n_heads += m ? m->ne[1] : 0;
+    }
+
+    // the median filter and the DTW of whisper_exp_compute_token_level_timestamps_dtw() for a full 30 s window, in
+    // the scratch that whisper_init_state() allocated for the longest window
+    const int n_frames     = ctx->model.hparams.n_audio_ctx;
+    const int n_iter       = 5;
+    const int n_tokens_max = ctx->model.hparams.n_text_ctx/2;
+
+    struct wsp_ggml_context * gctx = state->dtw_ctx;
+
+    wsp_ggml_backend_cpu_set_n_threads(state->dtw_backend, n_threads);
+
+    for (int n_tokens : { 32, 64, 128, n_tokens_max }) {
+        int64_t t_medfilt_us = 0;
+        int64_t t_dtw_us     = 0;
+
+        for (int it = 0; it < n_iter; ++it) {
+            wsp_ggml_reset(gctx);
+
+            wsp_ggml_tensor * a = wsp_ggml_new_tensor_3d(gctx, WSP_GGML_TYPE_F32, n_heads, n_tokens, n_frames);
+            for (int64_t i = 0; i < wsp_ggml_nelements(a); ++i) {
+                ((float *) a->data)[i] = (float) rand()/RAND_MAX;
+            }
+
+            median_filter_user_data mf_user_data = {7};
+            wsp_ggml_tensor * w = wsp_ggml_map_custom1(gctx, a, median_filter, WSP_GGML_N_TASKS_MAX, &mf_user_data);
+            w = wsp_ggml_mean(gctx, w);
+            w = wsp_ggml_reshape_2d(gctx, w, w->ne[1], w->ne[2]);
+
+            struct wsp_ggml_cgraph * gf = wsp_ggml_new_graph(gctx);
+            wsp_ggml_build_forward_expand(gf, w);
+
+            const int64_t t0 = wsp_ggml_time_us();
+
+            wsp_ggml_backend_graph_compute(state->dtw_backend, gf);
+
+            const int64_t t1 = wsp_ggml_time_us();
+
+            dtw_and_backtrace(gctx, w);
+
+            const int64_t t2 = wsp_ggml_time_us();
+
+            t_medfilt_us += t1 - t0;
+            t_dtw_us     += t2 - t1;
+        }
+
+        snprintf(strbuf, sizeof(strbuf), "dtw: %4d tokens x %4d frames x %2d heads: median filter %8.3f ms, dtw %8.3f ms (%d thread)\n",
+                n_tokens, n_frames, n_heads, 1e-3*t_medfilt_us/n_iter, 1e-3*t_dtw_us/n_iter, n_threads);
+        s += strbuf;
+    }
+
+    // whisper_full() with token timestamps over a 30 s window of noise, without and with the DTW timestamps
+    {
+        const int n_text = 128;
+
+        std::vector<float> pcm(WHISPER_SAMPLE_RATE*WHISPER_CHUNK_SIZE);
+        uint32_t seed = 1;
+        for (auto & x : pcm) {
+            seed = seed*1664525u + 1013904223u;
+            x = 0.1f*((float) (seed >> 8)/(1 << 24) - 0.5f);
+        }
+
+        whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+        wparams.n_threads        = n_threads;
+        wparams.print_progress   = false;
+        wparams.print_realtime   = false;
+        wparams.print_timestamps = false;
+        wparams.no_timestamps    = true;
+        wparams.token_timestamps = true;
+        wparams.temperature_inc  = 0.0f;
+        wparams.language         = "en";
+
+        wparams.logits_filter_callback           = whisper_bench_dtw_logits_filter;
+        wparams.logits_filter_callback_user_data = (void *) &n_text;
+
+        double t_ms  [2] = { 0.0, 0.0 };
+        double rss_mb[2] = { 0.0, 0.0 };
+        int ret = 0;
+
+        // the first run allocates the compute buffers, the run with DTW comes last so that its peak RSS shows
+        for (int it = 0; it < 3 && ret == 0; ++it) {
+            const bool dtw = it == 2;
+            ctx->params.dtw_token_timestamps = dtw;
+
+            const int64_t t0 = wsp_ggml_time_us();
+            ret = whisper_full_with_state(ctx, state, wparams, pcm.data(), pcm.size());
+            t_ms  [dtw] = 1e-3*(wsp_ggml_time_us() - t0);
+            rss_mb[dtw] = whisper_peak_rss_mb();
+        }
+
+        if (ret != 0) {
+            snprintf(strbuf, sizeof(strbuf), "dtw: whisper_full failed: %d\n", ret);
+            s += strbuf;
+        } else {
+            snprintf(strbuf, sizeof(strbuf), "dtw: whisper_full 30 s, %d tokens: %8.2f ms, with dtw %8.2f ms (%d thread)\n",
+                    n_text, t_ms[0], t_ms[1], n_threads);
+            s += strbuf;
+            snprintf(strbuf, sizeof(strbuf), "dtw: scratch %7.2f MB, peak RSS %7.2f MB before the state, %7.2f MB after whisper_full, %7.2f MB with dtw\n",
+                    wsp_ggml_get_mem_size(state->dtw_ctx)/1e6, rss0, rss_mb[0], rss_mb[1]);
+            s += strbuf;
+
+            // parity of the rows kept during decoding with a decode of the DTW sequence after the window, which is
+            // what the windows decoded with timestamps use - the batched decode rounds differently, so a few near ties
+            // of the DTW path can flip (mostly with the N_TOP_MOST heads), and the rows of multilingual models kept
+            // during decoding also saw the task token
+            std::vector<int64_t> t_dtw;
+            for (const auto & segment : state->result_all) {
+                for (const auto & token : segment.tokens) {
+                    t_dtw.push_back(token.t_dtw);
+                }
+            }
+
+            std::vector<int32_t> w_rows;
+            int n_sot = 0;
+
+            if (!whisper_aheads_rows_decode(ctx, state, 0, n_threads, w_rows, n_sot)) {
+                s += "dtw: failed to decode the DTW sequence\n";
+            } else {
+                whisper_exp_compute_token_level_timestamps_dtw(ctx, state, w_rows, n_sot, 0, 0, WHISPER_CHUNK_SIZE*100, 7, n_threads);
+
+                int     n_timed  = 0;
+                int     n_match  = 0;
+                int64_t max_diff = 0;
+                size_t  k        = 0;
+                for (const auto & segment : state->result_all) {
+                    for (const auto & token : segment.tokens) {
+                        if (token.id < whisper_token_eot(ctx)) {
+                            n_timed  += 1;
+                            n_match  += token.t_dtw == t_dtw[k];
+                            max_diff  = std::max(max_diff, std::abs(token.t_dtw - t_dtw[k]));
+                        }
+                        k++;
+                    }
+                }
+
+                snprintf(strbuf, sizeof(strbuf), "dtw: rows kept during decoding vs decoded after the window: %d of %d timestamps match, max diff %d ms\n",
+                        n_match, n_timed, (int) (10*max_diff));
+                s += strbuf;
+            }
+        }
+    }
 
-    wsp_ggml_free(gctx);
+    whisper_free_state(state);
+    ctx->params = cparams;
+
+    return s.c_str();
 }
 
 void whisper_log_set(wsp_ggml_log_callback log_callback, void * user_data) {
@@ -126,7 +126,24 @@ extern "C" {
         int dtw_n_top;
         struct whisper_aheads dtw_aheads;
 
-        size_t dtw_mem_size; // TODO: remove
+        size_t dtw_mem_size; // deprecated and ignored, the DTW scratch is sized by whisper_init_state()
+
+        // max bytes of the LRU cache of the cross-attention KV of recently encoded mel windows (0 = disabled)
+        // a window that was already encoded by the state is restored from the cache instead of running the encoder
+        size_t kv_cross_cache_size;
+
+        // data type of the K and V of the self-attention and cross-attention caches: F16 (default), F32, Q8_0 or Q4_0
+        // a quantized V cache requires flash_attn, without it V is stored transposed and is kept in F16
+        enum wsp_ggml_type type_k;
+        enum wsp_ggml_type type_v;
+
+        // place the weights in the extra CPU buffer types (default: true)
+        // the repack buffer interleaves the rows of quantized matrices for the GEMM / GEMV kernels of the CPU
+        // the repacked weights are copies, they are not mapped from the model file (see use_mmap)
+        bool use_extra_bufts;
+
+        // map the model file and use the CPU weights in place instead of reading them (default: true)
+        bool use_mmap;
     };
 
     typedef struct whisper_token_data {
@@ -214,6 +231,15 @@ extern "C" {
     WHISPER_API struct whisper_context * whisper_init_from_buffer_with_params_no_state(void * buffer, size_t buffer_size,    struct whisper_context_params params);
     WHISPER_API struct whisper_context * whisper_init_with_params_no_state            (struct whisper_model_loader * loader, struct whisper_context_params params);
 
+    // Create a new context that shares the model weights of ctx - only the state is allocated
+    // The contexts are independent otherwise and can be freed in any order, the weights are freed with the last one
+    // The _with_params variants apply params to the new context, except use_gpu, use_coreml, use_mmap, gpu_device and
+    // use_extra_bufts, which are taken from ctx as they decide how its weights were loaded
+    WHISPER_API struct whisper_context * whisper_init_from_context                     (struct whisper_context * ctx);
+    WHISPER_API struct whisper_context * whisper_init_from_context_no_state            (struct whisper_context * ctx);
+    WHISPER_API struct whisper_context * whisper_init_from_context_with_params         (struct whisper_context * ctx, struct whisper_context_params params);
+    WHISPER_API struct whisper_context * whisper_init_from_context_with_params_no_state(struct whisper_context * ctx, struct whisper_context_params params);
+
     WHISPER_DEPRECATED(
         WHISPER_API struct whisper_context * whisper_init_from_file(const char * path_model),
         "use whisper_init_from_file_with_params instead"
@@ -287,6 +313,31 @@ extern "C" {
                                int   n_samples,
                                int   n_threads);
 
+    // Append RAW PCM audio to the log mel spectrogram of the state.
+    // Only the frames covering the new samples are computed, the frames computed by previous calls are kept.
+    // Afterwards, whisper_full_with_state() can be called with n_samples == 0 to transcribe the audio pushed so far.
+    // Only the frames of the last 30 seconds are kept, the transcription starts at most 30 seconds before the end of
+    // the audio. Timestamps are still relative to the start of the stream.
+    // The normalization is done per 30 second window, so the result matches whisper_pcm_to_mel() for audio up to 30 seconds.
+    // Calling whisper_pcm_to_mel() or whisper_set_mel() discards the streamed audio.
+    // Returns 0 on success
+    WHISPER_API int whisper_mel_stream_push(
+            struct whisper_context * ctx,
+                       const float * samples,
+                               int   n_samples,
+                               int   n_threads);
+
+    WHISPER_API int whisper_mel_stream_push_with_state(
+            struct whisper_context * ctx,
+              struct whisper_state * state,
+                       const float * samples,
+                               int   n_samples,
+                               int   n_threads);
+
+    // Discard the audio pushed with whisper_mel_stream_push() and start a new stream
+    WHISPER_API void whisper_mel_stream_reset(struct whisper_context * ctx);
+    WHISPER_API void whisper_mel_stream_reset_with_state(struct whisper_context * ctx, struct whisper_state * state);
+
     // This can be used to set a custom log mel spectrogram inside the default state of the provided whisper context.
     // Use this instead of whisper_pcm_to_mel() if you want to provide your own log mel spectrogram.
     // n_mel must be 80
@@ -442,6 +493,9 @@ extern "C" {
         float decode_ms;
         float batchd_ms;
         float prompt_ms;
+
+        int32_t kv_cross_cache_hits;   // encoder calls served from the kv_cross cache
+        int32_t kv_cross_cache_misses; // encoder calls computed and stored in the kv_cross cache
     };
     WHISPER_API struct whisper_timings * whisper_get_timings(struct whisper_context * ctx);
     WHISPER_API void whisper_print_timings(struct whisper_context * ctx);
@@ -515,6 +569,10 @@ extern "C" {
         bool debug_mode;        // enable debug_mode provides extra info (eg. Dump log_mel)
         int  audio_ctx;         // overwrite the audio context size (0 = use default)
 
+        // size the audio context of each window to the remaining audio, from a fixed set of sizes (overrides audio_ctx)
+        // short clips (e.g. voice commands) only encode the part of the 30 s window that holds audio
+        bool dynamic_audio_ctx;
+
         // [EXPERIMENTAL] [TDRZ] tinydiarize
         bool tdrz_enable;       // enable tinydiarize speaker turn detection
 
@@ -614,11 +672,47 @@ extern "C" {
                            const float * samples,
                                    int   n_samples);
 
-    // Split the input audio in chunks and process each chunk separately using whisper_full_with_state()
+    // Transcribe a batch of short clips of up to 30 seconds each, e.g. voice notes
+    // The clips are encoded one after another and then decoded together, one sequence per clip, so the decoder
+    // weights are read once per step for up to WHISPER_MAX_DECODERS clips instead of once per clip.
+    // Only greedy decoding at params.temperature is used: there is no temperature fallback, and the sampling strategy,
+    // token_timestamps and vad options are ignored. With params.dynamic_audio_ctx, each group of clips is encoded with
+    // the audio context of its longest clip.
+    // Each clip of a group keeps its cross-attention KV in its own slot, sized for the audio context of the group. The
+    // slots are freed when the call returns, leaving the single 30 s window that whisper_full() needs.
+    // The segments of all clips are stored in clip order, the times are relative to the start of each clip,
+    // see whisper_full_get_segment_clip() and whisper_full_clip_lang_id()
+    WHISPER_API int whisper_full_batch(
+                struct whisper_context * ctx,
+            struct whisper_full_params   params,
+                   const float * const * samples,
+                             const int * n_samples,
+                                   int   n_clips);
+
+    WHISPER_API int whisper_full_batch_with_state(
+                struct whisper_context * ctx,
+                  struct whisper_state * state,
+            struct whisper_full_params   params,
+                   const float * const * samples,
+                             const int * n_samples,
+                                   int   n_clips);
+
+    // Keep at least n_states idle states in the context for whisper_full_parallel(), which needs n_processors - 1 of them.
+    // The states are created once and reused by later calls instead of being allocated and freed on every call.
+    // Returns the number of idle states, or -1 if a state could not be created
+    WHISPER_API int whisper_state_pool_reserve(struct whisper_context * ctx, int n_states);
+
+    // Free the idle states of the context beyond the first n_keep, e.g. on memory pressure
+    // States that are in use by a running whisper_full_parallel() are not affected
+    WHISPER_API void whisper_state_pool_trim(struct whisper_context * ctx, int n_keep);
+
+    // Split the input audio in units of up to 30 seconds and process them using whisper_full_with_state()
+    // The units are cut at the VAD silence gaps when params.vad is enabled, otherwise at the quietest point near the limit.
+    // n_processors workers take units from a shared queue, the results are merged in time order.
     // Result is stored in the default state of the context
     // Not thread safe if executed in parallel on the same context.
     // It seems this approach can offer some speedup in some cases.
-    // However, the transcription accuracy can be worse at the beginning and end of each chunk.
+    // However, the transcription accuracy can be worse at the beginning and end of each unit.
     WHISPER_API int whisper_full_parallel(
                 struct whisper_context * ctx,
             struct whisper_full_params   params,
@@ -637,6 +731,14 @@ extern "C" {
     // Language id associated with the provided state
     WHISPER_API int whisper_full_lang_id_from_state(struct whisper_state * state);
 
+    // Language id of the specified clip of the last whisper_full_batch() call
+    WHISPER_API int whisper_full_clip_lang_id           (struct whisper_context * ctx, int i_clip);
+    WHISPER_API int whisper_full_clip_lang_id_from_state(struct whisper_state * state, int i_clip);
+
+    // Get the index of the whisper_full_batch() clip of the specified segment, 0 for the other whisper_full functions
+    WHISPER_API int whisper_full_get_segment_clip           (struct whisper_context * ctx, int i_segment);
+    WHISPER_API int whisper_full_get_segment_clip_from_state(struct whisper_state * state, int i_segment);
+
     // Get the start and end time of the specified segment
     WHISPER_API int64_t whisper_full_get_segment_t0           (struct whisper_context * ctx, int i_segment);
     WHISPER_API int64_t whisper_full_get_segment_t0_from_state(struct whisper_state * state, int i_segment);
@@ -706,6 +808,31 @@ extern "C" {
     // Reset LSTM hidden/cell states to zero.
     WHISPER_API void whisper_vad_reset_state(struct whisper_vad_context * vctx);
 
+    // Streaming VAD
+    // Push PCM chunks of any length - the LSTM state and the samples that do not fill a whole window are kept
+    // between the calls, so each window is evaluated only once.
+    // Speech start/end events are detected with the same thresholds as whisper_vad_segments_from_probs.
+    // The start event is reported once the speech lasted min_speech_duration_ms, the end event after
+    // min_silence_duration_ms of silence. The event times are in centiseconds from the start of the stream.
+    // Returns the number of events emitted by this push, or -1 on failure. whisper_vad_probs() holds the
+    // probabilities of the windows evaluated by this push.
+    // whisper_vad_detect_speech shares the LSTM state, call whisper_vad_stream_reset() after using it.
+    WHISPER_API int whisper_vad_stream_push(
+            struct whisper_vad_context * vctx,
+            struct whisper_vad_params    params,
+                           const float * samples,
+                                   int   n_samples);
+
+    WHISPER_API void whisper_vad_stream_reset(struct whisper_vad_context * vctx);
+
+    // Events emitted by the last whisper_vad_stream_push()
+    WHISPER_API int   whisper_vad_stream_n_events       (struct whisper_vad_context * vctx);
+    WHISPER_API bool  whisper_vad_stream_get_event_start(struct whisper_vad_context * vctx, int i_event);
+    WHISPER_API float whisper_vad_stream_get_event_t    (struct whisper_vad_context * vctx, int i_event);
+
+    // Whether the stream is inside a reported speech segment
+    WHISPER_API bool  whisper_vad_stream_is_speech(struct whisper_vad_context * vctx);
+
     WHISPER_API int     whisper_vad_n_probs(struct whisper_vad_context * vctx);
     WHISPER_API float * whisper_vad_probs  (struct whisper_vad_context * vctx);
 
@@ -738,6 +865,13 @@ extern "C" {
     WHISPER_API int          whisper_bench_wsp_ggml_mul_mat    (int n_threads);
     WHISPER_API const char * whisper_bench_wsp_ggml_mul_mat_str(int n_threads);
 
+    // [EXPERIMENTAL] Token-level timestamps with DTW
+    // times the median filter and the DTW of a 30 s window, then whisper_full() with token timestamps on a temporary
+    // state without and with DTW, and reports the peak RSS of the process before and after
+    // the timestamps of the run with DTW are then compared with those of a decode of the DTW sequence after the window
+    WHISPER_API int          whisper_bench_dtw             (struct whisper_context * ctx, int n_threads);
+    WHISPER_API const char * whisper_bench_dtw_str         (struct whisper_context * ctx, int n_threads);
+
     // Control logging output; default behavior is to print to stderr
 
     WHISPER_API void whisper_log_set(wsp_ggml_log_callback log_callback, void * user_data);
@@ -35,6 +35,28 @@ const modelList = [
   { name: 'large-v3-turbo-q8_0', default: false },
 ] as const
 
+const sampleFile = require('../assets/jfk.wav')
+
+// clip lengths (ms) for the adaptive audio context benchmark, jfk.wav is 11 s
+const clipDurations = [2000, 5000, 8000, 11000]
+
+// number of clips for the batch transcription benchmark
+const batchClipCount = 8
+
+// share of the words of the full-context result found at the same position in the other result
+const wordAgreement = (reference: string, result: string) => {
+  const words = (text: string) =>
+    text
+      .toLowerCase()
+      .replace(/[^a-z0-9' ]/g, ' ')
+      .split(' ')
+      .filter(Boolean)
+  const ref = words(reference)
+  const res = words(result)
+  if (ref.length === 0) return res.length === 0 ? 1 : 0
+  return ref.filter((word, i) => res[i] === word).length / ref.length
+}
+
 const modelNameMap = modelList.reduce((acc, model) => {
   acc[model.name as keyof typeof acc] = model.default
   return acc
@@ -330,6 +352,191 @@ export default function Bench() {
           )
         }}
       />
+      <Button
+        title="CPU repack encoder benchmark"
+        onPress={async () => {
+          log('Start CPU repack encoder benchmark')
+          log('| Model | Th | Enc. plain | Enc. repack | Speedup |')
+          log('| --- | --- | --- | --- | --- |')
+          await Object.entries(downloadMap).reduce(
+            async (promise, [modelName, downloadNeeded]) => {
+              await promise
+              if (!downloadNeeded || !modelName.includes('-q5_')) return
+              const filePath = `${fileDir}/ggml-${modelName}.bin`
+              if (!(await RNFS.exists(filePath))) {
+                log(`${modelName} not found, skipping`)
+                return
+              }
+              const encode = async (useCpuRepack: boolean) => {
+                const ctx = await initWhisper({
+                  filePath,
+                  useCoreMLIos: false,
+                  useGpu: false,
+                  useCpuRepack,
+                })
+                try {
+                  return await ctx.bench(-1)
+                } finally {
+                  await ctx.release()
+                }
+              }
+              const plain = await encode(false)
+              const repack = await encode(true)
+              log(
+                `| ${modelName} | ${repack.nThreads} | ${plain.encodeMs.toFixed(
+                  2,
+                )} | ${repack.encodeMs.toFixed(2)} | ${(
+                  plain.encodeMs / repack.encodeMs
+                ).toFixed(2)}x |`,
+              )
+            },
+            Promise.resolve(),
+          )
+        }}
+      />
+      <Button
+        title="Adaptive audio context benchmark"
+        onPress={async () => {
+          log('Start adaptive audio context benchmark')
+          log(
+            '| Model | Clip | Full (ms) | Dynamic (ms) | Speedup | Agreement |',
+          )
+          log('| --- | --- | --- | --- | --- | --- |')
+          await Object.entries(downloadMap).reduce(
+            async (promise, [modelName, downloadNeeded]) => {
+              await promise
+              if (!downloadNeeded) return
+              const filePath = `${fileDir}/ggml-${modelName}.bin`
+              if (!(await RNFS.exists(filePath))) {
+                log(`${modelName} not found, skipping`)
+                return
+              }
+              const ctx = await initWhisper({ filePath, useCoreMLIos: false })
+              try {
+                const run = async (
+                  duration: number,
+                  dynamicAudioCtx: boolean,
+                ) => {
+                  const startTime = Date.now()
+                  const { result } = await ctx.transcribe(sampleFile, {
+                    language: 'en',
+                    duration,
+                    dynamicAudioCtx,
+                  }).promise
+                  return { result, time: Date.now() - startTime }
+                }
+                await clipDurations.reduce(async (clipPromise, duration) => {
+                  await clipPromise
+                  const full = await run(duration, false)
+                  const dynamic = await run(duration, true)
+                  const agreement = wordAgreement(full.result, dynamic.result)
+                  log(
+                    `| ${modelName} | ${duration / 1000}s | ${full.time} | ${
+                      dynamic.time
+                    } | ${(full.time / dynamic.time).toFixed(2)}x | ${(
+                      agreement * 100
+                    ).toFixed(0)}% |`,
+                  )
+                }, Promise.resolve())
+              } finally {
+                await ctx.release()
+              }
+            },
+            Promise.resolve(),
+          )
+        }}
+      />
+      <Button
+        title="Batch transcription benchmark"
+        onPress={async () => {
+          log('Start batch transcription benchmark')
+          log(
+            '| Model | Clips | Serial (clips/s) | Batch (clips/s) | Same text |',
+          )
+          log('| --- | --- | --- | --- | --- |')
+          await Object.entries(downloadMap).reduce(
+            async (promise, [modelName, downloadNeeded]) => {
+              await promise
+              if (!downloadNeeded) return
+              const filePath = `${fileDir}/ggml-${modelName}.bin`
+              if (!(await RNFS.exists(filePath))) {
+                log(`${modelName} not found, skipping`)
+                return
+              }
+              const ctx = await initWhisper({ filePath, useCoreMLIos: false })
+              try {
+                const options = {
+                  language: 'en',
+                  temperatureInc: 0,
+                  dynamicAudioCtx: true,
+                }
+                const clips = Array(batchClipCount).fill(sampleFile)
+
+                let startTime = Date.now()
+                const serial = await clips.reduce(
+                  async (resultsPromise, clip) => {
+                    const results = await resultsPromise
+                    const { promise: task } = ctx.transcribe(clip, options)
+                    const { result } = await task
+                    return [...results, result]
+                  },
+                  Promise.resolve([] as string[]),
+                )
+                const serialTime = Date.now() - startTime
+
+                startTime = Date.now()
+                const batch = await ctx.transcribeBatch(clips, options).promise
+                const batchTime = Date.now() - startTime
+
+                const same = batch.every(
+                  ({ result }, i) => result === serial[i],
+                )
+                log(
+                  `| ${modelName} | ${batchClipCount} | ${(
+                    (batchClipCount * 1000) /
+                    serialTime
+                  ).toFixed(2)} | ${(
+                    (batchClipCount * 1000) /
+                    batchTime
+                  ).toFixed(2)} | ${same ? 'yes' : 'no'} |`,
+                )
+              } finally {
+                await ctx.release()
+              }
+            },
+            Promise.resolve(),
+          )
+        }}
+      />
+      <Button
+        title="DTW timestamps benchmark"
+        onPress={async () => {
+          log('Start DTW timestamps benchmark')
+          await Object.entries(downloadMap).reduce(
+            async (promise, [modelName, downloadNeeded]) => {
+              await promise
+              if (!downloadNeeded) return
+              const filePath = `${fileDir}/ggml-${modelName}.bin`
+              if (!(await RNFS.exists(filePath))) {
+                log(`${modelName} not found, skipping`)
+                return
+              }
+              const ctx = await initWhisper({ filePath, useCoreMLIos: false })
+              try {
+                const { dtw } = await ctx.bench(-1, { dtw: true })
+                log(modelName)
+                dtw
+                  ?.trim()
+                  .split('\n')
+                  .forEach((line) => log(line))
+              } finally {
+                await ctx.release()
+              }
+            },
+            Promise.resolve(),
+          )
+        }}
+      />
       <View style={styles.logContainer}>
         {logs.map((msg, index) => (
           <Text key={index} style={styles.logText}>
@@ -224,6 +224,35 @@ export default function App() {
               }
             }}
           />
+          <Button
+            title="Parallel edge cases"
+            disabled={!!stopTranscribe?.stop}
+            onPress={async () => {
+              if (!whisperContext) return log('No context')
+
+              // nothing left to transcribe after the offset, expect no segments and no error
+              const cases: Array<[string, number]> = [
+                ['offset past the end', 5000],
+                ['offset at the end', 1000],
+              ]
+              for (const [name, offset] of cases) {
+                try {
+                  const { segments } = await whisperContext.transcribeData(
+                    new Float32Array(16000),
+                    { language: 'en', nProcessors: 2, offset },
+                  ).promise
+                  log(
+                    `Parallel ${name}:`,
+                    segments.length === 0
+                      ? 'OK'
+                      : `FAILED, ${segments.length} segments`,
+                  )
+                } catch (error) {
+                  log(`Parallel ${name}: FAILED,`, error)
+                }
+              }
+            }}
+          />
         </View>
         <View style={styles.logContainer}>
           {logs.map((msg, index) => (
@@ -151,6 +151,10 @@ WhisperContextInitResult hostInitWhisperContext(
     params.flash_attn = options.useFlashAttn;
     params.dtw_token_timestamps = false;
     params.use_coreml = options.useCoreMLIos;
+    params.kv_cross_cache_size = options.kvCrossCacheSize;
+    params.type_k = options.kvCacheType;
+    params.type_v = options.kvCacheType;
+    params.use_extra_bufts = options.useCpuRepack;
 
 #if !defined(WHISPER_USE_COREML)
     if (params.use_coreml) {
@@ -230,7 +230,13 @@ patch -p0 -d ./cpp < ./scripts/patches/ggml-quants.c.patch
 patch -p0 -d ./cpp < ./scripts/patches/ggml.c.patch
 patch -p0 -d ./cpp < ./scripts/patches/whisper.h.patch
 patch -p0 -d ./cpp < ./scripts/patches/whisper.cpp.patch
-rm -rf ./cpp/*.orig
+patch -p0 -d ./cpp < ./scripts/patches/ggml-cpu-repack.h.patch
+patch -p0 -d ./cpp < ./scripts/patches/ggml-cpu-repack.cpp.patch
+patch -p0 -d ./cpp < ./scripts/patches/ggml-cpu-arch-fallback.h.patch
+patch -p0 -d ./cpp < ./scripts/patches/ggml-cpu-arch-x86-repack.cpp.patch
+patch -p0 -d ./cpp < ./scripts/patches/ggml-cpu.h.patch
+patch -p0 -d ./cpp < ./scripts/patches/ggml-cpu-ggml-cpu.c.patch
+rm -rf ./cpp/*.orig ./cpp/ggml-cpu/*.orig ./cpp/ggml-cpu/arch/*/*.orig
 
 # Download model for example
 cd whisper.cpp/models
@@ -25,6 +25,11 @@ export type TranscribeOptions = {
   offset?: number
   /** Duration of audio to process in milliseconds */
   duration?: number
+  /**
+   * Size the encoder context of each window to the remaining audio instead of the full 30 s (Default: false).
+   * Faster for short clips (e.g. voice commands). Ignored when the Core ML encoder is used.
+   */
+  dynamicAudioCtx?: boolean
   /** Initial decoding temperature */
   temperature?: number
   /** Temperature fallback increment applied between decoding retries */
@@ -60,6 +65,9 @@ export type NativeContextOptions = {
   useGpu?: boolean
   useCoreMLIos?: boolean
   downloadCoreMLAssets?: boolean
+  kvCrossCacheSize?: number
+  kvCacheType?: 'f16' | 'q8_0' | 'q4_0'
+  useCpuRepack?: boolean
   coreMLAssets?: CoreMLAsset[]
 }
 
@@ -103,6 +111,20 @@ export type VadSegment = {
   t1: number
 }
 
+export type VadStreamEvent = {
+  /** Speech started or ended */
+  type: 'start' | 'end'
+  /** Time of the event in centiseconds from the start of the stream */
+  t: number
+}
+
+export type VadStreamResult = {
+  /** Whether the stream is inside a speech segment after this chunk */
+  isSpeech: boolean
+  /** Speech start/end events detected in this chunk */
+  events: VadStreamEvent[]
+}
+
 export interface Spec extends TurboModule {
   install(): Promise<boolean>
 }
@@ -19,3 +19,48 @@ test('Mock', async () => {
   await context.release()
   await releaseAllWhisper()
 })
+
+test('Mock bench', async () => {
+  const context = await initWhisper({
+    filePath: 'test.bin',
+  })
+  expect(await context.bench(1)).toEqual({
+    config: 'NEON',
+    nThreads: 1,
+    encodeMs: 1,
+    decodeMs: 1,
+    batchMs: 1,
+    promptMs: 1,
+    dtw: undefined,
+  })
+  const { dtw } = await context.bench(1, { dtw: true })
+  expect(dtw).toBe('dtw: 224 tokens x 1500 frames\n')
+  await context.release()
+  await releaseAllWhisper()
+})
+
+test('Mock transcribeBatch', async () => {
+  const context = await initWhisper({
+    filePath: 'test.bin',
+  })
+  const onProgress = jest.fn()
+  const { promise } = context.transcribeBatch(
+    ['file:///a.wav', 'data:audio/wav;base64,AAAA'],
+    { language: 'en', onProgress },
+  )
+  const result = {
+    language: 'en',
+    isAborted: false,
+    result: ' Test',
+    segments: [{ text: ' Test', t0: 0, t1: 33 }],
+  }
+  expect(await promise).toEqual([result, result])
+  expect(global.whisperTranscribeBatch).toHaveBeenLastCalledWith(
+    context.id,
+    ['/a.wav', 'data:audio/wav;base64,AAAA'],
+    expect.objectContaining({ language: 'en', jobId: 5000 }),
+  )
+  expect(onProgress).toHaveBeenCalledWith(100)
+  await context.release()
+  await releaseAllWhisper()
+})
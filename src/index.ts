@@ -12,6 +12,8 @@ import type {
   TranscribeResult,
   VadOptions,
   VadSegment,
+  VadStreamEvent,
+  VadStreamResult,
 } from './NativeRNWhisper'
 import { version } from './version.json'
 
@@ -37,13 +39,17 @@ const jsiBindingKeys = [
   'whisperReleaseAllContexts',
   'whisperTranscribeFile',
   'whisperTranscribeData',
+  'whisperTranscribeBatch',
   'whisperAbortTranscribe',
+  'whisperTrimMemory',
   'whisperBench',
   'whisperInitVadContext',
   'whisperReleaseVadContext',
   'whisperReleaseAllVadContexts',
   'whisperVadDetectSpeech',
   'whisperVadDetectSpeechFile',
+  'whisperVadStreamPush',
+  'whisperVadStreamReset',
   'whisperToggleNativeLog',
 ] as const
 
@@ -151,6 +157,19 @@ const resolveLocalInputPath = (
   return stripFileScheme(input)
 }
 
+const resolveTranscribeInput = (filePathOrBase64: string | number): string => {
+  if (typeof filePathOrBase64 === 'number') {
+    return resolvePathFromAsset(filePathOrBase64)
+  }
+  if (filePathOrBase64.startsWith('data:audio/wav;base64,')) {
+    return filePathOrBase64
+  }
+  return resolveLocalInputPath(
+    filePathOrBase64,
+    'Transcribe remote file is not supported, please download it first',
+  )
+}
+
 const createCoreMLAssets = (
   coreMLModelAsset?: CoreMLModelAssetOptions,
 ): CoreMLAsset[] | undefined => {
@@ -181,7 +200,7 @@ const createCoreMLAssets = (
 }
 
 const normalizeBenchResult = (result: string) => {
-  const [config, nThreads, encodeMs, decodeMs, batchMs, promptMs] =
+  const [config, nThreads, encodeMs, decodeMs, batchMs, promptMs, dtw] =
     JSON.parse(result)
   return {
     config,
@@ -190,6 +209,7 @@ const normalizeBenchResult = (result: string) => {
     decodeMs,
     batchMs,
     promptMs,
+    dtw,
   }
 }
 
@@ -203,6 +223,8 @@ export type {
   TranscribeResult,
   VadOptions,
   VadSegment,
+  VadStreamEvent,
+  VadStreamResult,
 }
 
 export type TranscribeNewSegmentsResult = {
@@ -219,6 +241,19 @@ export interface TranscribeFileOptions extends TranscribeOptions {
   onNewSegments?: (result: TranscribeNewSegmentsResult) => void
 }
 
+export type TranscribeBatchOptions = Omit<
+  TranscribeFileOptions,
+  'onNewSegments'
+>
+
+export type BenchOptions = {
+  /**
+   * Also benchmark the DTW token-level timestamps (default: false): the median filter and the DTW of a 30 s window,
+   * then a transcription with and without DTW and the peak RSS of the process
+   */
+  dtw?: boolean
+}
+
 export type BenchResult = {
   config: string
   nThreads: number
@@ -226,6 +261,8 @@ export type BenchResult = {
   decodeMs: number
   batchMs: number
   promptMs: number
+  /** Report of the DTW benchmark, only with `dtw: true` */
+  dtw?: string
 }
 
 export class WhisperContext {
@@ -249,9 +286,9 @@ export class WhisperContext {
     this.reasonNoGPU = reasonNoGPU
   }
 
-  private runTranscription(
-    run: (jobId: number) => Promise<TranscribeResult>,
-  ): { stop: () => Promise<void>; promise: Promise<TranscribeResult> } {
+  private runTranscription<T>(
+    run: (jobId: number) => Promise<T>,
+  ): { stop: () => Promise<void>; promise: Promise<T> } {
     const { whisperAbortTranscribe } = getJsi()
     const jobId = Math.floor(Math.random() * 10000)
 
@@ -286,17 +323,7 @@ export class WhisperContext {
         }
       : undefined
 
-    let path = ''
-    if (typeof filePathOrBase64 === 'number') {
-      path = resolvePathFromAsset(filePathOrBase64)
-    } else if (filePathOrBase64.startsWith('data:audio/wav;base64,')) {
-      path = filePathOrBase64
-    } else {
-      path = resolveLocalInputPath(
-        filePathOrBase64,
-        'Transcribe remote file is not supported, please download it first',
-      )
-    }
+    const path = resolveTranscribeInput(filePathOrBase64)
 
     const task = this.runTranscription((jobId) =>
       whisperTranscribeFile(this.id, path, {
@@ -318,10 +345,11 @@ export class WhisperContext {
   }
 
   /**
-   * Transcribe audio data (base64 encoded float32 PCM data or ArrayBuffer)
+   * Transcribe audio data (base64 encoded 16-bit PCM data, ArrayBuffer of 16-bit PCM or Float32Array)
+   * The buffer is read in place by the native side, do not modify it until the promise settles.
    */
   transcribeData(
-    data: string | ArrayBuffer,
+    data: string | ArrayBuffer | Float32Array,
     options: TranscribeFileOptions = {},
   ): {
     stop: () => Promise<void>
@@ -336,14 +364,25 @@ export class WhisperContext {
           onProgress(progress)
         }
       : undefined
-    const audioData =
-      data instanceof ArrayBuffer ? data : decodeBase64ToArrayBuffer(data)
+    let audioData: ArrayBuffer
+    let audioFormat: 's16' | 'f32' = 's16'
+    if (data instanceof Float32Array) {
+      audioFormat = 'f32'
+      // Pass the underlying buffer as is when the view covers all of it
+      audioData =
+        data.byteOffset === 0 && data.byteLength === data.buffer.byteLength
+          ? (data.buffer as ArrayBuffer)
+          : (data.slice().buffer as ArrayBuffer)
+    } else {
+      audioData =
+        data instanceof ArrayBuffer ? data : decodeBase64ToArrayBuffer(data)
+    }
 
     const task = this.runTranscription(
       (jobId) =>
         whisperTranscribeData(
           this.id,
-          { ...rest, onProgress: progressCallback, jobId },
+          { ...rest, onProgress: progressCallback, jobId, audioFormat },
           audioData,
         ),
     )
@@ -359,9 +398,68 @@ export class WhisperContext {
     }
   }
 
-  async bench(maxThreads: number): Promise<BenchResult> {
+  /**
+   * Transcribe many short audio files (up to 30 seconds each, e.g. voice notes) together.
+   * The clips are decoded in batches of up to 8, which gives more clips per second than transcribing them one by one.
+   * Only greedy decoding is used, without temperature fallback. The results are in the order of the inputs.
+   */
+  transcribeBatch(
+    filePathsOrBase64: Array<string | number>,
+    options: TranscribeBatchOptions = {},
+  ): {
+    stop: () => Promise<void>
+    promise: Promise<TranscribeResult[]>
+  } {
+    const { whisperTranscribeBatch } = getJsi()
+    const { onProgress, ...rest } = options
+    let lastProgress = 0
+    const progressCallback = onProgress
+      ? (progress: number) => {
+          lastProgress = progress
+          onProgress(progress)
+        }
+      : undefined
+
+    const paths = filePathsOrBase64.map(resolveTranscribeInput)
+
+    const task = this.runTranscription((jobId) =>
+      whisperTranscribeBatch(this.id, paths, {
+        ...rest,
+        onProgress: progressCallback,
+        jobId,
+      }),
+    )
+
+    return {
+      stop: task.stop,
+      promise: task.promise.then((results) => {
+        if (
+          onProgress &&
+          !results.some((result) => result.isAborted) &&
+          lastProgress !== 100
+        ) {
+          onProgress(100)
+        }
+        return results
+      }),
+    }
+  }
+
+  /**
+   * Free the native memory kept between transcriptions (e.g. the extra states used with `nProcessors` > 1).
+   * It is recreated on demand, call this on memory pressure.
+   */
+  async trimMemory(): Promise<void> {
+    const { whisperTrimMemory } = getJsi()
+    return whisperTrimMemory(this.id)
+  }
+
+  async bench(
+    maxThreads: number,
+    options: BenchOptions = {},
+  ): Promise<BenchResult> {
     const { whisperBench } = getJsi()
-    const result = await whisperBench(this.id, maxThreads)
+    const result = await whisperBench(this.id, maxThreads, options)
     return normalizeBenchResult(result)
   }
 
@@ -387,6 +485,24 @@ export type ContextOptions = {
   useGpu?: boolean
   /** Use Flash Attention, only recommended if GPU available */
   useFlashAttn?: boolean
+  /**
+   * Max bytes of the cache of recently encoded audio windows (default: 0, disabled).
+   * Re-transcribing the same audio (e.g. growing realtime slices) reuses the encoder output instead of running the encoder again.
+   */
+  kvCrossCacheSize?: number
+  /**
+   * Storage type of the attention KV caches (default: 'f16').
+   * 'q8_0' roughly halves and 'q4_0' quarters their memory, quantizing V requires useFlashAttn (otherwise only K is quantized).
+   */
+  kvCacheType?: 'f16' | 'q8_0' | 'q4_0'
+  /**
+   * Repack the quantized weights for the interleaved CPU matrix kernels (default: true).
+   * Mainly speeds up the encoder of quantized models (e.g. q5_0, q5_1), disable to compare or to skip the repacking at load time.
+   * The repacked weights are copied out of the model file, so they are not memory-mapped: a q5 model then costs about
+   * its full weight size in app memory, once per set of contexts sharing the model.
+   * q5_0 / q5_1 are only repacked by builds with AVX2 kernels (x86_64 with AVX2), not on the shipped arm64, Android x86_64 or iOS builds.
+   */
+  useCpuRepack?: boolean
 }
 
 /**
@@ -401,6 +517,9 @@ export async function initWhisper({
   useGpu = true,
   useCoreMLIos = true,
   useFlashAttn = false,
+  kvCrossCacheSize = 0,
+  kvCacheType = 'f16',
+  useCpuRepack = true,
 }: ContextOptions): Promise<WhisperContext> {
   await installJsi()
   const { whisperInitContext } = getJsi()
@@ -421,6 +540,9 @@ export async function initWhisper({
     useFlashAttn,
     useGpu,
     useCoreMLIos,
+    kvCrossCacheSize,
+    kvCacheType,
+    useCpuRepack,
     downloadCoreMLAssets: __DEV__ && !!coreMLAssets,
     coreMLAssets,
   } satisfies NativeContextOptions)
@@ -513,6 +635,31 @@ export class WhisperVadContext {
     return result.segments || []
   }
 
+  /**
+   * Push a chunk of raw audio data (base64 encoded float32 PCM data or ArrayBuffer) to the VAD stream.
+   * The model state and the samples of an incomplete window are kept between calls,
+   * so only the new audio is evaluated. Call `resetStream` between unrelated streams.
+   */
+  async detectSpeechStream(
+    audioData: string | ArrayBuffer,
+    options: VadOptions = {},
+  ): Promise<VadStreamResult> {
+    const { whisperVadStreamPush } = getJsi()
+    const pcmData =
+      audioData instanceof ArrayBuffer
+        ? audioData
+        : decodeBase64ToArrayBuffer(audioData)
+    return whisperVadStreamPush(this.id, options, pcmData)
+  }
+
+  /**
+   * Reset the VAD stream state, `detectSpeech` and `detectSpeechData` also require a reset before streaming again
+   */
+  async resetStream(): Promise<void> {
+    const { whisperVadStreamReset } = getJsi()
+    return whisperVadStreamReset(this.id)
+  }
+
   async release(): Promise<void> {
     const { whisperReleaseVadContext } = getJsi()
     return whisperReleaseVadContext(this.id)
@@ -48,9 +48,23 @@ global.whisperTranscribeData = jest.fn(
     return transcribeResult
   },
 )
+global.whisperTranscribeBatch = jest.fn(
+  async (_contextId: number, pathsOrBase64: string[]) =>
+    pathsOrBase64.map(() => transcribeResult),
+)
 global.whisperAbortTranscribe = jest.fn(async () => undefined)
-global.whisperBench = jest.fn(async () =>
-  JSON.stringify(['NEON', 1, 1, 1, 1, 1]),
+global.whisperTrimMemory = jest.fn(async () => undefined)
+global.whisperBench = jest.fn(
+  async (
+    _contextId: number,
+    _maxThreads: number,
+    options?: { dtw?: boolean },
+  ) =>
+    JSON.stringify(
+      options?.dtw
+        ? ['NEON', 1, 1, 1, 1, 1, 'dtw: 224 tokens x 1500 frames\n']
+        : ['NEON', 1, 1, 1, 1, 1],
+    ),
 )
 global.whisperInitVadContext = jest.fn(async (contextId: number) => ({
   contextId,
@@ -61,6 +75,11 @@ global.whisperReleaseVadContext = jest.fn(async () => undefined)
 global.whisperReleaseAllVadContexts = jest.fn(async () => undefined)
 global.whisperVadDetectSpeech = jest.fn(async () => vadResult)
 global.whisperVadDetectSpeechFile = jest.fn(async () => vadResult)
+global.whisperVadStreamPush = jest.fn(async () => ({
+  isSpeech: true,
+  events: [{ type: 'start' as const, t: 50 }],
+}))
+global.whisperVadStreamReset = jest.fn(async () => undefined)
 global.whisperToggleNativeLog = jest.fn(async () => undefined)
 
 module.exports = jest.requireActual('./index')
@@ -8,10 +8,13 @@ import type {
   TranscribeResult,
   VadOptions,
   VadSegment,
+  VadStreamResult,
 } from './NativeRNWhisper'
 
 type TranscribeCallbacks = {
   jobId?: number
+  /** Sample format of the data passed to whisperTranscribeData (default: 's16') */
+  audioFormat?: 's16' | 'f32'
   onProgress?: (progress: number) => void
   onNewSegments?: (result: {
     nNew: number
@@ -42,11 +45,21 @@ declare global {
     options: TranscribeOptions & TranscribeCallbacks,
     data: ArrayBuffer,
   ) => Promise<TranscribeResult>
+  var whisperTranscribeBatch: (
+    contextId: number,
+    pathsOrBase64: string[],
+    options: TranscribeOptions & TranscribeCallbacks,
+  ) => Promise<TranscribeResult[]>
   var whisperAbortTranscribe: (
     contextId: number,
     jobId: number,
   ) => Promise<void>
-  var whisperBench: (contextId: number, maxThreads: number) => Promise<string>
+  var whisperTrimMemory: (contextId: number) => Promise<void>
+  var whisperBench: (
+    contextId: number,
+    maxThreads: number,
+    options?: { dtw?: boolean },
+  ) => Promise<string>
   var whisperInitVadContext: (
     contextId: number,
     options: NativeVadContextOptions,
@@ -63,6 +76,12 @@ declare global {
     pathOrBase64: string,
     options: VadOptions,
   ) => Promise<{ hasSpeech: boolean; segments: VadSegment[] }>
+  var whisperVadStreamPush: (
+    contextId: number,
+    options: VadOptions,
+    audioData: ArrayBuffer,
+  ) => Promise<VadStreamResult>
+  var whisperVadStreamReset: (contextId: number) => Promise<void>
   var whisperToggleNativeLog: (
     enabled: boolean,
     onLog?: (level: string, text: string) => void,